@@ -10,7 +10,7 @@ public class Bartleby : ModuleRules
 	
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "UMG", "AIModule" });
 
-        PrivateDependencyModuleNames.AddRange(new string[] { "Json", "JsonUtilities", "HTTP" });
+        PrivateDependencyModuleNames.AddRange(new string[] { "Json", "JsonUtilities", "HTTP", "NavigationSystem" });
 
         // Uncomment if you are using Slate UI
         // PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
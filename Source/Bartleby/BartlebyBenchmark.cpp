@@ -0,0 +1,1110 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Console commands and automation tests for measuring how fast the Bartleby system is, and for checking that it gets the
+// right answers. These aren't included in shipping builds.
+
+#include "CoreMinimal.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+#include "HAL/MemoryBase.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonReader.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Engine/World.h"
+#include "Engine/TargetPoint.h"
+#include "GameFramework/Character.h"
+#include "Components/BoxComponent.h"
+#include "Bartleby/BartlebySystem.h"
+#include "Bartleby/BartlebyRoom.h"
+#include "Bartleby/BartlebyObject.h"
+#include "Bartleby/BartlebyController.h"
+#include "Bartleby/BartlebyResponseParser.h"
+#include "Bartleby/BartlebyJsonWriter.h"
+#include "Bartleby/BartlebyEpisodicMemory.h"
+#include "Bartleby/BartlebyTokenizer.h"
+#include "Bartleby/BartlebyRegistry.h"
+#include "Kismet/GameplayStatics.h"
+#include "TimerManager.h"
+
+// Gets at the parts of the system the benchmarks time and the tests check, but that nothing else should call.
+struct FBartlebyBenchmarkAccess
+{
+	static ABartlebySystem::BartlebyPromptSettings MakePromptSettings(ABartlebySystem* system)
+	{
+		return system->MakePromptSettings();
+	}
+	static FString GeneratePrompt(const ABartlebySystem::BartlebyPromptSettings& settings, bool askForHelp, const FString& status)
+	{
+		return ABartlebySystem::GeneratePrompt(settings, askForHelp, status);
+	}
+	static FBartlebyStatusSnapshot CaptureStatus(ABartlebySystem* system, ABartlebyController* controller, const FVector& pos)
+	{
+		return system->CaptureStatus(controller, pos);
+	}
+	static void StartOpenAICall(ABartlebySystem* system, ABartlebyController* controller, FBartlebyStatusSnapshot&& snapshot)
+	{
+		system->StartOpenAICall(controller, MoveTemp(snapshot));
+	}
+	// Gives a system that never began play what it needs to build calls.
+	static void PrepareForCalls(ABartlebySystem* system)
+	{
+		system->Tokenizer = MakeShared<FBartlebyTokenizer>();
+	}
+};
+
+namespace
+{
+	// Counts allocations by standing in front of GMalloc. Everything is passed through to the real allocator. It is put
+	// in place the first time a benchmark runs and never taken out, since other threads may be inside it at any time,
+	// and it only counts on a thread while that thread is running a benchmark, so other threads don't skew the numbers.
+	class FCountingMalloc : public FMalloc
+	{
+	public:
+		FCountingMalloc(FMalloc* InInner) : Inner(InInner) {}
+
+		// Puts the counter in front of GMalloc if it isn't already, and returns it.
+		static FCountingMalloc& Get()
+		{
+			// Leaked on purpose: memory it passed through may still be freed through it while the engine shuts down.
+			static FCountingMalloc* instance = []()
+			{
+				FCountingMalloc* counter = new FCountingMalloc(GMalloc);
+				FPlatformAtomics::InterlockedExchangePtr(reinterpret_cast<void**>(&GMalloc), counter);
+				return counter;
+			}();
+			return *instance;
+		}
+
+		// Starts counting this thread's allocations from zero.
+		void Start()
+		{
+			IsCounting = true;
+			NumAllocations = 0;
+		}
+		// Stops counting this thread's allocations, and returns how many there were.
+		int64 Stop()
+		{
+			IsCounting = false;
+			return NumAllocations;
+		}
+
+		virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Malloc(Count, Alignment);
+		}
+		virtual void* TryMalloc(SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->TryMalloc(Count, Alignment);
+		}
+		virtual void* Realloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->Realloc(Original, Count, Alignment);
+		}
+		virtual void* TryRealloc(void* Original, SIZE_T Count, uint32 Alignment) override
+		{
+			CountAllocation();
+			return Inner->TryRealloc(Original, Count, Alignment);
+		}
+		virtual void Free(void* Original) override
+		{
+			Inner->Free(Original);
+		}
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override
+		{
+			return Inner->QuantizeSize(Count, Alignment);
+		}
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override
+		{
+			return Inner->GetAllocationSize(Original, SizeOut);
+		}
+		virtual void Trim(bool bTrimThreadCaches) override
+		{
+			Inner->Trim(bTrimThreadCaches);
+		}
+		virtual void SetupTLSCachesOnCurrentThread() override
+		{
+			Inner->SetupTLSCachesOnCurrentThread();
+		}
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override
+		{
+			Inner->ClearAndDisableTLSCachesOnCurrentThread();
+		}
+		virtual void InitializeStatsMetadata() override
+		{
+			Inner->InitializeStatsMetadata();
+		}
+		virtual void UpdateStats() override
+		{
+			Inner->UpdateStats();
+		}
+		virtual void GetAllocatorStats(FGenericMemoryStats& out_Stats) override
+		{
+			Inner->GetAllocatorStats(out_Stats);
+		}
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override
+		{
+			Inner->DumpAllocatorStats(Ar);
+		}
+		virtual bool IsInternallyThreadSafe() const override
+		{
+			return Inner->IsInternallyThreadSafe();
+		}
+		virtual bool ValidateHeap() override
+		{
+			return Inner->ValidateHeap();
+		}
+		virtual const TCHAR* GetDescriptiveName() override
+		{
+			return TEXT("BartlebyCountingMalloc");
+		}
+
+	private:
+		void CountAllocation()
+		{
+			if (IsCounting)
+			{
+				NumAllocations++;
+			}
+		}
+
+		FMalloc* Inner;
+		// Whether this thread is running a benchmark, and how many allocations it has made since it started.
+		static thread_local bool IsCounting;
+		static thread_local int64 NumAllocations;
+	};
+	thread_local bool FCountingMalloc::IsCounting = false;
+	thread_local int64 FCountingMalloc::NumAllocations = 0;
+
+	// Result of timing one benchmark.
+	struct FBenchmarkResult
+	{
+		double MicrosecondsPerOp = 0.0;
+		double AllocationsPerOp = 0.0;
+	};
+
+	// Runs the given function the given number of times, and measures the time and allocations each run takes.
+	FBenchmarkResult RunBenchmark(int32 numIterations, TFunctionRef<void()> op)
+	{
+		// Warm up, so that one time setup isn't counted.
+		op();
+		FCountingMalloc& counter = FCountingMalloc::Get();
+		counter.Start();
+		const double start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < numIterations; i++)
+		{
+			op();
+		}
+		const double seconds = FPlatformTime::Seconds() - start;
+		const int64 numAllocations = counter.Stop();
+		FBenchmarkResult result;
+		result.MicrosecondsPerOp = seconds * 1e6 / numIterations;
+		result.AllocationsPerOp = static_cast<double>(numAllocations) / numIterations;
+		return result;
+	}
+
+	// Makes a log of the given length that looks like what the AI sees.
+	std::deque<ABartlebySystem::BartlebyLogElement> MakeBenchmarkLog(int32 numEntries)
+	{
+		std::deque<ABartlebySystem::BartlebyLogElement> log;
+		for (int32 i = 0; i < numEntries; i++)
+		{
+			if (i % 2 == 0)
+			{
+				log.push_back({ ABartlebySystem::BartlebyLogType::Prompt, FString::Printf(
+					TEXT("action_result: You travelled to gallery_%d\nSTATUS:\nYou are in room_id=\"gallery_%d\".\n"
+						"room_description=\"A long hall full of \\\"portraits\\\" and sunglasses.\"\n"
+						"nearby_object_ids=[sunglasses,portrait_%d,bench]\nadjacent_rooms=[lobby,gallery_%d]\n"
+						"recent_rooms=[lobby]\nA guest is here. \nEnter exactly one action now:\n"), i, i, i, i + 1) });
+			}
+			else
+			{
+				log.push_back({ ABartlebySystem::BartlebyLogType::Output, FString::Printf(TEXT("say(These sunglasses were worn by movie star number %d!)"), i) });
+			}
+		}
+		return log;
+	}
+
+	// Builds the request body the way StartOpenAICall used to: a DOM, serialized to an FString, then converted to UTF-8.
+	void WriteRequestBodyWithDom(TArray<uint8>& out, const FString& model, double temperature, const FString& firstMessage,
+		const std::deque<ABartlebySystem::BartlebyLogElement>& log)
+	{
+		TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
+		JsonObject->SetStringField(TEXT("model"), model);
+		TArray<TSharedPtr<FJsonValue>> MessagesArray;
+		{
+			TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
+			MessageObject->SetStringField(TEXT("role"), TEXT("user"));
+			MessageObject->SetStringField(TEXT("content"), firstMessage);
+			MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
+		}
+		for (const auto& log_element : log)
+		{
+			TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
+			MessageObject->SetStringField(TEXT("role"), log_element.Type == ABartlebySystem::BartlebyLogType::Prompt ? TEXT("user") : TEXT("assistant"));
+			MessageObject->SetStringField(TEXT("content"), log_element.Content);
+			MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
+		}
+		JsonObject->SetArrayField(TEXT("messages"), MessagesArray);
+		JsonObject->SetNumberField(TEXT("temperature"), temperature);
+		FString JsonString;
+		TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<>::Create(&JsonString);
+		FJsonSerializer::Serialize(JsonObject.ToSharedRef(), JsonWriter);
+		// This is what SetContentAsString does.
+		FTCHARToUTF8 utf8(*JsonString);
+		out.SetNumUninitialized(utf8.Length());
+		FMemory::Memcpy(out.GetData(), utf8.Get(), utf8.Length());
+	}
+
+	void BenchmarkRequestBody(const TArray<FString>& args)
+	{
+		const int32 numIterations = args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*args[0])) : 200;
+		const FString model = TEXT("gpt-3.5-turbo");
+		const FString help = GetDefault<ABartlebySystem>()->HelpPrompt;
+		UE_LOG(LogTemp, Display, TEXT("entries,path,us_per_request,allocs_per_request,bytes"));
+		for (int32 numEntries : { 8, 64, 512 })
+		{
+			std::deque<ABartlebySystem::BartlebyLogElement> log = MakeBenchmarkLog(numEntries);
+			TArray<uint8> body;
+			FBenchmarkResult dom = RunBenchmark(numIterations, [&]()
+				{
+					WriteRequestBodyWithDom(body, model, 0.4, help, log);
+				});
+			const int32 domBytes = body.Num();
+			int32 sizeHint = 0;
+			FBenchmarkResult direct = RunBenchmark(numIterations, [&]()
+				{
+					// Like SendCall, the body is handed off every time, so start from an empty buffer.
+					TArray<uint8> fresh;
+					ABartlebySystem::WriteRequestBody(fresh, model, 0.4, false, help, log, sizeHint);
+					sizeHint = FMath::Max(sizeHint, fresh.Num());
+					body = MoveTemp(fresh);
+				});
+			UE_LOG(LogTemp, Display, TEXT("%d,dom,%.2f,%.1f,%d"), numEntries, dom.MicrosecondsPerOp, dom.AllocationsPerOp, domBytes);
+			UE_LOG(LogTemp, Display, TEXT("%d,writer,%.2f,%.1f,%d"), numEntries, direct.MicrosecondsPerOp, direct.AllocationsPerOp, body.Num());
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkRequestBodyCommand(
+		TEXT("Bartleby.Benchmark.RequestBody"),
+		TEXT("Compares building request bodies with a JSON DOM against the direct UTF-8 writer, at 8, 64 and 512 log entries. Optional arg: iterations."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkRequestBody));
+
+	// Responses recorded from the chat completions API, used when no directory of recordings is given.
+	const ANSICHAR* const RecordedResponses[] =
+	{
+		"{\"id\":\"chatcmpl-7Qy3m\",\"object\":\"chat.completion\",\"created\":1686400000,\"model\":\"gpt-3.5-turbo-0301\","
+		"\"usage\":{\"prompt_tokens\":1247,\"completion_tokens\":19,\"total_tokens\":1266},\"choices\":[{\"message\":"
+		"{\"role\":\"assistant\",\"content\":\"say(Welcome to the gallery! These sunglasses were worn by a movie star.)\"},"
+		"\"finish_reason\":\"stop\",\"index\":0}]}",
+		"{\"id\":\"chatcmpl-7Qy4a\",\"object\":\"chat.completion\",\"created\":1686400012,\"model\":\"gpt-3.5-turbo-0301\","
+		"\"usage\":{\"prompt_tokens\":1391,\"completion_tokens\":41,\"total_tokens\":1432},\"choices\":[{\"message\":"
+		"{\"role\":\"assistant\",\"content\":\"walk_to_room(lobby)\\nsay(Follow me, the caf\\u00e9 is this way \\ud83d\\ude00)\\n"
+		"look_at(portrait_3)\"},\"finish_reason\":\"stop\",\"index\":0}]}",
+		"{\"error\":{\"message\":\"Rate limit reached for default-gpt-3.5-turbo in organization org-x on requests per min. "
+		"Limit: 3 / min. Please try again in 20s.\",\"type\":\"requests\",\"param\":null,\"code\":null}}",
+		"{\"choices\":[{\"delta\":{\"content\":\" portrait\"},\"finish_reason\":null,\"index\":0}],\"created\":1686400020,"
+		"\"id\":\"chatcmpl-7Qy5b\",\"model\":\"gpt-3.5-turbo-0301\",\"object\":\"chat.completion.chunk\"}",
+	};
+
+	// Loads recorded responses from every .json file in the given directory, or the built in ones if it's empty.
+	TArray<TArray<uint8>> LoadRecordedResponses(const TArray<FString>& args, int32 dirArg)
+	{
+		TArray<TArray<uint8>> responses;
+		if (args.Num() > dirArg)
+		{
+			TArray<FString> files;
+			IFileManager::Get().FindFiles(files, *FPaths::Combine(args[dirArg], TEXT("*.json")), true, false);
+			for (const FString& file : files)
+			{
+				TArray<uint8>& response = responses.AddDefaulted_GetRef();
+				if (!FFileHelper::LoadFileToArray(response, *FPaths::Combine(args[dirArg], file)))
+				{
+					responses.Pop();
+				}
+			}
+			UE_LOG(LogTemp, Display, TEXT("Loaded %d recorded responses from %s."), responses.Num(), *args[dirArg]);
+		}
+		if (responses.Num() == 0)
+		{
+			for (const ANSICHAR* recorded : RecordedResponses)
+			{
+				responses.Emplace(reinterpret_cast<const uint8*>(recorded), FCStringAnsi::Strlen(recorded));
+			}
+		}
+		return responses;
+	}
+
+	// Gets the content of the first choice the way ParseCompletion used to: the body as an FString, then a DOM.
+	bool ParseResponseWithDom(const TArray<uint8>& body, FString& outContent)
+	{
+		FUTF8ToTCHAR converter(reinterpret_cast<const ANSICHAR*>(body.GetData()), body.Num());
+		FString text(converter.Length(), converter.Get());
+		TSharedRef<TJsonReader<TCHAR>> JsonReader = TJsonReaderFactory<TCHAR>::Create(text);
+		TSharedPtr<FJsonObject> jsonObject;
+		if (!FJsonSerializer::Deserialize(JsonReader, jsonObject) || !jsonObject)
+		{
+			return false;
+		}
+		const TArray<TSharedPtr<FJsonValue>>* choices = nullptr;
+		if (!jsonObject->TryGetArrayField(TEXT("choices"), choices) || choices->Num() == 0 || !(*choices)[0]->AsObject())
+		{
+			return true;
+		}
+		TSharedPtr<FJsonObject> choiceObject = (*choices)[0]->AsObject();
+		const TSharedPtr<FJsonObject>* message = nullptr;
+		if (choiceObject->TryGetObjectField(TEXT("message"), message) || choiceObject->TryGetObjectField(TEXT("delta"), message))
+		{
+			(*message)->TryGetStringField(TEXT("content"), outContent);
+		}
+		return true;
+	}
+
+	void BenchmarkResponseScanner(const TArray<FString>& args)
+	{
+		const int32 numIterations = args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*args[0])) : 1000;
+		TArray<TArray<uint8>> responses = LoadRecordedResponses(args, 1);
+		UE_LOG(LogTemp, Display, TEXT("response,path,us_per_response,allocs_per_response,bytes"));
+		for (int32 i = 0; i < responses.Num(); i++)
+		{
+			const TArray<uint8>& body = responses[i];
+			FBenchmarkResult dom = RunBenchmark(numIterations, [&]()
+				{
+					FString content;
+					ParseResponseWithDom(body, content);
+				});
+			FBenchmarkResult scanner = RunBenchmark(numIterations, [&]()
+				{
+					FBartlebyCompletion completion;
+					FBartlebyResponseScanner::Scan(body, completion);
+				});
+			UE_LOG(LogTemp, Display, TEXT("%d,dom,%.2f,%.1f,%d"), i, dom.MicrosecondsPerOp, dom.AllocationsPerOp, body.Num());
+			UE_LOG(LogTemp, Display, TEXT("%d,scanner,%.2f,%.1f,%d"), i, scanner.MicrosecondsPerOp, scanner.AllocationsPerOp, body.Num());
+		}
+	}
+
+	FAutoConsoleCommand BenchmarkResponseScannerCommand(
+		TEXT("Bartleby.Benchmark.ResponseScanner"),
+		TEXT("Compares parsing recorded responses with a JSON DOM against the response scanner. Optional args: iterations, ")
+		TEXT("directory of recorded .json responses."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkResponseScanner));
+
+	// Randomly breaks a response: flips, inserts or deletes bytes, or cuts it short.
+	void MutateResponse(TArray<uint8>& body, FRandomStream& random)
+	{
+		static const ANSICHAR Interesting[] = "{}[]\",:\\u0123456789.eE-+ntf \x01\xc3\xa9\xed\xa0\x80";
+		const int32 numMutations = random.RandRange(1, 4);
+		for (int32 i = 0; i < numMutations; i++)
+		{
+			const int32 index = body.Num() > 0 ? random.RandRange(0, body.Num() - 1) : 0;
+			const uint8 interesting = Interesting[random.RandRange(0, UE_ARRAY_COUNT(Interesting) - 2)];
+			switch (body.Num() > 0 ? random.RandRange(0, 4) : 1)
+			{
+			case 0: body[index] = interesting; break;
+			case 1: body.Insert(interesting, index); break;
+			case 2: body.RemoveAt(index); break;
+			case 3: body.SetNum(index); break;
+			default: body[index] = static_cast<uint8>(random.RandRange(0, 255)); break;
+			}
+		}
+	}
+
+	// Runs the scanner over mutated recorded responses. It must never read out of bounds or crash (run this under a
+	// sanitizer to be sure), and whenever the DOM parser accepts a response the scanner has to get the same content.
+	void FuzzResponseScanner(const TArray<FString>& args)
+	{
+		const int32 numIterations = args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*args[0])) : 100000;
+		FRandomStream random(args.Num() > 1 ? FCString::Atoi(*args[1]) : 1);
+		TArray<TArray<uint8>> corpus = LoadRecordedResponses(args, 2);
+		int32 numMalformed = 0;
+		int32 numMismatched = 0;
+		for (int32 i = 0; i < numIterations; i++)
+		{
+			TArray<uint8> body = corpus[random.RandRange(0, corpus.Num() - 1)];
+			MutateResponse(body, random);
+			FBartlebyCompletion completion;
+			const EBartlebyScanResult result = FBartlebyResponseScanner::Scan(body, completion);
+			if (result == EBartlebyScanResult::Malformed)
+			{
+				numMalformed++;
+				continue;
+			}
+			FString domContent;
+			if (!ParseResponseWithDom(body, domContent) || domContent != completion.Content)
+			{
+				numMismatched++;
+				if (numMismatched <= 10)
+				{
+					UE_LOG(LogTemp, Warning, TEXT("Scanner and DOM disagree on: %s"),
+						*FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(body.GetData()), body.Num())));
+				}
+			}
+		}
+		UE_LOG(LogTemp, Display, TEXT("Fuzzed %d responses: %d malformed, %d where the scanner and the DOM disagree."),
+			numIterations, numMalformed, numMismatched);
+	}
+
+	FAutoConsoleCommand FuzzResponseScannerCommand(
+		TEXT("Bartleby.Fuzz.ResponseScanner"),
+		TEXT("Feeds randomly broken recorded responses to the response scanner. Optional args: iterations, seed, ")
+		TEXT("directory of recorded .json responses to use as the corpus."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&FuzzResponseScanner));
+
+	// Makes a streamed response the way the API sends it, one "data:" event per piece of content, split into lines
+	// with the given line ending.
+	TArray<uint8> MakeStreamedResponse(const TArray<FString>& pieces, const ANSICHAR* lineEnd)
+	{
+		TArray<uint8> body;
+		auto writeLine = [&](const ANSICHAR* text)
+		{
+			body.Append(reinterpret_cast<const uint8*>(text), FCStringAnsi::Strlen(text));
+		};
+		for (const FString& piece : pieces)
+		{
+			writeLine("data: ");
+			// Each event is a JSON document of its own.
+			FBartlebyJsonWriter writer(body);
+			writer.BeginObject();
+			writer.WriteKey("choices");
+			writer.BeginArray();
+			writer.BeginObject();
+			writer.WriteKey("delta");
+			writer.BeginObject();
+			writer.WriteField("content", piece);
+			writer.EndObject();
+			writer.WriteField("index", 0.0);
+			writer.EndObject();
+			writer.EndArray();
+			writer.EndObject();
+			writeLine(lineEnd);
+			writeLine(lineEnd);
+		}
+		writeLine("data: {\"choices\":[{\"delta\":{},\"finish_reason\":\"stop\",\"index\":0}]}");
+		writeLine(lineEnd);
+		writeLine(lineEnd);
+		writeLine("data: [DONE]");
+		writeLine(lineEnd);
+		writeLine(lineEnd);
+		return body;
+	}
+
+	// Feeds the stream parser a response one more byte at a time, as if every byte came in its own chunk, and checks
+	// that the first action is handed off as soon as the line that completes it is in, and not a byte before.
+	bool CheckStreamParser(const ANSICHAR* lineEnd)
+	{
+		const TArray<FString> pieces = { TEXT("say(Wel"), TEXT("come! Let me"), TEXT(" show you around.)"),
+			TEXT("\nwalk_to_room(lobby)"), TEXT("\nlook_at(sunglasses)") };
+		const FString expected = TEXT("say(Welcome! Let me show you around.)");
+		const TArray<uint8> body = MakeStreamedResponse(pieces, lineEnd);
+		// The action is complete once the newline after the event with the closing bracket is in.
+		const int32 lineEndLength = FCStringAnsi::Strlen(lineEnd);
+		int32 readyAt = INDEX_NONE;
+		int32 numEvents = 0;
+		for (int32 i = lineEndLength; i < body.Num() && readyAt == INDEX_NONE; i++)
+		{
+			if (body[i - lineEndLength] == '}' && body[i] == '\n' && ++numEvents == 3)
+			{
+				readyAt = i + 1;
+			}
+		}
+		FBartlebyStreamParser parser;
+		TArray<uint8> received;
+		for (int32 i = 0; i < body.Num(); i++)
+		{
+			received.Add(body[i]);
+			const bool isReady = parser.Feed(received);
+			if (isReady != (received.Num() >= readyAt))
+			{
+				UE_LOG(LogTemp, Error, TEXT("The stream parser said the action was %s after %d of %d bytes, expected at %d."),
+					isReady ? TEXT("ready") : TEXT("not ready"), received.Num(), body.Num(), readyAt);
+				return false;
+			}
+		}
+		FString action;
+		parser.GetFirstAction(action);
+		if (action != expected || !parser.IsDone() || parser.HasError())
+		{
+			UE_LOG(LogTemp, Error, TEXT("The stream parser got \"%s\" (done %d, error %d), expected \"%s\"."), *action,
+				parser.IsDone(), parser.HasError(), *expected);
+			return false;
+		}
+		return true;
+	}
+
+	// A streamed request to a local stand-in for the API, and what came back.
+	struct FStreamCheck
+	{
+		FBartlebyStreamParser Parser;
+		TSharedRef<FBartlebyStreamBuffer> Buffer = MakeShared<FBartlebyStreamBuffer>();
+		bool IsAttached = false;
+		double SendTime = 0.0;
+		double FirstActionTime = 0.0;
+		FString FirstAction;
+		// True once the whole answer is in, or the request failed.
+		bool IsDone = false;
+	};
+
+	// Seconds to wait for the stand-in server before giving up on it.
+	const double StreamCheckTimeout = 30.0;
+
+	// Sends a streamed request to a local stand-in for the API, and checks that the first action is there before the
+	// stream ends, and that it's the same as the first line of the whole answer. Anything wrong is logged as an error.
+	TSharedRef<FStreamCheck> CheckStreamAgainstServer(const FString& url)
+	{
+		TSharedRef<FStreamCheck> check = MakeShared<FStreamCheck>();
+		std::deque<ABartlebySystem::BartlebyLogElement> log = MakeBenchmarkLog(2);
+		TArray<uint8> body;
+		ABartlebySystem::WriteRequestBody(body, TEXT("gpt-3.5-turbo"), 0.4, true, GetDefault<ABartlebySystem>()->HelpPrompt,
+			log, 0);
+		FHttpRequestRef request = FHttpModule::Get().CreateRequest();
+		request->SetURL(url);
+		request->SetVerb(TEXT("POST"));
+		request->SetHeader(TEXT("Content-type"), TEXT("application/json"));
+		request->SetContent(MoveTemp(body));
+		check->IsAttached = FBartlebyStreamBuffer::Attach(*request, check->Buffer);
+		request->OnRequestProgress().BindLambda([check](FHttpRequestPtr pRequest, int32 bytesSent, int32 bytesReceived)
+			{
+				if (check->FirstActionTime == 0.0 && check->Buffer->Update() && check->Parser.Feed(check->Buffer->GetBody()))
+				{
+					check->FirstActionTime = FPlatformTime::Seconds();
+					check->Parser.GetFirstAction(check->FirstAction);
+				}
+			});
+		request->OnProcessRequestComplete().BindLambda([check, url](FHttpRequestPtr pRequest, FHttpResponsePtr pResponse,
+			bool connectedSuccessfully)
+			{
+				const double now = FPlatformTime::Seconds();
+				check->IsDone = true;
+				if (!connectedSuccessfully || !pResponse || pResponse->GetResponseCode() != 200)
+				{
+					UE_LOG(LogTemp, Error, TEXT("Couldn't get a stream from %s. Is Tools/MockOpenAIServer.py running?"), *url);
+					return;
+				}
+				// Parse whatever came in after the last progress report, then compare with the answer as a whole.
+				if (!check->IsAttached)
+				{
+					check->Buffer->Append(pResponse->GetContent());
+				}
+				check->Buffer->Update();
+				check->Parser.Feed(check->Buffer->GetBody());
+				TArray<FString> lines;
+				check->Parser.GetContent().ParseIntoArrayLines(lines, true);
+				const FString expected = lines.Num() > 0 ? lines[0] : FString();
+				if (!check->IsAttached)
+				{
+					// This engine only hands over the body once it's all in, so there's no first action to time.
+					check->Parser.GetFirstAction(check->FirstAction);
+					check->FirstActionTime = now;
+				}
+				if (check->FirstActionTime == 0.0)
+				{
+					UE_LOG(LogTemp, Error, TEXT("The first action wasn't ready until the stream ended."));
+				}
+				else if (check->FirstAction != expected || check->Parser.HasError())
+				{
+					UE_LOG(LogTemp, Error, TEXT("The first action came in as \"%s\", but the whole answer starts with \"%s\"."),
+						*check->FirstAction, *expected);
+				}
+				else
+				{
+					UE_LOG(LogTemp, Display, TEXT("Streamed \"%s\" from %s: first action after %.0f ms, whole answer after %.0f ms."),
+						*check->FirstAction, *url, (check->FirstActionTime - check->SendTime) * 1000.0, (now - check->SendTime) * 1000.0);
+				}
+			});
+		check->SendTime = FPlatformTime::Seconds();
+		request->ProcessRequest();
+		return check;
+	}
+
+	// Waits for a streamed request to the stand-in server to finish, or gives up on it.
+	DEFINE_LATENT_AUTOMATION_COMMAND_ONE_PARAMETER(FWaitForStreamCheck, TSharedRef<FStreamCheck>, Check);
+	bool FWaitForStreamCheck::Update()
+	{
+		if (Check->IsDone)
+		{
+			return true;
+		}
+		if (FPlatformTime::Seconds() - Check->SendTime > StreamCheckTimeout)
+		{
+			UE_LOG(LogTemp, Error, TEXT("The stand-in server didn't finish the stream in %.0f seconds."), StreamCheckTimeout);
+			return true;
+		}
+		return false;
+	}
+
+	// Makes an empty world for a test to put things in, whatever map is open, or whether one is at all.
+	UWorld* MakeTestWorld()
+	{
+		return UWorld::CreateWorld(EWorldType::Game, false, TEXT("BartlebyTestWorld"));
+	}
+
+	// Number of lookups picked ahead of time for each prompt benchmark, so that picking them isn't timed.
+	const int32 NumBenchmarkQueries = 256;
+	// Width of a room on the benchmark's grid, in centimeters.
+	const float BenchmarkRoomSize = 1000.0f;
+
+	// A made up museum for timing prompt generation: rooms on a grid with doors to their neighbours, and objects
+	// scattered among them at random.
+	struct FBenchmarkWorld
+	{
+		ABartlebySystem* System = nullptr;
+		ABartlebyController* Controller = nullptr;
+		// Constructed like the system, so they're kept apart from the actors that were spawned.
+		TArray<ABartlebyRoom*> Rooms;
+		TArray<AActor*> Actors;
+		// Rooms to look things up in, and places inside them.
+		TArray<FString> QueryIds;
+		TArray<FString> QueryMisspellings;
+		TArray<ABartlebyRoom*> QueryRooms;
+		TArray<FVector> QueryPositions;
+	};
+
+	FBenchmarkWorld MakeBenchmarkWorld(UWorld* world, int32 numRooms, int32 numObjects, FRandomStream& random)
+	{
+		FBenchmarkWorld out;
+		// The system, the controller and the rooms are only constructed, not spawned, so they never begin play: they
+		// don't go looking for the level's rooms or register with the level's subsystem, and nothing in the level can
+		// find them. Their outer is the level so that GetWorld still works.
+		out.System = NewObject<ABartlebySystem>(world->PersistentLevel, NAME_None, RF_Transient);
+		out.Controller = NewObject<ABartlebyController>(world->PersistentLevel, NAME_None, RF_Transient);
+		FActorSpawnParameters params;
+		params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		params.ObjectFlags = RF_Transient;
+		const int32 side = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(numRooms)));
+		for (int32 i = 0; i < numRooms; i++)
+		{
+			const FVector center((i % side) * BenchmarkRoomSize, (i / side) * BenchmarkRoomSize, 0.0f);
+			ABartlebyRoom* room = NewObject<ABartlebyRoom>(world->PersistentLevel, NAME_None, RF_Transient);
+			room->Id = FString::Printf(TEXT("gallery_%d"), i);
+			room->Description = FString::Printf(TEXT("A long hall full of portraits, number %d of the collection."), i);
+			room->Box->SetWorldLocation(center);
+			room->Box->SetBoxExtent(FVector(BenchmarkRoomSize * 0.5f, BenchmarkRoomSize * 0.5f, 200.0f));
+			out.System->Rooms.Add(room);
+			out.Rooms.Add(room);
+			// Each room opens onto the rooms before it on the grid.
+			if (i % side > 0)
+			{
+				FDoor& door = out.System->Doors.AddDefaulted_GetRef();
+				door.Room1 = FString::Printf(TEXT("gallery_%d"), i - 1);
+				door.Room2 = room->Id;
+			}
+			if (i >= side)
+			{
+				FDoor& door = out.System->Doors.AddDefaulted_GetRef();
+				door.Room1 = FString::Printf(TEXT("gallery_%d"), i - side);
+				door.Room2 = room->Id;
+			}
+		}
+		const float halfRoom = BenchmarkRoomSize * 0.4f;
+		for (int32 i = 0; i < numObjects; i++)
+		{
+			ABartlebyRoom* room = out.System->Rooms[random.RandRange(0, numRooms - 1)];
+			const FVector offset(random.FRandRange(-halfRoom, halfRoom), random.FRandRange(-halfRoom, halfRoom), 0.0f);
+			AActor* owner = world->SpawnActor<ATargetPoint>(room->Box->GetComponentLocation() + offset, FRotator::ZeroRotator, params);
+			// The component is never registered, so it doesn't add itself to a room in BeginPlay.
+			UBartlebyObject* object = NewObject<UBartlebyObject>(owner);
+			object->Id = FString::Printf(TEXT("exhibit_%d"), i);
+			object->Description = FString::Printf(TEXT("A pair of sunglasses worn by movie star number %d."), i);
+			room->Objects.Add(object);
+			out.Actors.Add(owner);
+		}
+		for (int32 i = 0; i < NumBenchmarkQueries; i++)
+		{
+			ABartlebyRoom* room = out.System->Rooms[random.RandRange(0, numRooms - 1)];
+			const FVector offset(random.FRandRange(-halfRoom, halfRoom), random.FRandRange(-halfRoom, halfRoom), 0.0f);
+			out.QueryIds.Add(room->Id);
+			// The way the AI might write it.
+			out.QueryMisspellings.Add(room->Id.Replace(TEXT("gallery"), TEXT("Galery")));
+			out.QueryRooms.Add(room);
+			out.QueryPositions.Add(room->Box->GetComponentLocation() + offset);
+		}
+		return out;
+	}
+
+	void DestroyBenchmarkWorld(FBenchmarkWorld& benchmarkWorld)
+	{
+		for (AActor* actor : benchmarkWorld.Actors)
+		{
+			actor->Destroy();
+		}
+		// These were never spawned, so there's nothing to take out of the level. The garbage collector gets them.
+		for (ABartlebyRoom* room : benchmarkWorld.Rooms)
+		{
+			room->MarkAsGarbage();
+		}
+		benchmarkWorld.System->MarkAsGarbage();
+		benchmarkWorld.Controller->MarkAsGarbage();
+		benchmarkWorld = FBenchmarkWorld();
+	}
+
+	// Times the functions that build prompts in worlds of 10, 1000 and 10000 rooms and objects, and writes a report
+	// that can be compared against one from another build with Tools/CompareBenchmarks.py. The iteration budget is
+	// divided by the number of rooms. Returns false if the report couldn't be written.
+	bool BenchmarkPrompt(UWorld* world, int32 budget, const FString& reportPath)
+	{
+		const int32 scales[] = { 10, 1000, 10000 };
+
+		TArray<uint8> report;
+		FBartlebyJsonWriter writer(report);
+		writer.BeginObject();
+		writer.WriteField("benchmark", FString(TEXT("Prompt")));
+		writer.WriteField("timestamp", FDateTime::UtcNow().ToIso8601());
+		writer.WriteField("platform", FString(FPlatformProperties::IniPlatformName()));
+		writer.WriteField("configuration", FString(LexToString(FApp::GetBuildConfiguration())));
+		writer.WriteKey("results");
+		writer.BeginArray();
+		UE_LOG(LogTemp, Display, TEXT("function,rooms,objects,doors,iterations,ns_per_op,allocs_per_op"));
+		for (const int32 scale : scales)
+		{
+			FRandomStream random(scale);
+			FBenchmarkWorld benchmarkWorld = MakeBenchmarkWorld(world, scale, scale, random);
+			ABartlebySystem* system = benchmarkWorld.System;
+			ABartlebyController* controller = benchmarkWorld.Controller;
+			// Some of these scan every room, so bigger worlds get fewer iterations to keep the whole run short.
+			const int32 numIterations = FMath::Clamp(budget / scale, 10, budget);
+			int32 query = 0;
+			auto nextQuery = [&query]()
+			{
+				query = (query + 1) % NumBenchmarkQueries;
+				return query;
+			};
+			auto addResult = [&](const ANSICHAR* function, const FBenchmarkResult& result)
+			{
+				const double nanoseconds = result.MicrosecondsPerOp * 1000.0;
+				UE_LOG(LogTemp, Display, TEXT("%s,%d,%d,%d,%d,%.1f,%.2f"), ANSI_TO_TCHAR(function), scale, scale,
+					system->Doors.Num(), numIterations, nanoseconds, result.AllocationsPerOp);
+				writer.BeginObject();
+				writer.WriteField("function", FString(function));
+				writer.WriteField("rooms", static_cast<double>(scale));
+				writer.WriteField("objects", static_cast<double>(scale));
+				writer.WriteField("doors", static_cast<double>(system->Doors.Num()));
+				writer.WriteField("iterations", static_cast<double>(numIterations));
+				writer.WriteField("ns_per_op", nanoseconds);
+				writer.WriteField("allocs_per_op", result.AllocationsPerOp);
+				writer.EndObject();
+			};
+
+			addResult("GetRoomOrNull", RunBenchmark(numIterations, [&]()
+				{
+					system->GetRoomOrNull(benchmarkWorld.QueryIds[nextQuery()]);
+				}));
+			addResult("GetRoomOrNull (misspelled)", RunBenchmark(numIterations, [&]()
+				{
+					system->GetRoomOrNull(benchmarkWorld.QueryMisspellings[nextQuery()]);
+				}));
+			addResult("GetRoomAtOrNull", RunBenchmark(numIterations, [&]()
+				{
+					system->GetRoomAtOrNull(benchmarkWorld.QueryPositions[nextQuery()]);
+				}));
+			addResult("GetDoorsAt", RunBenchmark(numIterations, [&]()
+				{
+					system->GetDoorsAt(benchmarkWorld.QueryIds[nextQuery()]);
+				}));
+			TArray<ABartlebyRoom*> route;
+			addResult("FindRoute", RunBenchmark(numIterations, [&]()
+				{
+					const int32 index = nextQuery();
+					system->FindRoute(benchmarkWorld.QueryRooms[index], benchmarkWorld.QueryRooms[(index + 1) % NumBenchmarkQueries], route);
+				}));
+			// Taking the snapshot is all the game thread pays for. Rendering it can happen anywhere.
+			addResult("CaptureStatus", RunBenchmark(numIterations, [&]()
+				{
+					const int32 index = nextQuery();
+					controller->CurrentRoom = benchmarkWorld.QueryRooms[index];
+					FBartlebyBenchmarkAccess::CaptureStatus(system, controller, benchmarkWorld.QueryPositions[index]);
+				}));
+			TArray<FBartlebyStatusSnapshot> snapshots;
+			for (int32 i = 0; i < NumBenchmarkQueries; i++)
+			{
+				controller->CurrentRoom = benchmarkWorld.QueryRooms[i];
+				snapshots.Add(FBartlebyBenchmarkAccess::CaptureStatus(system, controller, benchmarkWorld.QueryPositions[i]));
+			}
+			addResult("RenderStatus", RunBenchmark(numIterations, [&]()
+				{
+					snapshots[nextQuery()].Render(system->SeeGuestPrompt, system->GuestSaidPrompt);
+				}));
+			// The prompt itself doesn't look at the world, but the status that goes in it does, so use a real one.
+			const ABartlebySystem::BartlebyPromptSettings settings = FBartlebyBenchmarkAccess::MakePromptSettings(system);
+			const FString status = snapshots[0].Render(system->SeeGuestPrompt, system->GuestSaidPrompt);
+			addResult("GeneratePrompt", RunBenchmark(numIterations, [&]()
+				{
+					FBartlebyBenchmarkAccess::GeneratePrompt(settings, false, status);
+				}));
+			DestroyBenchmarkWorld(benchmarkWorld);
+		}
+		writer.EndArray();
+		writer.EndObject();
+		if (!FFileHelper::SaveArrayToFile(report, *reportPath))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Couldn't write the prompt benchmark report to %s."), *reportPath);
+			return false;
+		}
+		UE_LOG(LogTemp, Display, TEXT("Wrote the prompt benchmark report to %s."), *reportPath);
+		return true;
+	}
+
+	// Times adding made up memories to an episodic memory, and looking them up again, at the given number of memories.
+	void BenchmarkEpisodicMemory(const TArray<FString>& args)
+	{
+		const int32 numMemories = args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*args[0])) : 100000;
+		const int32 numQueries = args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*args[1])) : 1000;
+		static const TCHAR* Verbs[] = { TEXT("walk"), TEXT("say"), TEXT("pickup"), TEXT("drop"), TEXT("use"), TEXT("look") };
+		static const TCHAR* Words[] = { TEXT("painting"), TEXT("lamp"), TEXT("guest"), TEXT("statue"), TEXT("door"),
+			TEXT("key"), TEXT("book"), TEXT("window"), TEXT("music"), TEXT("dinner"), TEXT("rain"), TEXT("clock") };
+		FRandomStream random(1234);
+		auto makeMemory = [&](int32 i)
+		{
+			return FString::Printf(TEXT("in room_%d: %s(object_%d) action_result: the %s by the %s, %d"),
+				random.RandRange(0, 999), Verbs[random.RandRange(0, UE_ARRAY_COUNT(Verbs) - 1)], random.RandRange(0, 9999),
+				Words[random.RandRange(0, UE_ARRAY_COUNT(Words) - 1)], Words[random.RandRange(0, UE_ARRAY_COUNT(Words) - 1)], i);
+		};
+		TArray<FString> memories;
+		memories.Reserve(numMemories);
+		for (int32 i = 0; i < numMemories; i++)
+		{
+			memories.Add(makeMemory(i));
+		}
+		TArray<FString> queries;
+		for (int32 i = 0; i < numQueries; i++)
+		{
+			queries.Add(FString::Printf(TEXT("room_%d object_%d object_%d the guest said what about the %s?"),
+				random.RandRange(0, 999), random.RandRange(0, 9999), random.RandRange(0, 9999),
+				Words[random.RandRange(0, UE_ARRAY_COUNT(Words) - 1)]));
+		}
+
+		// Nothing is written to disk, so only indexing is timed.
+		FBartlebyEpisodicMemory memory;
+		const double insertStart = FPlatformTime::Seconds();
+		for (const FString& text : memories)
+		{
+			memory.Add(text);
+		}
+		const double insertSeconds = FPlatformTime::Seconds() - insertStart;
+
+		int32 nextQuery = 0;
+		TArray<FBartlebyEpisodicMemory::FRecall> recalls;
+		FBenchmarkResult query = RunBenchmark(numQueries, [&]()
+			{
+				memory.Query(queries[nextQuery], 3, 0, recalls);
+				nextQuery = (nextQuery + 1) % queries.Num();
+			});
+		UE_LOG(LogTemp, Display, TEXT("memories,insert_ns_per_op,query_us_per_op,query_allocs_per_op"));
+		UE_LOG(LogTemp, Display, TEXT("%d,%.1f,%.2f,%.1f"), memory.Num(), insertSeconds * 1e9 / numMemories,
+			query.MicrosecondsPerOp, query.AllocationsPerOp);
+	}
+
+	FAutoConsoleCommand BenchmarkEpisodicMemoryCommand(
+		TEXT("Bartleby.Benchmark.EpisodicMemory"),
+		TEXT("Times adding made up memories to an episodic memory and recalling the most relevant ones. Optional args: ")
+		TEXT("number of memories, number of queries."),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkEpisodicMemory));
+
+	// Times level load for the given number of objects and rooms: registering them all, then placing the objects in
+	// rooms in one pass. For comparison, also times looking for the system by searching the world, which every object
+	// used to do in BeginPlay.
+	void BenchmarkStartup(const TArray<FString>& args, UWorld* world)
+	{
+		if (!world)
+		{
+			return;
+		}
+		const int32 numObjects = args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*args[0])) : 10000;
+		const int32 numRooms = args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*args[1])) : 1000;
+		FRandomStream random(numObjects);
+		FBenchmarkWorld benchmarkWorld = MakeBenchmarkWorld(world, numRooms, 0, random);
+		ABartlebySystem* system = benchmarkWorld.System;
+		TArray<ABartlebyRoom*> rooms = MoveTemp(system->Rooms);
+		system->Rooms.Reset();
+		FActorSpawnParameters params;
+		params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		params.ObjectFlags = RF_Transient;
+		const float halfRoom = BenchmarkRoomSize * 0.4f;
+		TArray<UBartlebyObject*> objects;
+		objects.Reserve(numObjects);
+		for (int32 i = 0; i < numObjects; i++)
+		{
+			const ABartlebyRoom* room = rooms[random.RandRange(0, numRooms - 1)];
+			const FVector offset(random.FRandRange(-halfRoom, halfRoom), random.FRandRange(-halfRoom, halfRoom), 0.0f);
+			AActor* owner = world->SpawnActor<ATargetPoint>(room->Box->GetComponentLocation() + offset, FRotator::ZeroRotator, params);
+			// The component is never registered, so only the registry below sees it.
+			UBartlebyObject* object = NewObject<UBartlebyObject>(owner);
+			object->Id = FString::Printf(TEXT("exhibit_%d"), i);
+			objects.Add(object);
+			benchmarkWorld.Actors.Add(owner);
+		}
+
+		// A registry of our own, the same one the level's subsystem keeps, holding everything until it's resolved the
+		// way the subsystem does during load. Nothing here is garbage collected before it goes out of scope.
+		FBartlebyRegistry registry;
+		const double start = FPlatformTime::Seconds();
+		registry.RegisterSystem(system);
+		for (ABartlebyRoom* room : rooms)
+		{
+			registry.RegisterRoom(room);
+		}
+		for (UBartlebyObject* object : objects)
+		{
+			registry.RegisterObject(object);
+		}
+		const double registered = FPlatformTime::Seconds();
+		registry.ResolvePending();
+		const double resolved = FPlatformTime::Seconds();
+		int32 numPlaced = 0;
+		for (const UBartlebyObject* object : objects)
+		{
+			numPlaced += object->Room ? 1 : 0;
+		}
+
+		// Searching the world is too slow to do for every object, so time a few and multiply.
+		TArray<AActor*> found;
+		const int32 numScans = FMath::Min(numObjects, 100);
+		FBenchmarkResult scan = RunBenchmark(numScans, [&]()
+			{
+				UGameplayStatics::GetAllActorsOfClass(world, ABartlebySystem::StaticClass(), found);
+			});
+
+		UE_LOG(LogTemp, Display, TEXT("objects,rooms,placed,register_ns_per_object,resolve_ns_per_object,total_ms,scan_us_per_object,scan_total_ms"));
+		UE_LOG(LogTemp, Display, TEXT("%d,%d,%d,%.1f,%.1f,%.2f,%.2f,%.1f"), numObjects, numRooms, numPlaced,
+			(registered - start) * 1e9 / numObjects, (resolved - registered) * 1e9 / numObjects, (resolved - start) * 1e3,
+			scan.MicrosecondsPerOp, scan.MicrosecondsPerOp * numObjects * 1e-3);
+		DestroyBenchmarkWorld(benchmarkWorld);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs BenchmarkStartupCommand(
+		TEXT("Bartleby.Benchmark.Startup"),
+		TEXT("Times registering made up objects and rooms with a Bartleby registry, and placing the objects in rooms, ")
+		TEXT("as at level load. Optional args: number of objects, number of rooms."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchmarkStartup));
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// Times prompt generation and room lookups in made up worlds of 10, 1000 and 10000 rooms and objects, and writes a JSON
+// report. Takes -BartlebyBenchmarkBudget=<iterations> (divided by the number of rooms) and -BartlebyBenchmarkReport=<path>
+// on the command line.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBartlebyBenchmarkPromptTest, "Bartleby.Benchmark.Prompt",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FBartlebyBenchmarkPromptTest::RunTest(const FString& Parameters)
+{
+	int32 budget = 1000000;
+	FParse::Value(FCommandLine::Get(), TEXT("BartlebyBenchmarkBudget="), budget);
+	FString reportPath = FPaths::ProjectSavedDir() / TEXT("Bartleby/Benchmarks/Prompt.json");
+	FParse::Value(FCommandLine::Get(), TEXT("BartlebyBenchmarkReport="), reportPath);
+	UWorld* world = MakeTestWorld();
+	const bool wroteReport = BenchmarkPrompt(world, FMath::Max(1, budget), reportPath);
+	world->DestroyWorld(false);
+	return TestTrue(TEXT("Wrote the report"), wroteReport);
+}
+
+// Checks that the stream parser hands off the first action as soon as the line that completes it is in, on a made up
+// response split at every byte.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBartlebyStreamParserTest, "Bartleby.Stream.Parser",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBartlebyStreamParserTest::RunTest(const FString& Parameters)
+{
+	TestTrue(TEXT("Parsed a stream with \\n line ends"), CheckStreamParser("\n"));
+	TestTrue(TEXT("Parsed a stream with \\r\\n line ends"), CheckStreamParser("\r\n"));
+	return true;
+}
+
+// Checks that streamed answers from Tools/MockOpenAIServer.py hand off their first action before the stream ends. The
+// server has to be running. Takes -BartlebyStreamURL=<url> on the command line.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBartlebyStreamServerTest, "Bartleby.Stream.Server",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBartlebyStreamServerTest::RunTest(const FString& Parameters)
+{
+	FString url = TEXT("http://127.0.0.1:8080/v1/chat/completions");
+	FParse::Value(FCommandLine::Get(), TEXT("BartlebyStreamURL="), url);
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForStreamCheck(CheckStreamAgainstServer(url)));
+	return true;
+}
+
+// Walks to a room that isn't among the recent ones, and checks that the call prefetched on the way is the one that
+// goes ahead on arrival, rather than being thrown away for a status that lists different recent rooms. Nothing is sent.
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBartlebyPrefetchNewRoomTest, "Bartleby.Prefetch.NewRoom",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBartlebyPrefetchNewRoomTest::RunTest(const FString& Parameters)
+{
+	UWorld* world = MakeTestWorld();
+	FRandomStream random(4);
+	FBenchmarkWorld benchmarkWorld = MakeBenchmarkWorld(world, 4, 4, random);
+	ABartlebySystem* system = benchmarkWorld.System;
+	ABartlebyController* controller = benchmarkWorld.Controller;
+	FBartlebyBenchmarkAccess::PrepareForCalls(system);
+	system->IsEnabled = true;
+	system->UsePrefetch = true;
+	system->BuildPromptsInBackground = false;
+	// Calls wait in line instead of going out, where the guess can be checked.
+	system->MaxConcurrentRequests = 0;
+	ABartlebyRoom* from = system->Rooms[0];
+	ABartlebyRoom* to = system->Rooms[1];
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	params.ObjectFlags = RF_Transient;
+	ACharacter* character = world->SpawnActor<ACharacter>(from->Box->GetComponentLocation(), FRotator::ZeroRotator, params);
+	controller->OwnerCharacter = character;
+	controller->System = system;
+	controller->CurrentRoom = from;
+	controller->RecentPlaces = { from->Id };
+
+	FString error;
+	TestTrue(TEXT("Started walking to the next room"), controller->GoTo(to->Id, error));
+	TestTrue(TEXT("Prefetched the call for the next room"), controller->PrefetchCall.IsValid());
+	// Arrive the way OnMoveCompleted does. The pawn isn't possessed, so the status is taken where the guess said.
+	system->AppendMsg(controller, "action_result: You travelled to " + to->Id);
+	FBartlebyBenchmarkAccess::StartOpenAICall(system, controller,
+		FBartlebyBenchmarkAccess::CaptureStatus(system, controller, controller->PredictArrival(to, 100.0f)));
+	TestEqual(TEXT("Prefetched calls that went ahead"), system->PrefetchHits, 1);
+	TestEqual(TEXT("Prefetched calls that were thrown away"), system->PrefetchMisses, 0);
+
+	controller->GetWorldTimerManager().ClearTimer(controller->RetryMoveTimer);
+	character->Destroy();
+	DestroyBenchmarkWorld(benchmarkWorld);
+	world->DestroyWorld(false);
+	return true;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,220 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyCompletionCache.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	// Written at the start of the file, so we don't try to read something else as a cache.
+	const uint32 CacheFileMagic = 0x31434342; // "BCC1"
+	// Each record is the key, followed by the length of the answer and then the answer in UTF-8.
+	const int64 RecordHeaderSize = sizeof(FSHAHash::Hash) + sizeof(int32);
+}
+
+FBartlebyCompletionCache::FBartlebyCompletionCache(int32 maxMemoryEntries) :
+	Memory(FMath::Max(maxMemoryEntries, 1))
+{
+
+}
+
+FBartlebyCompletionCache::~FBartlebyCompletionCache()
+{
+	Close();
+}
+
+bool FBartlebyCompletionCache::Open(const FString& path)
+{
+	Close();
+	Path = path;
+	DiskIndex.Empty();
+
+	// Index whatever is already on disk. We only keep where the records are, not what's in them.
+	TArray<uint8> bytes;
+	int64 validSize = 0;
+	if (FFileHelper::LoadFileToArray(bytes, *Path, FILEREAD_Silent))
+	{
+		uint32 magic = 0;
+		if (bytes.Num() >= static_cast<int32>(sizeof(uint32)))
+		{
+			FMemory::Memcpy(&magic, bytes.GetData(), sizeof(uint32));
+		}
+		if (magic == CacheFileMagic)
+		{
+			int64 offset = sizeof(uint32);
+			while (offset + RecordHeaderSize <= bytes.Num())
+			{
+				FSHAHash key;
+				FMemory::Memcpy(key.Hash, bytes.GetData() + offset, sizeof(key.Hash));
+				int32 length = 0;
+				FMemory::Memcpy(&length, bytes.GetData() + offset + sizeof(key.Hash), sizeof(int32));
+				if (length < 0 || offset + RecordHeaderSize + length > bytes.Num())
+				{
+					break;
+				}
+				DiskIndex.Add(key, offset);
+				offset += RecordHeaderSize + length;
+			}
+			validSize = offset;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is not a completion cache, starting a new one."), *Path);
+		}
+	}
+
+	// If the game died halfway through a write, or this is a brand new cache, start clean so that appends line up.
+	if (validSize != bytes.Num() || validSize == 0)
+	{
+		if (validSize == 0)
+		{
+			bytes.SetNum(sizeof(uint32));
+			FMemory::Memcpy(bytes.GetData(), &CacheFileMagic, sizeof(uint32));
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Dropping a partial record at the end of %s."), *Path);
+			bytes.SetNum(validSize);
+		}
+		if (!FFileHelper::SaveArrayToFile(bytes, *Path))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unable to write the completion cache to %s."), *Path);
+			return false;
+		}
+	}
+
+	Writer = IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_Append | FILEWRITE_AllowRead);
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unable to open the completion cache at %s."), *Path);
+		return false;
+	}
+	OpenReader();
+	UE_LOG(LogTemp, Display, TEXT("Opened completion cache %s with %d entries."), *Path, DiskIndex.Num());
+	return true;
+}
+
+void FBartlebyCompletionCache::Close()
+{
+	if (Reader)
+	{
+		Reader->Close();
+		delete Reader;
+		Reader = nullptr;
+	}
+	if (Writer)
+	{
+		Writer->Close();
+		delete Writer;
+		Writer = nullptr;
+	}
+}
+
+FSHAHash FBartlebyCompletionCache::MakeKey(const TArray<uint8>& requestBody)
+{
+	FSHAHash key;
+	FSHA1::HashBuffer(requestBody.GetData(), requestBody.Num(), key.Hash);
+	return key;
+}
+
+bool FBartlebyCompletionCache::Find(const FSHAHash& key, FString& outCompletion)
+{
+	if (const FString* found = Memory.FindAndTouch(key))
+	{
+		outCompletion = *found;
+		NumHits++;
+		return true;
+	}
+	const int64* offset = DiskIndex.Find(key);
+	if (offset && ReadFromDisk(*offset, outCompletion))
+	{
+		AddToMemory(key, outCompletion);
+		NumHits++;
+		return true;
+	}
+	NumMisses++;
+	return false;
+}
+
+void FBartlebyCompletionCache::Add(const FSHAHash& key, const FString& completion)
+{
+	AddToMemory(key, completion);
+	if (!Writer || DiskIndex.Contains(key))
+	{
+		return;
+	}
+	FTCHARToUTF8 utf8(*completion);
+	int32 length = utf8.Length();
+	int64 offset = Writer->Tell();
+	Writer->Serialize(const_cast<uint8*>(key.Hash), sizeof(key.Hash));
+	Writer->Serialize(&length, sizeof(int32));
+	Writer->Serialize((ANSICHAR*)utf8.Get(), length);
+	Writer->Flush();
+	DiskIndex.Add(key, offset);
+}
+
+void FBartlebyCompletionCache::AddToMemory(const FSHAHash& key, const FString& completion)
+{
+	if (!Memory.Contains(key) && Memory.Num() >= Memory.Max())
+	{
+		NumEvictions++;
+	}
+	Memory.Add(key, completion);
+}
+
+void FBartlebyCompletionCache::OpenReader()
+{
+	if (Reader)
+	{
+		Reader->Close();
+		delete Reader;
+	}
+	Reader = IFileManager::Get().CreateFileReader(*Path, FILEREAD_AllowWrite | FILEREAD_Silent);
+}
+
+bool FBartlebyCompletionCache::ReadFromDisk(int64 offset, FString& outCompletion)
+{
+	// Records are flushed whole, so if the reader can see the start of one, it can see all of it.
+	if (Writer && (!Reader || offset + RecordHeaderSize > Reader->TotalSize()))
+	{
+		OpenReader();
+	}
+	if (!Reader || offset + RecordHeaderSize > Reader->TotalSize())
+	{
+		return false;
+	}
+	Reader->Seek(offset + sizeof(FSHAHash::Hash));
+	int32 length = 0;
+	Reader->Serialize(&length, sizeof(int32));
+	if (length < 0 || offset + RecordHeaderSize + length > Reader->TotalSize())
+	{
+		return false;
+	}
+	TArray<uint8> bytes;
+	bytes.SetNumUninitialized(length);
+	Reader->Serialize(bytes.GetData(), length);
+	FUTF8ToTCHAR converter(reinterpret_cast<const ANSICHAR*>(bytes.GetData()), length);
+	outCompletion = FString(converter.Length(), converter.Get());
+	return true;
+}
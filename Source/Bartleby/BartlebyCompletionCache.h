@@ -0,0 +1,77 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "Misc/SecureHash.h"
+
+// Remembers what the AI said for a given request body, so that the exact same request never has to be sent twice.
+// Recently used answers are kept in memory. Every answer is also appended to a single file on disk, which is indexed
+// when the cache is opened so that it survives restarts.
+class BARTLEBY_API FBartlebyCompletionCache
+{
+public:
+	FBartlebyCompletionCache(int32 maxMemoryEntries);
+	~FBartlebyCompletionCache();
+
+	// Opens (or creates) the cache file, and indexes whatever is already in it. Returns false if it can't be written.
+	bool Open(const FString& path);
+	// Closes the cache file. Whatever is in memory is still usable.
+	void Close();
+
+	// Makes the key for the given request body, as UTF-8.
+	static FSHAHash MakeKey(const TArray<uint8>& requestBody);
+
+	// Looks up what the AI said for the given key, first in memory and then on disk.
+	bool Find(const FSHAHash& key, FString& outCompletion);
+	// Remembers what the AI said for the given key.
+	void Add(const FSHAHash& key, const FString& completion);
+
+	int32 GetNumHits() const { return NumHits; }
+	int32 GetNumMisses() const { return NumMisses; }
+	int32 GetNumEvictions() const { return NumEvictions; }
+	int32 GetNumOnDisk() const { return DiskIndex.Num(); }
+
+private:
+	// Adds to the memory tier, counting anything that falls out of it.
+	void AddToMemory(const FSHAHash& key, const FString& completion);
+	// Reads the record at the given offset of the cache file.
+	bool ReadFromDisk(int64 offset, FString& outCompletion);
+	// Opens the cache file for reading, closing it first if it was already open.
+	void OpenReader();
+
+	// Most recently used answers.
+	TLruCache<FSHAHash, FString> Memory;
+	// Where each answer lives in the cache file.
+	TMap<FSHAHash, int64> DiskIndex;
+	FString Path;
+	FArchive* Writer = nullptr;
+	// Kept open for reading answers back. It only knows how big the file was when it was opened, so it's opened
+	// again when it's asked for something written after that.
+	FArchive* Reader = nullptr;
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+	int32 NumEvictions = 0;
+};
@@ -0,0 +1,123 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyConnectionManager.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+
+FBartlebyConnectionManager::FBartlebyConnectionManager(const FString& url, float keepAliveInterval) :
+	URL(url), KeepAliveInterval(keepAliveInterval)
+{
+}
+
+void FBartlebyConnectionManager::Warm()
+{
+	if (IsPinging)
+	{
+		return;
+	}
+	IsPinging = true;
+	NumPings++;
+	// A HEAD request gets turned away without doing any work or costing anything, but it still has to connect.
+	FHttpRequestRef request = FHttpModule::Get().CreateRequest();
+	request->SetURL(URL);
+	request->SetVerb(TEXT("HEAD"));
+	const double startTime = FPlatformTime::Seconds();
+	TWeakPtr<FBartlebyConnectionManager> weakThis = AsShared();
+	request->OnProcessRequestComplete().BindLambda([weakThis, startTime](FHttpRequestPtr pRequest, FHttpResponsePtr pResponse, bool connectedSuccessfully)
+		{
+			TSharedPtr<FBartlebyConnectionManager> manager = weakThis.Pin();
+			if (manager)
+			{
+				manager->OnPingFinished(startTime, connectedSuccessfully && pResponse);
+			}
+		});
+	request->ProcessRequest();
+}
+
+void FBartlebyConnectionManager::Tick(double now)
+{
+	if (KeepAliveInterval > 0.0f && now >= NextPingTime)
+	{
+		Warm();
+	}
+}
+
+void FBartlebyConnectionManager::OnRequestSent(double now)
+{
+	if (IsWarm(now))
+	{
+		NumWarmRequests++;
+	}
+	else
+	{
+		NumColdRequests++;
+	}
+	// Pinging while a request is out would just open a second connection.
+	NextPingTime = now + KeepAliveInterval;
+}
+
+void FBartlebyConnectionManager::OnRequestFinished(double now, bool wasConnectionError)
+{
+	LastActivityTime = wasConnectionError ? 0.0 : now;
+	NextPingTime = now + KeepAliveInterval;
+}
+
+float FBartlebyConnectionManager::GetReuseRatio() const
+{
+	const int32 numRequests = NumWarmRequests + NumColdRequests;
+	return numRequests > 0 ? static_cast<float>(NumWarmRequests) / numRequests : 0.0f;
+}
+
+bool FBartlebyConnectionManager::IsWarm(double now) const
+{
+	return LastActivityTime > 0.0 && now - LastActivityTime < IdleTimeout;
+}
+
+void FBartlebyConnectionManager::OnPingFinished(double startTime, bool connected)
+{
+	IsPinging = false;
+	const double now = FPlatformTime::Seconds();
+	// If the server can't be reached, don't keep trying every frame.
+	NextPingTime = now + KeepAliveInterval;
+	if (!connected)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't warm up a connection to %s."), *URL);
+		LastActivityTime = 0.0;
+		return;
+	}
+	const bool wasWarm = IsWarm(now);
+	const double pingTime = now - startTime;
+	if (wasWarm)
+	{
+		NumWarmPings++;
+		TotalWarmPingTime += pingTime;
+	}
+	else if (ColdPingTime == 0.0f)
+	{
+		ColdPingTime = static_cast<float>(pingTime);
+		UE_LOG(LogTemp, Display, TEXT("Connected to %s in %.0f ms."), *URL, pingTime * 1000.0);
+	}
+	LastActivityTime = now;
+}
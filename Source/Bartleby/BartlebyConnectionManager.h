@@ -0,0 +1,79 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Keeps a connection to the AI's server open, so that calls don't pay for DNS, TCP and TLS setup. The HTTP module
+// reuses connections to the same host on its own, so all this has to do is open one early with a cheap request, and
+// poke it again before the server closes it for being idle. It also keeps track of how many calls went out over a
+// connection that should have been warm.
+class BARTLEBY_API FBartlebyConnectionManager : public TSharedFromThis<FBartlebyConnectionManager>
+{
+public:
+	// The URL is the one calls are made to. Pings go to the same host, so they warm up the same connection.
+	FBartlebyConnectionManager(const FString& url, float keepAliveInterval);
+
+	// Opens a connection now, unless one is already being opened.
+	void Warm();
+	// Pings the server if nothing has gone to it for longer than the keep-alive interval.
+	void Tick(double now);
+
+	// Call when a request is sent to the server. Counts whether it should have gone out over a warm connection.
+	void OnRequestSent(double now);
+	// Call when a request to the server finishes. If it couldn't connect, the connection is assumed to be gone.
+	void OnRequestFinished(double now, bool wasConnectionError);
+
+	int32 GetNumWarmRequests() const { return NumWarmRequests; }
+	int32 GetNumColdRequests() const { return NumColdRequests; }
+	int32 GetNumPings() const { return NumPings; }
+	// Fraction of requests that went out over a warm connection.
+	float GetReuseRatio() const;
+	// How long the first ping took, which includes setting up the connection.
+	float GetColdPingTime() const { return ColdPingTime; }
+	// Average time of the pings after that, which should just be a round trip.
+	float GetWarmPingTime() const { return NumWarmPings > 0 ? static_cast<float>(TotalWarmPingTime / NumWarmPings) : 0.0f; }
+
+private:
+	// True if a connection was used recently enough that the server should still have it open.
+	bool IsWarm(double now) const;
+	void OnPingFinished(double startTime, bool connected);
+
+	// Servers usually drop keep-alive connections that have been idle for about this long, in seconds.
+	static constexpr double IdleTimeout = 60.0;
+
+	FString URL;
+	float KeepAliveInterval = 20.0f;
+	// When anything last came back from the server, or 0 if nothing has.
+	double LastActivityTime = 0.0;
+	// When to ping next, unless something else talks to the server first.
+	double NextPingTime = 0.0;
+	bool IsPinging = false;
+	int32 NumWarmRequests = 0;
+	int32 NumColdRequests = 0;
+	int32 NumPings = 0;
+	int32 NumWarmPings = 0;
+	double TotalWarmPingTime = 0.0;
+	float ColdPingTime = 0.0f;
+};
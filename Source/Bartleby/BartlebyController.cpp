@@ -28,162 +28,315 @@ SOFTWARE.
 #include "Bartleby/BartlebyRoom.h"
 #include "Bartleby/BartlebyObject.h"
 #include "GameFramework/CharacterMovementComponent.h"
-#include "Kismet/GameplayStatics.h"
 #include "GameFramework/Character.h"
+#include "Bartleby/BartlebyTrace.h"
+#include "Bartleby/BartlebySubsystem.h"
+#include "Components/SphereComponent.h"
+#include "TimerManager.h"
 
 void ABartlebyController::BeginPlay()
 {
 	Super::BeginPlay();
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ABartlebySystem::StaticClass(), FoundActors);
+	if (!GetCharacter())
+	{
+		UE_LOG(LogTemp, Error,  TEXT("No character?"));
+		return;
+	}
 
-	for (AActor* actor : FoundActors)
+	OwnerCharacter = Cast<ACharacter>(GetCharacter());
+	SetActorTickInterval(TickInterval);
+	// The subsystem calls Connect once the system and the rooms are there.
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
 	{
-		System = Cast<ABartlebySystem>(actor);
-		if (System)
-		{
-			break;
-		}
+		subsystem->RegisterController(this);
 	}
+}
 
-	if (!GetCharacter())
+void ABartlebyController::Connect(ABartlebySystem* system)
+{
+	System = system;
+	if (!OwnerCharacter)
 	{
-		UE_LOG(LogTemp, Error,  TEXT("No character?"));
 		return;
 	}
+	CurrentRoom = System->GetRoomAtOrNull(OwnerCharacter->GetActorLocation());
+	System->RegisterController(this);
+	// Walk to the middle of the room we start in.
+	TargetActor = CurrentRoom;
+	StartMove();
+}
 
-	if (System)
+void ABartlebyController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+	if (!InPawn)
 	{
-		CurrentRoom = System->GetRoomAtOrNull(GetCharacter()->GetActorLocation());
-		System->Controller = this;
+		return;
+	}
+	if (!ProximitySphere)
+	{
+		// Only guests overlap it, and only their capsules are counted.
+		ProximitySphere = NewObject<USphereComponent>(this, TEXT("ProximitySphere"));
+		ProximitySphere->InitSphereRadius(GuestNearDistance);
+		ProximitySphere->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
+		ProximitySphere->SetCollisionObjectType(ECC_WorldDynamic);
+		ProximitySphere->SetCollisionResponseToAllChannels(ECR_Ignore);
+		ProximitySphere->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
+		ProximitySphere->SetGenerateOverlapEvents(true);
+		ProximitySphere->OnComponentBeginOverlap.AddDynamic(this, &ABartlebyController::OnProximityBeginOverlap);
+		ProximitySphere->OnComponentEndOverlap.AddDynamic(this, &ABartlebyController::OnProximityEndOverlap);
+		ProximitySphere->RegisterComponent();
 	}
+	NumGuestsNear = 0;
+	ProximitySphere->AttachToComponent(InPawn->GetRootComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+}
 
-	OwnerCharacter = Cast<ACharacter>(GetCharacter());
+void ABartlebyController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
+	{
+		subsystem->UnregisterController(this);
+	}
+	if (System)
+	{
+		System->UnregisterController(this);
+	}
+	Super::EndPlay(EndPlayReason);
 }
 
 void ABartlebyController::Tick(float dt)
 {
+	BARTLEBY_TRACE_SCOPE(ControllerTick);
 	Super::Tick(dt);
 	if (!OwnerCharacter)
 	{
 		return;
 	}
-	if (IsWaitingForScriptedEvent)
+
+	// Only the one the player is talking to has to stop and listen.
+	const bool shouldPause = IsWaitingForScriptedEvent || (System && System->IsWaitingOnInput && System->InputController == this);
+	if (shouldPause != IsPaused)
 	{
-		StopMovement();
-		return;
+		IsPaused = shouldPause;
+		if (IsPaused)
+		{
+			StopMovement();
+		}
+		else if (state == State::GoingToRoom || state == State::GoingToObject)
+		{
+			StartMove();
+		}
 	}
-
-	if (System && System->IsWaitingOnInput)
+	if (IsPaused)
 	{
-		StopMovement();
 		return;
 	}
 
 	switch (state)
 	{
-		case State::GoingToRoom:
+		case State::TalkingOrThinking:
 		{
-			GetCharacter()->GetCharacterMovement()->bOrientRotationToMovement = true;
-			ClearFocus(EAIFocusPriority::Gameplay);
-			MoveToActor(CurrentRoom, 100.0f);
-			// If in the room, select a random target.
-			if (CurrentRoom && FVector::Dist2D(CurrentRoom->GetActorLocation(), GetCharacter()->GetActorLocation()) < 150.0f)
+			// Done talking, so start waiting for the AI.
+			CurrentObject = nullptr;
+			SetState(State::WaitingForAI);
+			break;
+		}
+		case State::WaitingForAI:
+		{
+			// The last call failed, so kick off a new AI round. Otherwise, the system will call OnOpenAICallback when it's done.
+			if (!IsWaitingOnOpenAI)
 			{
-				System->AppendMsg("action_result: You travelled to " + CurrentRoom->Id);
-				state = State::WaitForPlayerToGetNear;
+				System->StartOpenAICall(this);
 			}
 			break;
 		}
-		case State::GoingToObject :
+		default:
+			break;
+	}
+}
+
+void ABartlebyController::DispatchCompletedCalls()
+{
+	ABartlebySystem::BartlebyCallResult result;
+	while (CompletedCalls->Dequeue(result))
+	{
+		if (System)
 		{
-			GetCharacter()->GetCharacterMovement()->bOrientRotationToMovement = true;
-			ClearFocus(EAIFocusPriority::Gameplay);
-			// Wait for the player to get near after going to the object.
+			System->OnCallCompleted(result);
+		}
+	}
+}
+
+void ABartlebyController::StartMove()
+{
+	GetWorldTimerManager().ClearTimer(RetryMoveTimer);
+	if (!OwnerCharacter || !TargetActor || IsPaused)
+	{
+		return;
+	}
+	const bool toRoom = state == State::GoingToRoom;
+	if (!toRoom && state != State::GoingToObject)
+	{
+		return;
+	}
+	OwnerCharacter->GetCharacterMovement()->bOrientRotationToMovement = true;
+	ClearFocus(EAIFocusPriority::Gameplay);
+	if (!toRoom)
+	{
+		SetFocus(TargetActor);
+	}
+	const float radius = toRoom ? 100.0f : 200.0f;
+	// Only the last room on the route is worth guessing the next call for.
+	if (!HasPrefetched && (!toRoom || Route.Num() == 0))
+	{
+		HasPrefetched = true;
+		System->PrefetchOpenAICall(this, PredictArrival(TargetActor, radius), toRoom ? "action_result: You travelled to " + CurrentRoom->Id : "");
+	}
+	// If we're already there, this finishes the move right away through OnMoveCompleted.
+	if (MoveToActor(TargetActor, radius) == EPathFollowingRequestResult::Failed)
+	{
+		GetWorldTimerManager().SetTimer(RetryMoveTimer, this, &ABartlebyController::StartMove, RetryMoveDelay);
+	}
+}
+
+void ABartlebyController::OnMoveCompleted(FAIRequestID RequestID, const FPathFollowingResult& Result)
+{
+	Super::OnMoveCompleted(RequestID, Result);
+	if (state != State::GoingToRoom && state != State::GoingToObject)
+	{
+		return;
+	}
+	// Moves get aborted when a new one replaces them, or when we stop for a scripted event. Either way, someone else
+	// has already decided what to do next.
+	if (Result.HasFlag(FPathFollowingResultFlags::NewRequest) || IsPaused)
+	{
+		return;
+	}
+	if (!Result.IsSuccess())
+	{
+		// Blocked, or lost the path. Try again in a bit, the way is probably clear by then.
+		GetWorldTimerManager().SetTimer(RetryMoveTimer, this, &ABartlebyController::StartMove, RetryMoveDelay);
+		return;
+	}
+	if (state == State::GoingToRoom && Route.Num() > 0)
+	{
+		// On to the next room.
+		CurrentRoom = Route[0];
+		TargetActor = CurrentRoom;
+		Route.RemoveAt(0);
+		StartMove();
+		return;
+	}
+	if (state == State::GoingToRoom && CurrentRoom)
+	{
+		System->AppendMsg(this, "action_result: You travelled to " + CurrentRoom->Id);
+	}
+	// Wait for the player to get near after getting there.
+	SetState(State::WaitForPlayerToGetNear);
+}
+
+void ABartlebyController::OnProximityBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
+	UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	const APawn* pawn = Cast<APawn>(OtherActor);
+	// A guest's mesh overlaps as well as their capsule, so only count the capsule.
+	if (!pawn || !pawn->IsPlayerControlled() || OtherComp != pawn->GetRootComponent())
+	{
+		return;
+	}
+	NumGuestsNear++;
+	// The player is near, so start the next round of ai stuff.
+	if (state == State::WaitForPlayerToGetNear)
+	{
+		SetState(State::WaitingForAI);
+	}
+}
+
+void ABartlebyController::OnProximityEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
+	UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	const APawn* pawn = Cast<APawn>(OtherActor);
+	if (!pawn || !pawn->IsPlayerControlled() || OtherComp != pawn->GetRootComponent())
+	{
+		return;
+	}
+	NumGuestsNear = FMath::Max(NumGuestsNear - 1, 0);
+}
+
+void ABartlebyController::SetState(State newState)
+{
+	if (newState == state)
+	{
+		return;
+	}
+	BartlebyTrace::OutputControllerState(this, static_cast<uint8>(state), static_cast<uint8>(newState));
+	state = newState;
+	if (!OwnerCharacter)
+	{
+		return;
+	}
+	APlayerController* playerController = GetWorld()->GetFirstPlayerController();
+	ACharacter* player = playerController ? playerController->GetCharacter() : nullptr;
+	switch (state)
+	{
+		case State::WaitForPlayerToGetNear:
+		{
+			OwnerCharacter->GetCharacterMovement()->bOrientRotationToMovement = false;
 			if (TargetActor)
 			{
 				SetFocus(TargetActor);
-				MoveToActor(TargetActor, 200.0f);
-				if (FVector::Dist2D(TargetActor->GetActorLocation(), GetCharacter()->GetActorLocation()) < 250.0f)
-				{
-					state = State::WaitForPlayerToGetNear;
-				}
 			}
-			
-			break;
-		}
-		case State::WaitForPlayerToGetNear :
-		{
-			GetCharacter()->GetCharacterMovement()->bOrientRotationToMovement = false;
-			APlayerController* playerController = GetWorld()->GetFirstPlayerController();
-			if (playerController)
+			else if (player)
 			{
-				if (TargetActor)
-				{
-					SetFocus(TargetActor);
-				}
-				else
-				{
-					SetFocus(playerController->GetCharacter(), EAIFocusPriority::Gameplay);
-				}
-				FVector actorPos = playerController->GetCharacter()->GetActorLocation();
-				// If the player is near, start the next round of ai stuff.
-				if (FVector::Dist2D(actorPos, GetCharacter()->GetActorLocation()) < 300.0f)
-				{
-					state = State::WaitingForAI;
-				}
+				SetFocus(player, EAIFocusPriority::Gameplay);
 			}
-			break;
-		}
-		case State::TalkingOrThinking:
-		{
-			// Wait until we're not saying anything more.
-			if (IsWaitingForScriptedEvent)
+			// They may have been waiting for us.
+			if (NumGuestsNear > 0)
 			{
-				return;
+				SetState(State::WaitingForAI);
 			}
-			CurrentObject = nullptr;
-			// Done talking, so start waiting for the AI.
-			state = State::WaitingForAI;
 			break;
 		}
 		case State::WaitingForAI:
 		{
-			GetCharacter()->GetCharacterMovement()->bOrientRotationToMovement = false;
-			APlayerController* playerController = GetWorld()->GetFirstPlayerController();
-			if (playerController)
-			{
-				SetFocus(playerController->GetCharacter(), EAIFocusPriority::Gameplay);
-			}
-			// If already waiting on the AI, do nothing.
-			if (System->IsWaitingOnOpenAI) 
+			OwnerCharacter->GetCharacterMovement()->bOrientRotationToMovement = false;
+			if (player)
 			{
-				return;
+				SetFocus(player, EAIFocusPriority::Gameplay);
 			}
-			if (!System->LastThingOpenAISaid.IsEmpty())
+			if (!IsWaitingOnOpenAI && !IsPaused)
 			{
-				OnOpenAICallback(System->LastThingOpenAISaid);
-				System->LastThingOpenAISaid = "";
-				return;
+				System->StartOpenAICall(this);
 			}
-			// Otherwise, kick off a new AI round.
-			System->StartOpenAICall();
 			break;
 		}
+		default:
+			break;
 	}
 }
 
-
+FVector ABartlebyController::PredictArrival(AActor* target, float radius) const
+{
+	// Guess that we'll stop at the edge of the radius, coming from where we are now.
+	FVector targetPos = target->GetActorLocation();
+	FVector toSelf = OwnerCharacter->GetActorLocation() - targetPos;
+	toSelf.Z = 0.0f;
+	return targetPos + toSelf.GetSafeNormal() * FMath::Min(radius, toSelf.Size());
+}
 
 void ABartlebyController::OnOpenAICallback(const FString& command)
 {
+	// Cleared first, since arriving somewhere right away can start the next call. Only if it was said to us, though.
+	if (System && System->InputController == this)
+	{
+		System->LastThingPlayerSaid = "";
+	}
 	FString error;
 	if (!TryDo(command, error))
 	{
 		UE_LOG(LogTemp, Error,  TEXT("%s"), *error);
-		System->AppendMsg(error);
+		System->AppendMsg(this, error);
 	}
-	System->LastThingPlayerSaid = "";
 }
 
 bool ABartlebyController::GoTo(const FString& LocationID, FString& errorMessage)
@@ -194,32 +347,54 @@ bool ABartlebyController::GoTo(const FString& LocationID, FString& errorMessage)
 		errorMessage = "No sys";
 		return false;
 	}
-	ABartlebyRoom* room = System->GetRoomOrNull(LocationID);
+	float confidence = 0.0f;
+	ABartlebyRoom* room = System->FindRoomOrNull(LocationID, confidence);
 	if (!room)
 	{
 		UE_LOG(LogTemp, Error,  TEXT("No Room called \"%s\""), *LocationID);
 		errorMessage = "Cannot go to that room from here.";
 		return false;
 	}
-	state = State::GoingToRoom;
-	CurrentRoom = room;
-	TargetActor = room;
-	MoveToActor(CurrentRoom, 100.0f);
-	if (!RecentPlaces.Contains(LocationID))
+	if (confidence < 1.0f)
 	{
-		RecentPlaces.Add(LocationID);
+		UE_LOG(LogTemp, Display,  TEXT("Bartleby took \"%s\" to mean %s (%.2f)"), *LocationID, *room->Id, confidence);
+	}
+	// Rooms that aren't next door are walked to one room at a time, without asking the AI at each one.
+	TArray<ABartlebyRoom*> route;
+	if (!CurrentRoom || System->NumDoors == 0)
+	{
+		route.Add(room);
+	}
+	else if (!System->FindRoute(CurrentRoom, room, route))
+	{
+		UE_LOG(LogTemp, Error,  TEXT("No way from %s to %s"), *CurrentRoom->Id, *room->Id);
+		errorMessage = "Cannot go to that room from here.";
+		return false;
+	}
+	// What the room is really called, not how the AI spelled it. This has to be in before the move starts, since the
+	// prefetched call is made from it, and so is the arrival call when we're already there.
+	if (!RecentPlaces.Contains(room->Id))
+	{
+		RecentPlaces.Add(room->Id);
 		if (RecentPlaces.Num() > 5)
 		{
-			RecentPlaces.Remove(LocationID);
+			RecentPlaces.Remove(room->Id);
 		}
 	}
+	SetState(State::GoingToRoom);
+	HasPrefetched = false;
+	CurrentRoom = route[0];
+	TargetActor = CurrentRoom;
+	route.RemoveAt(0);
+	Route = MoveTemp(route);
+	StartMove();
 	return true;
 }
 
 void ABartlebyController::Say(const FString& Phrase)
 {
 	UE_LOG(LogTemp, Display,  TEXT("Bartleby Say %s"), *Phrase);
-	state = State::TalkingOrThinking;
+	SetState(State::TalkingOrThinking);
 	if (System)
 	{
 		System->Say(GetCharacter(), CharacterName, Phrase);
@@ -229,7 +404,7 @@ void ABartlebyController::Say(const FString& Phrase)
 void ABartlebyController::Think(const FString& Phrase)
 {
 	UE_LOG(LogTemp, Display,  TEXT("Bartleby Think %s"), *Phrase);
-	state = State::TalkingOrThinking;
+	SetState(State::TalkingOrThinking);
 	if (System)
 	{
 		System->Say(GetCharacter(), CharacterName + " (Thinking)", Phrase);
@@ -245,17 +420,8 @@ bool ABartlebyController::Examine(const FString& Target, FString& errorMessage)
 		errorMessage = "No room";
 		return false;
 	}
-	TArray<UBartlebyObject*> objects = CurrentRoom->Objects;
-	UBartlebyObject* targetObject = nullptr;
-	FString lower = Target.ToLower();
-	for (UBartlebyObject* obj : objects)
-	{
-		if (obj->Id == Target || obj->Id.ToLower().Contains(lower))
-		{
-			targetObject = obj;
-			break;
-		}
-	}
+	float confidence = 0.0f;
+	UBartlebyObject* targetObject = CurrentRoom->FindObjectOrNull(Target, System->MinIdConfidence, confidence);
 	CurrentObject = targetObject;
 	if (targetObject == nullptr)
 	{
@@ -263,9 +429,16 @@ bool ABartlebyController::Examine(const FString& Target, FString& errorMessage)
 		errorMessage = "action_result: Error. could not find the object in the current room.";
 		return false;
 	}
-	System->AppendMsg("action_result: " + CurrentObject->Description);
+	if (confidence < 1.0f)
+	{
+		UE_LOG(LogTemp, Display,  TEXT("Bartleby took \"%s\" to mean %s (%.2f)"), *Target, *targetObject->Id, confidence);
+	}
+	System->AppendMsg(this, "action_result: " + CurrentObject->Description);
 	TargetActor = targetObject->GetOwner();
-	state = State::GoingToObject;
+	Route.Reset();
+	SetState(State::GoingToObject);
+	HasPrefetched = false;
+	StartMove();
 	return true;
 	
 }
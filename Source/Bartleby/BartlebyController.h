@@ -26,10 +26,14 @@ SOFTWARE.
 
 #include "CoreMinimal.h"
 #include "AIController.h"
+#include "Navigation/PathFollowingComponent.h"
+#include "Bartleby/BartlebySystem.h"
 
 #include "BartlebyController.generated.h"
 
-// Implements an AI controller used by the Bartleby system.
+// Implements an AI controller used by the Bartleby system. It doesn't poll: moves finish through OnMoveCompleted, guests
+// are noticed by a sphere around the pawn, and answers from the AI are dispatched as they come in. It only ticks a few
+// times a second, to watch for scripted events and to turn toward whatever it's looking at.
 UCLASS()
 class BARTLEBY_API ABartlebyController : public AAIController
 {
@@ -37,6 +41,11 @@ class BARTLEBY_API ABartlebyController : public AAIController
 public:
 	virtual void Tick(float dt) override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void OnPossess(APawn* InPawn) override;
+	virtual void OnMoveCompleted(FAIRequestID RequestID, const FPathFollowingResult& Result) override;
+	// Hooks the controller up to the system, and starts it off in the room it's in. Called by UBartlebySubsystem.
+	void Connect(ABartlebySystem* system);
 
 	enum class State
 	{
@@ -53,6 +62,10 @@ public:
 	UPROPERTY()
 		class ABartlebyRoom* CurrentRoom = nullptr;
 
+	// Rooms still to walk through on the way to where the AI said to go, after CurrentRoom.
+	UPROPERTY()
+		TArray<class ABartlebyRoom*> Route;
+
 	UPROPERTY()
 		class ACharacter* OwnerCharacter = nullptr;
 
@@ -75,6 +88,44 @@ public:
 		void OnOpenAICallback(const FString& command);
 
 	State state = State::GoingToRoom;
+	// Changes the state, records the change for Unreal Insights, and does whatever the new state starts with.
+	void SetState(State newState);
+	// Walks to the target of the current state, or tries again to.
+	void StartMove();
+	// Dispatches the answers from the AI that came in on the HTTP thread. Called on the game thread as they come in.
+	void DispatchCompletedCalls();
+
+	// Seconds between ticks. Nothing waits on the tick but scripted events, retrying a failed call, and turning toward
+	// the focus, so it can be slow. Turning is smooth with bUseControllerDesiredRotation on the character.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		float TickInterval = 0.1f;
+
+	// How close a guest has to come before the AI stops to talk to them.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		float GuestNearDistance = 300.0f;
+
+	// Seconds to wait before trying again when a move fails.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+		float RetryMoveDelay = 1.0f;
+
+	// Number of guests within GuestNearDistance.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly)
+		int32 NumGuestsNear = 0;
+
+	// Notices guests coming and going.
+	UPROPERTY()
+		class USphereComponent* ProximitySphere = nullptr;
+
+	// Counts a guest coming near, and turns to talk to them if we were waiting for one.
+	UFUNCTION()
+		void OnProximityBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp,
+			int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	// Counts a guest walking away.
+	UFUNCTION()
+		void OnProximityEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp,
+			int32 OtherBodyIndex);
+
 	UPROPERTY()
 		AActor* TargetActor = nullptr;
 
@@ -91,4 +142,81 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	bool IsWaitingForScriptedEvent = false;
 
+	// If true, this AI is waiting on OpenAI to say something.
+	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
+		bool IsWaitingOnOpenAI = false;
+
+	// Stores the last thing that the OpenAI system returned for this AI.
+	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
+		FString LastThingOpenAISaid = "";
+
+	// Stores the last prompt that was given to the AI.
+	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly, Category = "Prompt")
+		FString LastFullPrompt = "";
+
+	// Number of tokens in the last prompt that was given to the AI, including the whole log.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		int32 LastPromptTokens = 0;
+
+	// Number of bytes at the start of the last request that were the same as the request before.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		int32 LastPrefixMatchBytes = 0;
+
+	// Fraction of the last request that was the same as the request before, from the start.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		float LastPrefixMatchFraction = 0.0f;
+
+	// The last request body that was sent, as UTF-8, for measuring how stable the prefix is.
+	TArray<uint8> LastRequestBody;
+
+	// A circular buffer of log messages. Log messages are removed from the front of the list
+	// when we exceed MaxPromptTokens (or MaxNumLogElements).
+	std::deque<ABartlebySystem::BartlebyLogElement> Log;
+
+	// Bumped every time the log changes, so prefetched calls know if they're stale.
+	int32 LogRevision = 0;
+
+	// Summary of what fell off the front of the log, if the system's UseMemorySummary is on.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		FString MemorySummary;
+
+	// Number of tokens the summary takes up in the prompt.
+	int32 MemorySummaryTokens = 0;
+
+	// What fell off the log while a summary was already being made, to go in the next one.
+	TArray<FBartlebyMemoryEntry> PendingMemory;
+
+	// True while a summary is being made.
+	bool IsSummarizingMemory = false;
+
+	// Everything this AI did and was told, if the system's UseEpisodicMemory is on.
+	TSharedPtr<class FBartlebyEpisodicMemory> EpisodicMemory;
+
+	// The last thing a guest said that was remembered, so it's only remembered once.
+	FString LastRememberedUtterance;
+
+	// Current dump of strings that we are going to send the AI on the next iteartion.
+	FString AppendedMsg;
+
+	// Number of memories in the episodic memory before the first of the appended messages was remembered.
+	int32 AppendedFirstMemory = 0;
+
+	// The speculative call made while walking, if any.
+	TSharedPtr<ABartlebySystem::BartlebyCall> PrefetchCall;
+
+	// Answers from the AI that came in on the HTTP thread, waiting to be dispatched on the next tick.
+	TSharedRef<ABartlebySystem::BartlebyResultQueue> CompletedCalls = MakeShared<ABartlebySystem::BartlebyResultQueue>();
+
+	// True once the next AI call has been prefetched for the current move.
+	bool HasPrefetched = false;
+
+	// True while the AI is held still for a scripted event or for the player to finish typing.
+	bool IsPaused = false;
+
+	// Tries a failed move again.
+	FTimerHandle RetryMoveTimer;
+
+	// Guesses where we will stop when walking up to the target with the given acceptance radius.
+	FVector PredictArrival(AActor* target, float radius) const;
+
 };
@@ -0,0 +1,325 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyEpisodicMemory.h"
+#include "Algo/Unique.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	// Written at the start of the file, so we don't try to read something else as memories.
+	const uint32 MemoryFileMagic = 0x314D4542; // "BEM1"
+	// Each record is the length of the memory, and then the memory in UTF-8.
+	const int64 RecordHeaderSize = sizeof(int32);
+	// Longest word that gets indexed. Anything longer is cut off.
+	const int32 MaxTermLength = 64;
+
+	uint64 HashTerm(const TCHAR* term, int32 length)
+	{
+		return CityHash64(reinterpret_cast<const char*>(term), length * sizeof(TCHAR));
+	}
+
+	// Words that show up everywhere, in the prompts and in what guests say.
+	const TSet<uint64>& GetStopTerms()
+	{
+		static const TSet<uint64> stopTerms = []()
+		{
+			const TCHAR* const words[] = { TEXT("a"), TEXT("an"), TEXT("and"), TEXT("are"), TEXT("as"), TEXT("at"),
+				TEXT("be"), TEXT("by"), TEXT("for"), TEXT("from"), TEXT("i"), TEXT("in"), TEXT("is"), TEXT("it"),
+				TEXT("me"), TEXT("my"), TEXT("of"), TEXT("on"), TEXT("or"), TEXT("that"), TEXT("the"), TEXT("this"),
+				TEXT("to"), TEXT("was"), TEXT("were"), TEXT("what"), TEXT("with"), TEXT("you"), TEXT("your") };
+			TSet<uint64> out;
+			for (const TCHAR* word : words)
+			{
+				out.Add(HashTerm(word, FCString::Strlen(word)));
+			}
+			return out;
+		}();
+		return stopTerms;
+	}
+}
+
+FBartlebyEpisodicMemory::~FBartlebyEpisodicMemory()
+{
+	Close();
+}
+
+bool FBartlebyEpisodicMemory::Open(const FString& path)
+{
+	Close();
+	Path = path;
+	Memories.Empty();
+	Lengths.Empty();
+	TotalLength = 0;
+	Terms.Empty();
+	Postings.Empty();
+
+	// Index whatever is already on disk.
+	TArray<uint8> bytes;
+	int64 validSize = 0;
+	if (FFileHelper::LoadFileToArray(bytes, *Path, FILEREAD_Silent))
+	{
+		uint32 magic = 0;
+		if (bytes.Num() >= static_cast<int32>(sizeof(uint32)))
+		{
+			FMemory::Memcpy(&magic, bytes.GetData(), sizeof(uint32));
+		}
+		if (magic == MemoryFileMagic)
+		{
+			int64 offset = sizeof(uint32);
+			while (offset + RecordHeaderSize <= bytes.Num())
+			{
+				int32 length = 0;
+				FMemory::Memcpy(&length, bytes.GetData() + offset, sizeof(int32));
+				if (length < 0 || offset + RecordHeaderSize + length > bytes.Num())
+				{
+					break;
+				}
+				FUTF8ToTCHAR text(reinterpret_cast<const ANSICHAR*>(bytes.GetData() + offset + RecordHeaderSize), length);
+				Index(FString(text.Length(), text.Get()));
+				offset += RecordHeaderSize + length;
+			}
+			validSize = offset;
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is not a memory file, starting a new one."), *Path);
+		}
+	}
+
+	// If the game died halfway through a write, or there's nothing yet, start clean so that appends line up.
+	if (validSize != bytes.Num() || validSize == 0)
+	{
+		if (validSize == 0)
+		{
+			bytes.SetNum(sizeof(uint32));
+			FMemory::Memcpy(bytes.GetData(), &MemoryFileMagic, sizeof(uint32));
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Dropping a partial memory at the end of %s."), *Path);
+			bytes.SetNum(validSize);
+		}
+		if (!FFileHelper::SaveArrayToFile(bytes, *Path))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unable to write memories to %s."), *Path);
+			return false;
+		}
+	}
+
+	Writer = IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_Append | FILEWRITE_AllowRead);
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unable to open memories at %s."), *Path);
+		return false;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Opened %s with %d memories."), *Path, Memories.Num());
+	return true;
+}
+
+void FBartlebyEpisodicMemory::Close()
+{
+	if (Writing.IsValid())
+	{
+		Writing.Wait();
+		Writing.Reset();
+	}
+	if (Writer)
+	{
+		if (PendingWrites.Num() > 0)
+		{
+			Writer->Serialize(PendingWrites.GetData(), PendingWrites.Num());
+			PendingWrites.Reset();
+		}
+		Writer->Close();
+		delete Writer;
+		Writer = nullptr;
+	}
+}
+
+void FBartlebyEpisodicMemory::Add(const FString& text)
+{
+	Index(text);
+	if (!Writer)
+	{
+		return;
+	}
+	FTCHARToUTF8 utf8(*text);
+	int32 length = utf8.Length();
+	PendingWrites.Append(reinterpret_cast<const uint8*>(&length), sizeof(int32));
+	PendingWrites.Append(reinterpret_cast<const uint8*>(utf8.Get()), length);
+}
+
+void FBartlebyEpisodicMemory::Flush()
+{
+	if (!Writer || PendingWrites.Num() == 0 || (Writing.IsValid() && !Writing.IsReady()))
+	{
+		return;
+	}
+	// Close waits for the write, so the writer outlives it.
+	Writing = Async(EAsyncExecution::ThreadPool, [writer = Writer, bytes = MoveTemp(PendingWrites)]() mutable
+		{
+			writer->Serialize(bytes.GetData(), bytes.Num());
+			writer->Flush();
+		});
+	PendingWrites.Reset();
+}
+
+void FBartlebyEpisodicMemory::Index(const FString& text)
+{
+	const int32 memory = Memories.Add(text);
+	TArray<uint64> terms;
+	SplitTerms(text, terms);
+	Lengths.Add(terms.Num());
+	TotalLength += terms.Num();
+	// Count each word once per memory. Memories are short, so sorting beats a map.
+	terms.Sort();
+	for (int32 i = 0; i < terms.Num();)
+	{
+		int32 count = 1;
+		while (i + count < terms.Num() && terms[i + count] == terms[i])
+		{
+			count++;
+		}
+		int32* postingsIndex = Terms.Find(terms[i]);
+		if (!postingsIndex)
+		{
+			postingsIndex = &Terms.Add(terms[i], Postings.AddDefaulted());
+		}
+		Postings[*postingsIndex].Add({ memory, count });
+		i += count;
+	}
+}
+
+void FBartlebyEpisodicMemory::SplitTerms(const FString& text, TArray<uint64>& outTerms)
+{
+	const TSet<uint64>& stopTerms = GetStopTerms();
+	TCHAR term[MaxTermLength];
+	int32 length = 0;
+	// One past the end, to finish off the last word.
+	for (int32 i = 0; i <= text.Len(); i++)
+	{
+		const TCHAR c = i < text.Len() ? text[i] : TEXT(' ');
+		// Underscores are part of words, so that ids like gallery_3 stay whole.
+		if (FChar::IsAlnum(c) || c == TEXT('_'))
+		{
+			if (length < MaxTermLength)
+			{
+				term[length++] = FChar::ToLower(c);
+			}
+			continue;
+		}
+		if (length > 0)
+		{
+			const uint64 hash = HashTerm(term, length);
+			if (!stopTerms.Contains(hash))
+			{
+				outTerms.Add(hash);
+			}
+			length = 0;
+		}
+	}
+}
+
+void FBartlebyEpisodicMemory::Query(const FString& query, int32 maxResults, int32 numRecentToSkip, TArray<FRecall>& outRecalls)
+{
+	outRecalls.Reset();
+	const int32 numMemories = Memories.Num() - FMath::Max(numRecentToSkip, 0);
+	if (numMemories <= 0 || maxResults <= 0)
+	{
+		return;
+	}
+	TArray<uint64> terms;
+	SplitTerms(query, terms);
+	terms.Sort();
+	const int32 numTerms = Algo::Unique(terms);
+	terms.SetNum(numTerms, false);
+
+	// Go through the rarest words first. They say the most about which memories match, and have the shortest lists.
+	TArray<const TArray<FPosting>*, TInlineAllocator<32>> termPostings;
+	for (const uint64 term : terms)
+	{
+		if (const int32* postingsIndex = Terms.Find(term))
+		{
+			termPostings.Add(&Postings[*postingsIndex]);
+		}
+	}
+	termPostings.Sort([](const TArray<FPosting>& a, const TArray<FPosting>& b) { return a.Num() < b.Num(); });
+
+	Scores.SetNumZeroed(Memories.Num());
+	const float total = static_cast<float>(Memories.Num());
+	const float averageLength = FMath::Max(static_cast<float>(TotalLength) / total, 1.0f);
+	for (const TArray<FPosting>* postings : termPostings)
+	{
+		const float frequency = static_cast<float>(postings->Num());
+		// Common words barely change the ranking, and going through their lists is most of the cost of a query. They
+		// only count if nothing rarer matched. Short lists are cheap, so they always count.
+		if (frequency > MinCommonTermPostings && frequency > total * MaxCommonTermFrequency &&
+			(Touched.Num() > 0 || frequency > total * MaxTermFrequency))
+		{
+			break;
+		}
+		const float idf = FMath::Loge(1.0f + (total - frequency + 0.5f) / (frequency + 0.5f));
+		for (const FPosting& posting : *postings)
+		{
+			// Postings are in the order memories were added, so everything after this is too recent.
+			if (posting.Memory >= numMemories)
+			{
+				break;
+			}
+			const float count = static_cast<float>(posting.Count);
+			const float norm = K1 * (1.0f - B + B * Lengths[posting.Memory] / averageLength);
+			float& score = Scores[posting.Memory];
+			if (score == 0.0f)
+			{
+				Touched.Add(posting.Memory);
+			}
+			score += idf * count * (K1 + 1.0f) / (count + norm);
+		}
+	}
+
+	// Keep the best few, best first. Ties go to the more recent memory.
+	for (const int32 memory : Touched)
+	{
+		const FRecall recall{ memory, Scores[memory] };
+		int32 insertAt = outRecalls.Num();
+		while (insertAt > 0 && (outRecalls[insertAt - 1].Score < recall.Score ||
+			(outRecalls[insertAt - 1].Score == recall.Score && outRecalls[insertAt - 1].Index < recall.Index)))
+		{
+			insertAt--;
+		}
+		if (insertAt < maxResults)
+		{
+			outRecalls.Insert(recall, insertAt);
+			if (outRecalls.Num() > maxResults)
+			{
+				outRecalls.Pop(false);
+			}
+		}
+		Scores[memory] = 0.0f;
+	}
+	Touched.Reset();
+}
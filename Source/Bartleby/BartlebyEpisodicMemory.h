@@ -0,0 +1,105 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+// Everything an AI has done and been told, kept for good and searchable, so that things that fell out of its log long
+// ago can be brought back when they matter again. Each memory is a line of text, indexed in an inverted index and
+// ranked with BM25 against a query, such as the room the AI is in and what a guest just said.
+//
+// Adding a memory takes time in proportion to its length, and a query only touches the memories that share a word
+// with it. Memories are appended to a file on the thread pool whenever Flush is called, and the index is rebuilt from
+// it when it's opened again.
+class BARTLEBY_API FBartlebyEpisodicMemory
+{
+public:
+	// A memory that matched a query.
+	struct FRecall
+	{
+		int32 Index = 0;
+		float Score = 0.0f;
+	};
+
+	~FBartlebyEpisodicMemory();
+
+	// Loads and indexes every memory in the file, and appends new ones to it. Without a file, memories only last until
+	// this is destroyed. Returns false if the file couldn't be opened.
+	bool Open(const FString& path);
+	// Writes out whatever hasn't been, and closes the file.
+	void Close();
+
+	// Remembers the given text. It's written to the file on the next Flush.
+	void Add(const FString& text);
+	// Starts writing the memories added since the last flush to the file on the thread pool. If the last flush is still
+	// going, they wait for the next one.
+	void Flush();
+	// Finds the memories that best match the query, best first, ignoring the newest numRecentToSkip of them.
+	void Query(const FString& query, int32 maxResults, int32 numRecentToSkip, TArray<FRecall>& outRecalls);
+
+	int32 Num() const { return Memories.Num(); }
+	const FString& Get(int32 index) const { return Memories[index]; }
+
+	// Splits text into the hashes of its lower case words, leaving out words too common to mean anything.
+	static void SplitTerms(const FString& text, TArray<uint64>& outTerms);
+
+private:
+	// Adds the memory to the index, without writing it to the file.
+	void Index(const FString& text);
+
+	// BM25 parameters: how quickly repeating a word stops counting for more, and how much long memories are penalized.
+	static constexpr float K1 = 1.2f;
+	static constexpr float B = 0.75f;
+	// Words in more than this fraction of memories are only used in a query if none of its rarer words matched.
+	static constexpr float MaxCommonTermFrequency = 0.05f;
+	// Words in more than this fraction of memories are never used in queries.
+	static constexpr float MaxTermFrequency = 0.5f;
+	// Words in fewer memories than this are always used, however common they are.
+	static constexpr int32 MinCommonTermPostings = 256;
+
+	// Where a word appears, and how many times.
+	struct FPosting
+	{
+		int32 Memory = 0;
+		int32 Count = 0;
+	};
+
+	TArray<FString> Memories;
+	// Number of words in each memory.
+	TArray<int32> Lengths;
+	int64 TotalLength = 0;
+	// Where each word's postings are, by the hash of the word.
+	TMap<uint64, int32> Terms;
+	// Postings for every word, in the order the memories were added.
+	TArray<TArray<FPosting>> Postings;
+	// Scores of every memory during a query, and which ones were touched, so only those have to be cleared.
+	TArray<float> Scores;
+	TArray<int32> Touched;
+	FString Path;
+	FArchive* Writer = nullptr;
+	// Records waiting to be written, and the write in progress. Only the write touches the writer while it's going.
+	TArray<uint8> PendingWrites;
+	TFuture<void> Writing;
+};
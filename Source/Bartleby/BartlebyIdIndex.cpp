@@ -0,0 +1,293 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyIdIndex.h"
+
+namespace
+{
+	// Stands in for the characters before and after the string, so that it has a trigram per character.
+	constexpr TCHAR Padding = 0;
+
+	uint64 MakeTrigram(TCHAR a, TCHAR b, TCHAR c)
+	{
+		return (static_cast<uint64>(a) << 42) | (static_cast<uint64>(b) << 21) | static_cast<uint64>(c);
+	}
+
+	// Distinct trigrams of a query. Most queries fit without allocating.
+	typedef TArray<uint64, TInlineAllocator<64>> FQueryTrigrams;
+	// Numbers in a query.
+	typedef TArray<uint64, TInlineAllocator<8>> FQueryNumbers;
+}
+
+TCHAR FBartlebyIdIndex::Normalize(TCHAR c)
+{
+	if (c == TEXT(' ') || c == TEXT('-'))
+	{
+		return TEXT('_');
+	}
+	return static_cast<TCHAR>(FChar::ToLower(c) & 0x1FFFFF);
+}
+
+template <typename VisitorType>
+void FBartlebyIdIndex::ForEachTrigram(const FString& s, VisitorType&& visit)
+{
+	TCHAR a = Padding;
+	TCHAR b = Padding;
+	for (int32 i = 0; i <= s.Len(); i++)
+	{
+		const TCHAR c = i < s.Len() ? Normalize(s[i]) : Padding;
+		visit(MakeTrigram(a, b, c));
+		a = b;
+		b = c;
+	}
+}
+
+template <typename VisitorType>
+void FBartlebyIdIndex::ForEachNumber(const FString& s, VisitorType&& visit)
+{
+	bool inNumber = false;
+	uint64 value = 0;
+	// One past the end, to finish off the last number.
+	for (int32 i = 0; i <= s.Len(); i++)
+	{
+		const TCHAR c = i < s.Len() ? s[i] : TEXT(' ');
+		if (c >= TEXT('0') && c <= TEXT('9'))
+		{
+			// Numbers too long to fit wrap around, which still tells them apart.
+			value = value * 10 + (c - TEXT('0'));
+			inNumber = true;
+		}
+		else if (inNumber)
+		{
+			visit(value);
+			value = 0;
+			inNumber = false;
+		}
+	}
+}
+
+bool FBartlebyIdIndex::HasNumbers(int32 id, const TArrayView<const uint64>& numbers) const
+{
+	int32 next = NumberStarts[id];
+	for (const uint64 number : numbers)
+	{
+		while (next < NumberStarts[id + 1] && Numbers[next] != number)
+		{
+			next++;
+		}
+		if (next == NumberStarts[id + 1])
+		{
+			return false;
+		}
+		next++;
+	}
+	return true;
+}
+
+void FBartlebyIdIndex::Build(const TArray<FString>& ids)
+{
+	Ids.Reset(ids.Num());
+	NumTrigrams.Reset(ids.Num());
+	Numbers.Reset();
+	NumberStarts.Reset(ids.Num() + 1);
+	Exact.Reset();
+	Postings.Reset();
+	for (int32 i = 0; i < ids.Num(); i++)
+	{
+		FString normalized = ids[i];
+		for (TCHAR& c : normalized.GetCharArray())
+		{
+			if (c != 0)
+			{
+				c = Normalize(c);
+			}
+		}
+		if (!Exact.Contains(ids[i]))
+		{
+			Exact.Add(ids[i], i);
+		}
+		int32 numTrigrams = 0;
+		ForEachTrigram(normalized, [this, i, &numTrigrams](uint64 trigram)
+			{
+				// An ID with the same trigram twice is only listed once.
+				TArray<int32>& posting = Postings.FindOrAdd(trigram);
+				if (posting.Num() == 0 || posting.Last() != i)
+				{
+					posting.Add(i);
+					numTrigrams++;
+				}
+			});
+		NumberStarts.Add(Numbers.Num());
+		ForEachNumber(normalized, [this](uint64 number) { Numbers.Add(number); });
+		Ids.Add(MoveTemp(normalized));
+		NumTrigrams.Add(numTrigrams);
+	}
+	NumberStarts.Add(Numbers.Num());
+	NumShared.SetNumZeroed(ids.Num());
+	Touched.Reset(ids.Num());
+}
+
+int32 FBartlebyIdIndex::Find(const FString& query, float minConfidence, float& outConfidence) const
+{
+	outConfidence = 0.0f;
+	if (query.IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+	if (const int32* exact = Exact.Find(query))
+	{
+		outConfidence = 1.0f;
+		return *exact;
+	}
+
+	FQueryTrigrams trigrams;
+	ForEachTrigram(query, [&trigrams](uint64 trigram) { trigrams.Add(trigram); });
+	trigrams.Sort();
+	int32 numTrigrams = 0;
+	for (int32 i = 0; i < trigrams.Num(); i++)
+	{
+		if (i == 0 || trigrams[i] != trigrams[i - 1])
+		{
+			trigrams[numTrigrams++] = trigrams[i];
+		}
+	}
+	trigrams.SetNum(numTrigrams, false);
+
+	// Count the trigrams each ID shares with the query.
+	for (const uint64 trigram : trigrams)
+	{
+		if (const TArray<int32>* posting = Postings.Find(trigram))
+		{
+			for (const int32 id : *posting)
+			{
+				if (NumShared[id]++ == 0)
+				{
+					Touched.Add(id);
+				}
+			}
+		}
+	}
+
+	// Only the IDs sharing the most trigrams are worth the edit distance. Earlier IDs go first when tied. IDs without
+	// the query's numbers are never what it meant, however close they're spelled.
+	FQueryNumbers numbers;
+	ForEachNumber(query, [&numbers](uint64 number) { numbers.Add(number); });
+	TArray<int32, TInlineAllocator<MaxCandidates>> candidates;
+	for (const int32 id : Touched)
+	{
+		if (numbers.Num() > 0 && !HasNumbers(id, numbers))
+		{
+			continue;
+		}
+		int32 at = candidates.Num();
+		while (at > 0 && (NumShared[candidates[at - 1]] < NumShared[id] ||
+			(NumShared[candidates[at - 1]] == NumShared[id] && candidates[at - 1] > id)))
+		{
+			at--;
+		}
+		if (at < MaxCandidates)
+		{
+			if (candidates.Num() == MaxCandidates)
+			{
+				candidates.Pop(false);
+			}
+			candidates.Insert(id, at);
+		}
+	}
+
+	int32 best = INDEX_NONE;
+	for (const int32 id : candidates)
+	{
+		const float score = Score(id, query, trigrams.Num(), NumShared[id]);
+		if (score > outConfidence || (score == outConfidence && best != INDEX_NONE && id < best))
+		{
+			outConfidence = score;
+			best = id;
+		}
+	}
+	for (const int32 id : Touched)
+	{
+		NumShared[id] = 0;
+	}
+	Touched.Reset();
+	return outConfidence >= minConfidence ? best : INDEX_NONE;
+}
+
+float FBartlebyIdIndex::Score(int32 id, const FString& query, int32 numQueryTrigrams, int32 numShared) const
+{
+	const FString& normalized = Ids[id];
+	const int32 queryLen = query.Len();
+	const int32 idLen = normalized.Len();
+	if (idLen == 0)
+	{
+		return 0.0f;
+	}
+	// Misspellings of the whole ID.
+	const int32 distance = EditDistance(query, normalized, false);
+	if (distance == 0)
+	{
+		// The same but for case or spacing.
+		return 1.0f;
+	}
+	const float edited = 1.0f - static_cast<float>(distance) / FMath::Max(queryLen, idLen);
+	// Abbreviations, misspelled or not. The more of the ID they cover, the better.
+	const float covered = 0.6f + 0.4f * FMath::Min(queryLen, idLen) / idLen;
+	const float abbreviated = covered * (1.0f - static_cast<float>(EditDistance(query, normalized, true)) / queryLen);
+	// Dice coefficient of the trigrams, for words in a different order.
+	const float shared = 2.0f * numShared / (numQueryTrigrams + NumTrigrams[id]);
+	return FMath::Max3(edited, abbreviated, shared);
+}
+
+int32 FBartlebyIdIndex::EditDistance(const FString& query, const FString& id, bool anywhere) const
+{
+	const int32 idLen = id.Len();
+	PreviousRow.SetNumUninitialized(idLen + 1, false);
+	CurrentRow.SetNumUninitialized(idLen + 1, false);
+	for (int32 j = 0; j <= idLen; j++)
+	{
+		// Starting anywhere in the ID is free, if the query can be anywhere in it.
+		PreviousRow[j] = anywhere ? 0 : j;
+	}
+	for (int32 i = 0; i < query.Len(); i++)
+	{
+		const TCHAR c = Normalize(query[i]);
+		CurrentRow[0] = i + 1;
+		for (int32 j = 0; j < idLen; j++)
+		{
+			const int32 substitute = PreviousRow[j] + (c == id[j] ? 0 : 1);
+			CurrentRow[j + 1] = FMath::Min3(PreviousRow[j + 1] + 1, CurrentRow[j] + 1, substitute);
+		}
+		Swap(PreviousRow, CurrentRow);
+	}
+	if (!anywhere)
+	{
+		return PreviousRow[idLen];
+	}
+	// And so is stopping anywhere.
+	int32 distance = PreviousRow[0];
+	for (int32 j = 1; j <= idLen; j++)
+	{
+		distance = FMath::Min(distance, PreviousRow[j]);
+	}
+	return distance;
+}
@@ -0,0 +1,82 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Finds the ID the AI meant. It shortens and misspells the names of rooms and objects, so besides exact matches
+// (which ignore case) this finds IDs that are a few edits away from what it said, or have a part that is, or share
+// enough character trigrams with it. Case is ignored, and spaces and dashes count as underscores. Numbers are never
+// misspelled though: every number in the query has to be in the ID, in the same order, so gallery_7 doesn't find
+// gallery_1. Lookups don't allocate for IDs of a sensible length, but share scratch space, so only use an index from
+// one thread at a time.
+class BARTLEBY_API FBartlebyIdIndex
+{
+public:
+	// Most candidates (the ones sharing the most trigrams with the query) that are scored on each lookup.
+	static constexpr int32 MaxCandidates = 16;
+
+	// Indexes the given IDs. Earlier IDs win ties.
+	void Build(const TArray<FString>& ids);
+
+	// Gets the index of the ID that best matches the query, or INDEX_NONE if none is at least minConfidence sure.
+	// Confidence is 1 for an exact match, and less the more the query had to be stretched to fit.
+	int32 Find(const FString& query, float minConfidence, float& outConfidence) const;
+
+	// Number of IDs it was built from.
+	int32 Num() const { return Ids.Num(); }
+
+private:
+	// Lowercases the character, and turns spaces and dashes into underscores.
+	static TCHAR Normalize(TCHAR c);
+	// Calls visit with each trigram of the normalized string, padded so that short strings have some.
+	template <typename VisitorType>
+	static void ForEachTrigram(const FString& s, VisitorType&& visit);
+	// Scores how well the ID matches the query, out of 1.
+	float Score(int32 id, const FString& query, int32 numQueryTrigrams, int32 numShared) const;
+	// Number of single character edits that turn the query into the (normalized) ID, or into any part of it.
+	int32 EditDistance(const FString& query, const FString& id, bool anywhere) const;
+	// Calls visit with the value of each run of digits in the string, leading zeros and all ignored.
+	template <typename VisitorType>
+	static void ForEachNumber(const FString& s, VisitorType&& visit);
+	// True if every one of the numbers is in the ID, in order.
+	bool HasNumbers(int32 id, const TArrayView<const uint64>& numbers) const;
+
+	// Normalized IDs.
+	TArray<FString> Ids;
+	// Number of distinct trigrams in each ID.
+	TArray<int32> NumTrigrams;
+	// Numbers in every ID, one ID after another. ID i has the numbers from NumberStarts[i] up to NumberStarts[i + 1].
+	TArray<uint64> Numbers;
+	TArray<int32> NumberStarts;
+	// First index of each ID. FString keys ignore case already.
+	TMap<FString, int32> Exact;
+	// IDs each trigram is in, in order.
+	TMap<uint64, TArray<int32>> Postings;
+	// Scratch space for lookups: trigrams shared with each ID, the IDs that share any, and rows for the edit distance.
+	mutable TArray<int32> NumShared;
+	mutable TArray<int32> Touched;
+	mutable TArray<int32> PreviousRow;
+	mutable TArray<int32> CurrentRow;
+};
@@ -0,0 +1,173 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyJsonWriter.h"
+
+void FBartlebyJsonWriter::BeginValue()
+{
+	if (IsAfterKey)
+	{
+		IsAfterKey = false;
+		return;
+	}
+	const uint64 bit = 1ull << FMath::Min(Depth, 63);
+	if (HasValue & bit)
+	{
+		WriteByte(',');
+	}
+	HasValue |= bit;
+}
+
+void FBartlebyJsonWriter::BeginObject()
+{
+	BeginValue();
+	WriteByte('{');
+	Depth++;
+	HasValue &= ~(1ull << FMath::Min(Depth, 63));
+}
+
+void FBartlebyJsonWriter::EndObject()
+{
+	WriteByte('}');
+	Depth--;
+}
+
+void FBartlebyJsonWriter::BeginArray()
+{
+	BeginValue();
+	WriteByte('[');
+	Depth++;
+	HasValue &= ~(1ull << FMath::Min(Depth, 63));
+}
+
+void FBartlebyJsonWriter::EndArray()
+{
+	WriteByte(']');
+	Depth--;
+}
+
+void FBartlebyJsonWriter::WriteKey(const ANSICHAR* key)
+{
+	BeginValue();
+	WriteByte('"');
+	WriteRaw(key, FCStringAnsi::Strlen(key));
+	WriteByte('"');
+	WriteByte(':');
+	IsAfterKey = true;
+}
+
+void FBartlebyJsonWriter::WriteString(const FString& value)
+{
+	BeginValue();
+	static const ANSICHAR* hexDigits = "0123456789abcdef";
+	const TCHAR* chars = *value;
+	const int32 length = value.Len();
+	// Most text is ASCII, so make room for one byte per character and the quotes. Escapes and multi-byte characters
+	// grow the buffer as usual.
+	Buffer.Reserve(Buffer.Num() + length + 2);
+	WriteByte('"');
+	for (int32 i = 0; i < length; i++)
+	{
+		uint32 c = static_cast<uint32>(chars[i]);
+		// Join UTF-16 surrogate pairs back together.
+		if (c >= 0xD800 && c <= 0xDBFF && i + 1 < length)
+		{
+			const uint32 low = static_cast<uint32>(chars[i + 1]);
+			if (low >= 0xDC00 && low <= 0xDFFF)
+			{
+				c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+				i++;
+			}
+		}
+		if (c < 0x80)
+		{
+			switch (c)
+			{
+			case '"': WriteRaw("\\\"", 2); break;
+			case '\\': WriteRaw("\\\\", 2); break;
+			case '\n': WriteRaw("\\n", 2); break;
+			case '\r': WriteRaw("\\r", 2); break;
+			case '\t': WriteRaw("\\t", 2); break;
+			case '\b': WriteRaw("\\b", 2); break;
+			case '\f': WriteRaw("\\f", 2); break;
+			default:
+				if (c < 0x20)
+				{
+					const ANSICHAR escaped[6] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xF] };
+					WriteRaw(escaped, 6);
+				}
+				else
+				{
+					WriteByte(static_cast<uint8>(c));
+				}
+				break;
+			}
+		}
+		else if (c < 0x800)
+		{
+			WriteByte(static_cast<uint8>(0xC0 | (c >> 6)));
+			WriteByte(static_cast<uint8>(0x80 | (c & 0x3F)));
+		}
+		else if (c < 0x10000)
+		{
+			WriteByte(static_cast<uint8>(0xE0 | (c >> 12)));
+			WriteByte(static_cast<uint8>(0x80 | ((c >> 6) & 0x3F)));
+			WriteByte(static_cast<uint8>(0x80 | (c & 0x3F)));
+		}
+		else
+		{
+			WriteByte(static_cast<uint8>(0xF0 | (c >> 18)));
+			WriteByte(static_cast<uint8>(0x80 | ((c >> 12) & 0x3F)));
+			WriteByte(static_cast<uint8>(0x80 | ((c >> 6) & 0x3F)));
+			WriteByte(static_cast<uint8>(0x80 | (c & 0x3F)));
+		}
+	}
+	WriteByte('"');
+}
+
+void FBartlebyJsonWriter::WriteNumber(double value)
+{
+	BeginValue();
+	ANSICHAR text[32];
+	// 15 significant digits round trips anything a person would type, and writes 0.4 as 0.4.
+	const int32 length = FCStringAnsi::Snprintf(text, sizeof(text), "%.15g", value);
+	WriteRaw(text, FMath::Clamp(length, 0, static_cast<int32>(sizeof(text)) - 1));
+}
+
+void FBartlebyJsonWriter::WriteBool(bool value)
+{
+	BeginValue();
+	if (value)
+	{
+		WriteRaw("true", 4);
+	}
+	else
+	{
+		WriteRaw("false", 5);
+	}
+}
+
+void FBartlebyJsonWriter::WriteRaw(const ANSICHAR* text, int32 length)
+{
+	Buffer.Append(reinterpret_cast<const uint8*>(text), length);
+}
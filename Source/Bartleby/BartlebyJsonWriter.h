@@ -0,0 +1,64 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Writes JSON straight into a UTF-8 byte buffer, without building a DOM or going through an intermediate FString.
+// Only has what the requests to the AI need: objects, arrays, strings, numbers and bools.
+class BARTLEBY_API FBartlebyJsonWriter
+{
+public:
+	// Appends to the end of the given buffer.
+	FBartlebyJsonWriter(TArray<uint8>& InBuffer) : Buffer(InBuffer) {}
+
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+
+	// Writes the key of the next field. Keys are plain ASCII, and are not escaped.
+	void WriteKey(const ANSICHAR* key);
+
+	void WriteString(const FString& value);
+	void WriteNumber(double value);
+	void WriteBool(bool value);
+
+	void WriteField(const ANSICHAR* key, const FString& value) { WriteKey(key); WriteString(value); }
+	void WriteField(const ANSICHAR* key, double value) { WriteKey(key); WriteNumber(value); }
+	void WriteField(const ANSICHAR* key, bool value) { WriteKey(key); WriteBool(value); }
+
+private:
+	// Writes a comma if this isn't the first thing in the current object or array.
+	void BeginValue();
+	void WriteRaw(const ANSICHAR* text, int32 length);
+	void WriteByte(uint8 b) { Buffer.Add(b); }
+
+	TArray<uint8>& Buffer;
+	// One bit per level of nesting, set once that level has something in it.
+	uint64 HasValue = 0;
+	int32 Depth = 0;
+	// True right after a key, when the value doesn't need a comma.
+	bool IsAfterKey = false;
+};
@@ -0,0 +1,246 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyMemory.h"
+#include "Bartleby/BartlebyTokenizer.h"
+#include "Bartleby/BartlebyJsonWriter.h"
+
+const TCHAR* FBartlebyMemorySummarizer::RoomsPrefix = TEXT("rooms_visited=");
+const TCHAR* FBartlebyMemorySummarizer::FactPrefix = TEXT("- ");
+
+namespace
+{
+	// Longest a single fact can be, so that one long description doesn't push everything else out.
+	const int32 MaxFactLength = 160;
+	// Most rooms listed as visited. The ones visited longest ago are dropped first.
+	const int32 MaxRooms = 32;
+
+	// A summary, split back into the rooms visited and the facts, oldest first.
+	struct FParsedSummary
+	{
+		TArray<FString> Rooms;
+		TArray<FString> Facts;
+	};
+
+	int32 CountTokens(const FString& text, const FBartlebyTokenizer* tokenizer)
+	{
+		return tokenizer ? tokenizer->CountTokens(text) : FMath::DivideAndRoundUp(text.Len(), 4);
+	}
+
+	// Adds the value to the end of the list, or moves it there if it's already in it, so the list stays ordered by
+	// how recently things happened.
+	void AddRecent(TArray<FString>& list, const FString& value)
+	{
+		if (!value.IsEmpty())
+		{
+			list.Remove(value);
+			list.Add(value);
+		}
+	}
+
+	FString Shorten(const FString& text)
+	{
+		FString trimmed = text.TrimStartAndEnd();
+		if (trimmed.Len() > MaxFactLength)
+		{
+			trimmed = trimmed.Left(MaxFactLength - 3) + TEXT("...");
+		}
+		return trimmed;
+	}
+
+	// Splits an action like say(Hello) into its verb and what's in the parentheses.
+	bool SplitAction(const FString& action, FString& verb, FString& argument)
+	{
+		int32 open = INDEX_NONE;
+		int32 close = INDEX_NONE;
+		if (!action.FindChar(TEXT('('), open) || !action.FindLastChar(TEXT(')'), close) || close < open)
+		{
+			return false;
+		}
+		verb = action.Left(open).TrimStartAndEnd();
+		argument = action.Mid(open + 1, close - open - 1);
+		return true;
+	}
+
+	FParsedSummary Parse(const FString& summary, const TCHAR* roomsPrefix, const TCHAR* factPrefix)
+	{
+		FParsedSummary parsed;
+		TArray<FString> lines;
+		summary.ParseIntoArrayLines(lines);
+		for (const FString& line : lines)
+		{
+			if (line.StartsWith(roomsPrefix))
+			{
+				FString rooms = line.Mid(FCString::Strlen(roomsPrefix)).TrimStartAndEnd();
+				rooms.RemoveFromStart(TEXT("["));
+				rooms.RemoveFromEnd(TEXT("]"));
+				rooms.ParseIntoArray(parsed.Rooms, TEXT(","));
+			}
+			else if (line.StartsWith(factPrefix))
+			{
+				parsed.Facts.Add(line.Mid(FCString::Strlen(factPrefix)));
+			}
+			else if (!line.TrimStartAndEnd().IsEmpty())
+			{
+				// The AI doesn't always stick to the format, but whatever it wrote is still worth keeping.
+				parsed.Facts.Add(line.TrimStartAndEnd());
+			}
+		}
+		return parsed;
+	}
+
+	FString Render(const FParsedSummary& parsed, const TCHAR* roomsPrefix, const TCHAR* factPrefix)
+	{
+		FString summary;
+		if (parsed.Rooms.Num() > 0)
+		{
+			summary = FString(roomsPrefix) + TEXT("[") + FString::Join(parsed.Rooms, TEXT(",")) + TEXT("]\n");
+		}
+		for (const FString& fact : parsed.Facts)
+		{
+			summary += factPrefix + fact + TEXT("\n");
+		}
+		return summary;
+	}
+
+	// Drops the oldest facts, and then the rooms visited longest ago, until the summary fits.
+	void TrimParsed(FParsedSummary& parsed, int32 maxTokens, const FBartlebyTokenizer* tokenizer, const TCHAR* roomsPrefix,
+		const TCHAR* factPrefix)
+	{
+		while (parsed.Rooms.Num() > MaxRooms)
+		{
+			parsed.Rooms.RemoveAt(0);
+		}
+		TArray<int32> factTokens;
+		int32 numTokens = 0;
+		for (const FString& fact : parsed.Facts)
+		{
+			factTokens.Add(CountTokens(FString(factPrefix) + fact, tokenizer) + 1);
+			numTokens += factTokens.Last();
+		}
+		int32 roomTokens = parsed.Rooms.Num() > 0 ? CountTokens(Render({ parsed.Rooms, {} }, roomsPrefix, factPrefix), tokenizer) : 0;
+		int32 numDropped = 0;
+		while (numDropped < parsed.Facts.Num() && numTokens + roomTokens > maxTokens)
+		{
+			numTokens -= factTokens[numDropped++];
+		}
+		parsed.Facts.RemoveAt(0, numDropped);
+		while (parsed.Rooms.Num() > 0 && roomTokens > maxTokens)
+		{
+			parsed.Rooms.RemoveAt(0);
+			roomTokens = parsed.Rooms.Num() > 0 ? CountTokens(Render({ parsed.Rooms, {} }, roomsPrefix, factPrefix), tokenizer) : 0;
+		}
+	}
+}
+
+FString FBartlebyMemorySummarizer::Summarize(const FString& summary, const TArray<FBartlebyMemoryEntry>& entries,
+	int32 maxTokens, const FString& guestSaidPrompt, const FBartlebyTokenizer* tokenizer)
+{
+	FParsedSummary parsed = Parse(summary, RoomsPrefix, FactPrefix);
+	for (const FBartlebyMemoryEntry& entry : entries)
+	{
+		TArray<FString> lines;
+		entry.Text.ParseIntoArrayLines(lines);
+		for (const FString& rawLine : lines)
+		{
+			const FString line = rawLine.TrimStartAndEnd();
+			if (entry.IsOutput)
+			{
+				// Where it walked and what it looked at show up in the action results, so only keep what it said.
+				FString verb;
+				FString argument;
+				if (SplitAction(line, verb, argument))
+				{
+					if (verb == TEXT("say"))
+					{
+						AddRecent(parsed.Facts, TEXT("You said: ") + Shorten(argument));
+					}
+					else if (verb != TEXT("walk_to_room") && verb != TEXT("look_at"))
+					{
+						AddRecent(parsed.Facts, TEXT("You did: ") + Shorten(line));
+					}
+				}
+				continue;
+			}
+			FString room;
+			if (line.Split(TEXT("room_id=\""), nullptr, &room) && room.Split(TEXT("\""), &room, nullptr))
+			{
+				AddRecent(parsed.Rooms, room);
+			}
+			FString result;
+			if (line.Split(TEXT("action_result:"), nullptr, &result))
+			{
+				result.TrimStartAndEndInline();
+				FString travelledTo;
+				if (result.Split(TEXT("You travelled to "), nullptr, &travelledTo))
+				{
+					AddRecent(parsed.Rooms, travelledTo.TrimStartAndEnd());
+				}
+				else if (!result.StartsWith(TEXT("Error")) && !result.StartsWith(TEXT("Malformed")) &&
+					!result.StartsWith(TEXT("Unrecognized")))
+				{
+					AddRecent(parsed.Facts, TEXT("You saw: ") + Shorten(result));
+				}
+			}
+			FString guestSaid;
+			if (!guestSaidPrompt.IsEmpty() && line.Split(guestSaidPrompt, nullptr, &guestSaid))
+			{
+				AddRecent(parsed.Facts, TEXT("A guest said: ") + Shorten(guestSaid));
+			}
+		}
+	}
+	TrimParsed(parsed, maxTokens, tokenizer, RoomsPrefix, FactPrefix);
+	return Render(parsed, RoomsPrefix, FactPrefix);
+}
+
+FString FBartlebyMemorySummarizer::Trim(const FString& summary, int32 maxTokens, const FBartlebyTokenizer* tokenizer)
+{
+	FParsedSummary parsed = Parse(summary, RoomsPrefix, FactPrefix);
+	TrimParsed(parsed, maxTokens, tokenizer, RoomsPrefix, FactPrefix);
+	return Render(parsed, RoomsPrefix, FactPrefix);
+}
+
+void FBartlebyMemorySummarizer::WriteSummaryRequest(TArray<uint8>& out, const FString& model, const FString& instructions,
+	const FString& summary, const TArray<FBartlebyMemoryEntry>& entries, int32 maxTokens)
+{
+	FString content = instructions + TEXT("\nSUMMARY SO FAR:\n") + (summary.IsEmpty() ? FString(TEXT("(nothing yet)\n")) : summary) +
+		TEXT("NEW EVENTS:\n");
+	for (const FBartlebyMemoryEntry& entry : entries)
+	{
+		content += (entry.IsOutput ? TEXT("YOU: ") : TEXT("GAME: ")) + entry.Text.TrimStartAndEnd() + TEXT("\n");
+	}
+	out.Reset();
+	FBartlebyJsonWriter writer(out);
+	writer.BeginObject();
+	writer.WriteField("model", model);
+	writer.WriteKey("messages");
+	writer.BeginArray();
+	writer.BeginObject();
+	writer.WriteField("role", FString(TEXT("user")));
+	writer.WriteField("content", content);
+	writer.EndObject();
+	writer.EndArray();
+	writer.WriteField("max_tokens", static_cast<double>(maxTokens));
+	writer.WriteField("temperature", 0.0);
+	writer.EndObject();
+}
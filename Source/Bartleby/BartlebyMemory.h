@@ -0,0 +1,73 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BartlebyMemory.generated.h"
+
+class FBartlebyTokenizer;
+
+// How log elements that no longer fit in the prompt are folded into the memory summary.
+UENUM(BlueprintType)
+enum class EBartlebyMemorySummarizer : uint8
+{
+	// Picks out where the AI went, what it said and what it found, without calling anything.
+	Extractive,
+	// Asks the AI to rewrite the summary, with SummaryModel. Falls back to Extractive if the call fails.
+	AI
+};
+
+// A log element that fell off the front of the log, copied out so it can be summarized on another thread.
+struct FBartlebyMemoryEntry
+{
+	// True if the AI said this, false if it was said to the AI.
+	bool IsOutput = false;
+	FString Text;
+};
+
+// Keeps a short running summary of everything that fell off the front of an AI's log, so it remembers where it has
+// been and what it was told without the prompt growing forever. The summary is plain text, one fact per line, with
+// the rooms visited on the first line. It's rolling: new entries are added at the end, and the oldest facts are
+// dropped once it goes over budget.
+class BARTLEBY_API FBartlebyMemorySummarizer
+{
+public:
+	// Folds the entries into the summary, and trims it to the given number of tokens. The guest prompt is what the
+	// status says in front of anything a guest said. Safe to call from any thread.
+	static FString Summarize(const FString& summary, const TArray<FBartlebyMemoryEntry>& entries, int32 maxTokens,
+		const FString& guestSaidPrompt, const FBartlebyTokenizer* tokenizer);
+
+	// Writes a request body asking the AI to fold the entries into the summary.
+	static void WriteSummaryRequest(TArray<uint8>& out, const FString& model, const FString& instructions,
+		const FString& summary, const TArray<FBartlebyMemoryEntry>& entries, int32 maxTokens);
+
+	// Trims a summary to the given number of tokens by dropping its oldest facts.
+	static FString Trim(const FString& summary, int32 maxTokens, const FBartlebyTokenizer* tokenizer);
+
+private:
+	// Starts the line that lists the rooms visited.
+	static const TCHAR* RoomsPrefix;
+	// Starts every other line.
+	static const TCHAR* FactPrefix;
+};
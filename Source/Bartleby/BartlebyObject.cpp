@@ -24,7 +24,7 @@ SOFTWARE.
 
 
 #include "Bartleby/BartlebyObject.h"
-#include "Kismet/GameplayStatics.h"
+#include "Bartleby/BartlebySubsystem.h"
 
 // Sets default values for this component's properties
 UBartlebyObject::UBartlebyObject()
@@ -40,26 +40,19 @@ UBartlebyObject::UBartlebyObject()
 void UBartlebyObject::BeginPlay()
 {
 	Super::BeginPlay();
-
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ABartlebySystem::StaticClass(), FoundActors);
-
-	for (AActor* actor : FoundActors)
+	// The subsystem puts us in a room once the rooms are there.
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
 	{
-		System = Cast<ABartlebySystem>(actor);
-		if (System)
-		{
-			break;
-		}
+		subsystem->RegisterObject(this);
 	}
+}
 
-	if (System)
+void UBartlebyObject::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
 	{
-		auto room = System->GetRoomAtOrNull(GetOwner()->GetActorLocation());
-		if (room)
-		{
-			room->Objects.Add(this);
-		}
+		subsystem->UnregisterObject(this);
 	}
+	Super::EndPlay(EndPlayReason);
 }
 
@@ -43,6 +43,7 @@ public:
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
@@ -51,5 +52,8 @@ public:
 		FString Description;
 	UPROPERTY()
 		class ABartlebySystem* System = nullptr;
+	// The room the object is in, once it's been placed.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly)
+		class ABartlebyRoom* Room = nullptr;
 
 };
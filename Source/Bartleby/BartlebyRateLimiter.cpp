@@ -0,0 +1,195 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyRateLimiter.h"
+#include "Interfaces/IHttpResponse.h"
+
+namespace
+{
+	// OpenAI's limits are per minute, so until the server says how fast a bucket refills, assume it takes a minute.
+	constexpr double DefaultRefillTime = 60.0;
+
+	int64 ParseCount(const FString& text)
+	{
+		return text.IsNumeric() ? FCString::Atoi64(*text) : -1;
+	}
+}
+
+FBartlebyRateLimitHeaders FBartlebyRateLimitHeaders::FromResponse(const IHttpResponse& response)
+{
+	FBartlebyRateLimitHeaders headers;
+	headers.RequestLimit = ParseCount(response.GetHeader(TEXT("x-ratelimit-limit-requests")));
+	headers.RemainingRequests = ParseCount(response.GetHeader(TEXT("x-ratelimit-remaining-requests")));
+	headers.RequestsResetTime = ParseDuration(response.GetHeader(TEXT("x-ratelimit-reset-requests")));
+	headers.TokenLimit = ParseCount(response.GetHeader(TEXT("x-ratelimit-limit-tokens")));
+	headers.RemainingTokens = ParseCount(response.GetHeader(TEXT("x-ratelimit-remaining-tokens")));
+	headers.TokensResetTime = ParseDuration(response.GetHeader(TEXT("x-ratelimit-reset-tokens")));
+	// Retry-After can also be an HTTP date, but OpenAI only ever sends seconds.
+	headers.RetryAfter = ParseDuration(response.GetHeader(TEXT("retry-after")));
+	return headers;
+}
+
+float FBartlebyRateLimitHeaders::ParseDuration(const FString& text)
+{
+	const TCHAR* c = *text;
+	if (!*c)
+	{
+		return -1.0f;
+	}
+	double seconds = 0.0;
+	while (*c)
+	{
+		// A number...
+		const TCHAR* start = c;
+		while (FChar::IsDigit(*c) || *c == TEXT('.'))
+		{
+			c++;
+		}
+		if (c == start)
+		{
+			return -1.0f;
+		}
+		const double value = FCString::Atod(*FString(static_cast<int32>(c - start), start));
+		// ...followed by its unit, or nothing for seconds.
+		if (c[0] == TEXT('m') && c[1] == TEXT('s'))
+		{
+			seconds += value / 1000.0;
+			c += 2;
+		}
+		else if (*c == TEXT('h') || *c == TEXT('m') || *c == TEXT('s') || !*c)
+		{
+			seconds += value * (*c == TEXT('h') ? 3600.0 : *c == TEXT('m') ? 60.0 : 1.0);
+			c += *c ? 1 : 0;
+		}
+		else
+		{
+			return -1.0f;
+		}
+	}
+	return static_cast<float>(seconds);
+}
+
+float FBartlebyRateLimitHeaders::GetRetryDelay() const
+{
+	if (RetryAfter >= 0.0f)
+	{
+		return RetryAfter;
+	}
+	float delay = -1.0f;
+	if (RemainingRequests == 0)
+	{
+		delay = FMath::Max(delay, RequestsResetTime);
+	}
+	if (RemainingTokens == 0)
+	{
+		delay = FMath::Max(delay, TokensResetTime);
+	}
+	return delay;
+}
+
+FBartlebyRateLimiter::FBartlebyRateLimiter(int32 requestsPerMinute, int32 tokensPerMinute)
+{
+	Requests.Capacity = Requests.Available = FMath::Max(0, requestsPerMinute);
+	Requests.RefillPerSecond = Requests.Capacity / DefaultRefillTime;
+	Tokens.Capacity = Tokens.Available = FMath::Max(0, tokensPerMinute);
+	Tokens.RefillPerSecond = Tokens.Capacity / DefaultRefillTime;
+}
+
+bool FBartlebyRateLimiter::TryAcquire(double now, int32 tokens, float& outWait)
+{
+	Refill(now);
+	if (now < PausedUntil)
+	{
+		outWait = static_cast<float>(PausedUntil - now);
+		return false;
+	}
+	// A call that's bigger than the whole bucket can only ever go out when the bucket is full.
+	const double numTokens = Tokens.Capacity > 0.0 ? FMath::Min(static_cast<double>(FMath::Max(0, tokens)), Tokens.Capacity) : 0.0;
+	outWait = FMath::Max(Requests.GetWait(1.0), Tokens.GetWait(numTokens));
+	if (outWait > 0.0f)
+	{
+		return false;
+	}
+	Requests.Available -= 1.0;
+	Requests.InFlight += 1.0;
+	Tokens.Available -= numTokens;
+	Tokens.InFlight += FMath::Max(0, tokens);
+	return true;
+}
+
+void FBartlebyRateLimiter::Release(int32 requests, int32 tokens)
+{
+	Requests.InFlight = FMath::Max(0.0, Requests.InFlight - requests);
+	Tokens.InFlight = FMath::Max(0.0, Tokens.InFlight - tokens);
+}
+
+void FBartlebyRateLimiter::Update(double now, const FBartlebyRateLimitHeaders& headers, int32 ownRequests, int32 ownTokens)
+{
+	Refill(now);
+	Requests.Update(headers.RequestLimit, headers.RemainingRequests, headers.RequestsResetTime, ownRequests);
+	Tokens.Update(headers.TokenLimit, headers.RemainingTokens, headers.TokensResetTime, ownTokens);
+}
+
+void FBartlebyRateLimiter::Pause(double now, float seconds)
+{
+	PausedUntil = FMath::Max(PausedUntil, now + FMath::Max(0.0f, seconds));
+}
+
+void FBartlebyRateLimiter::Refill(double now)
+{
+	const double seconds = FMath::Max(0.0, now - LastRefillTime);
+	LastRefillTime = now;
+	Requests.Refill(seconds);
+	Tokens.Refill(seconds);
+}
+
+void FBartlebyRateLimiter::FBucket::Refill(double seconds)
+{
+	Available = FMath::Min(Capacity, Available + RefillPerSecond * seconds);
+}
+
+void FBartlebyRateLimiter::FBucket::Update(int64 limit, int64 remaining, float resetTime, double own)
+{
+	if (limit > 0)
+	{
+		Capacity = static_cast<double>(limit);
+	}
+	if (Capacity <= 0.0 || remaining < 0)
+	{
+		return;
+	}
+	// Anything else still out might not have been counted yet.
+	Available = FMath::Min(Capacity, static_cast<double>(remaining)) - FMath::Max(0.0, InFlight - own);
+	// The reset time is how long until the bucket is full again, which gives how fast it fills.
+	const double missing = Capacity - static_cast<double>(remaining);
+	RefillPerSecond = resetTime > 0.0f && missing > 0.0 ? missing / resetTime : Capacity / DefaultRefillTime;
+}
+
+float FBartlebyRateLimiter::FBucket::GetWait(double amount) const
+{
+	if (Capacity <= 0.0 || Available >= amount)
+	{
+		return 0.0f;
+	}
+	return RefillPerSecond > 0.0 ? static_cast<float>((amount - Available) / RefillPerSecond) : static_cast<float>(DefaultRefillTime);
+}
@@ -0,0 +1,105 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IHttpResponse;
+
+// What the server said about its rate limits in the headers of a response. Anything it didn't say is negative.
+struct BARTLEBY_API FBartlebyRateLimitHeaders
+{
+	// Requests allowed per window, how many are left, and seconds until they're all back.
+	int64 RequestLimit = -1;
+	int64 RemainingRequests = -1;
+	float RequestsResetTime = -1.0f;
+	// Same for tokens.
+	int64 TokenLimit = -1;
+	int64 RemainingTokens = -1;
+	float TokensResetTime = -1.0f;
+	// Seconds the server asked us to wait before trying again.
+	float RetryAfter = -1.0f;
+
+	// Reads the x-ratelimit-* and retry-after headers. Safe to call from any thread.
+	static FBartlebyRateLimitHeaders FromResponse(const IHttpResponse& response);
+	// Reads a duration like "6m0s", "1.5s" or "20ms" into seconds. A bare number is seconds. Returns a negative number
+	// if it can't be read.
+	static float ParseDuration(const FString& text);
+	// True if the server said anything about its limits.
+	bool HasAny() const { return RequestLimit >= 0 || RemainingRequests >= 0 || TokenLimit >= 0 || RemainingTokens >= 0 || RetryAfter >= 0.0f; }
+	// Seconds to wait after being turned away: what the server asked for, or else until whatever ran out comes back.
+	// Negative if the headers don't say.
+	float GetRetryDelay() const;
+};
+
+// Keeps track of how much of the server's rate limit is left, so calls can wait until there's room for them instead of
+// being turned away. Requests and tokens are each a bucket that refills at a steady rate. The server's headers say how
+// full each bucket really is, and calls that are still out are taken off that, since they may not have been counted
+// yet. That errs on the side of waiting.
+class BARTLEBY_API FBartlebyRateLimiter
+{
+public:
+	// The limits are per minute, and are used until the server says what they really are. Zero holds nothing back until
+	// then.
+	FBartlebyRateLimiter(int32 requestsPerMinute, int32 tokensPerMinute);
+
+	// Takes a request and the given number of tokens out of the buckets, if there's room. Otherwise returns false, and
+	// sets how many seconds until there should be.
+	bool TryAcquire(double now, int32 tokens, float& outWait);
+	// Stops counting a request that took the given number of requests and tokens as still out.
+	void Release(int32 requests, int32 tokens);
+	// Fills the buckets to what the server says is left. The given requests and tokens belong to the call the headers
+	// came with, which the server has already counted.
+	void Update(double now, const FBartlebyRateLimitHeaders& headers, int32 ownRequests, int32 ownTokens);
+	// Holds everything back for the given number of seconds, after the server said to slow down.
+	void Pause(double now, float seconds);
+
+	// What's left in each bucket, or -1 if its size isn't known.
+	int32 GetRemainingRequests() const { return Requests.Capacity > 0.0 ? FMath::FloorToInt(Requests.Available) : -1; }
+	int32 GetRemainingTokens() const { return Tokens.Capacity > 0.0 ? FMath::FloorToInt(Tokens.Available) : -1; }
+
+private:
+	struct FBucket
+	{
+		// Most the bucket holds, or 0 if that isn't known, in which case nothing is held back.
+		double Capacity = 0.0;
+		double Available = 0.0;
+		double RefillPerSecond = 0.0;
+		// Taken by calls that are still out.
+		double InFlight = 0.0;
+
+		void Refill(double seconds);
+		void Update(int64 limit, int64 remaining, float resetTime, double own);
+		// Seconds until the bucket has the given amount.
+		float GetWait(double amount) const;
+	};
+	// Tops up both buckets for the time since they were last topped up.
+	void Refill(double now);
+
+	FBucket Requests;
+	FBucket Tokens;
+	double LastRefillTime = 0.0;
+	// Nothing goes out before this time.
+	double PausedUntil = 0.0;
+};
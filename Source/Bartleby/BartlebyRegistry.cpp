@@ -0,0 +1,140 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyRegistry.h"
+#include "Bartleby/BartlebySystem.h"
+#include "Bartleby/BartlebyRoom.h"
+#include "Bartleby/BartlebyObject.h"
+#include "Bartleby/BartlebyController.h"
+#include "Bartleby/BartlebyTrace.h"
+#include "UObject/GCObject.h"
+
+void FBartlebyRegistry::RegisterSystem(ABartlebySystem* system)
+{
+	if (System && System != system)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("There's already a BartlebySystem, so %s will be left alone."), *system->GetName());
+		return;
+	}
+	System = system;
+}
+
+void FBartlebyRegistry::UnregisterSystem(ABartlebySystem* system)
+{
+	if (System == system)
+	{
+		System = nullptr;
+	}
+}
+
+void FBartlebyRegistry::RegisterRoom(ABartlebyRoom* room)
+{
+	PendingRooms.Add(room);
+}
+
+void FBartlebyRegistry::UnregisterRoom(ABartlebyRoom* room)
+{
+	PendingRooms.RemoveSingleSwap(room);
+	if (System)
+	{
+		// Keep the order, since the first room wins where rooms overlap.
+		System->Rooms.RemoveSingle(room);
+	}
+}
+
+void FBartlebyRegistry::RegisterObject(UBartlebyObject* object)
+{
+	PendingObjects.Add(object);
+}
+
+void FBartlebyRegistry::UnregisterObject(UBartlebyObject* object)
+{
+	PendingObjects.RemoveSingleSwap(object);
+	if (object->Room)
+	{
+		object->Room->Objects.RemoveSingle(object);
+		object->Room = nullptr;
+	}
+}
+
+void FBartlebyRegistry::RegisterController(ABartlebyController* controller)
+{
+	PendingControllers.Add(controller);
+}
+
+void FBartlebyRegistry::UnregisterController(ABartlebyController* controller)
+{
+	PendingControllers.RemoveSingleSwap(controller);
+}
+
+void FBartlebyRegistry::ResolvePending()
+{
+	if (!System)
+	{
+		return;
+	}
+	BARTLEBY_TRACE_SCOPE(ResolvePending);
+	// Rooms first, so that there's something to put everything else in.
+	if (PendingRooms.Num() > 0)
+	{
+		for (ABartlebyRoom* room : PendingRooms)
+		{
+			if (room)
+			{
+				System->Rooms.Add(room);
+			}
+		}
+		PendingRooms.Reset();
+		System->PrepareRooms();
+	}
+	for (UBartlebyObject* object : PendingObjects)
+	{
+		if (!object || !object->GetOwner())
+		{
+			continue;
+		}
+		object->System = System;
+		object->Room = System->GetRoomAtOrNull(object->GetOwner()->GetActorLocation());
+		if (object->Room)
+		{
+			object->Room->Objects.Add(object);
+		}
+	}
+	PendingObjects.Reset();
+	for (ABartlebyController* controller : PendingControllers)
+	{
+		if (controller)
+		{
+			controller->Connect(System);
+		}
+	}
+	PendingControllers.Reset();
+}
+
+void FBartlebyRegistry::AddReferencedObjects(FReferenceCollector& collector)
+{
+	collector.AddReferencedObject(System);
+	collector.AddReferencedObjects(PendingRooms);
+	collector.AddReferencedObjects(PendingObjects);
+	collector.AddReferencedObjects(PendingControllers);
+}
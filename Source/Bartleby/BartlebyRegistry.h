@@ -0,0 +1,70 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABartlebySystem;
+class ABartlebyRoom;
+class ABartlebyController;
+class UBartlebyObject;
+class FReferenceCollector;
+
+// Holds the Bartleby system, and the rooms, objects and controllers waiting to be placed with it, and places them all
+// in one pass: rooms go to the system, and objects and controllers go in the rooms they start in. The world's subsystem
+// keeps one, and decides when to place what's waiting. It's a plain class so that anything else, like the startup
+// benchmark, can have one of its own without touching the world's.
+class BARTLEBY_API FBartlebyRegistry
+{
+public:
+	void RegisterSystem(ABartlebySystem* system);
+	void UnregisterSystem(ABartlebySystem* system);
+	void RegisterRoom(ABartlebyRoom* room);
+	void UnregisterRoom(ABartlebyRoom* room);
+	void RegisterObject(UBartlebyObject* object);
+	void UnregisterObject(UBartlebyObject* object);
+	void RegisterController(ABartlebyController* controller);
+	void UnregisterController(ABartlebyController* controller);
+
+	// Gets the system, or null if there isn't one yet.
+	ABartlebySystem* GetSystem() const { return System; }
+
+	// True if anything is waiting to be placed.
+	bool HasPending() const { return PendingRooms.Num() > 0 || PendingObjects.Num() > 0 || PendingControllers.Num() > 0; }
+
+	// Places everything that is waiting, if there is a system to place it with. The rooms are indexed and connected
+	// once, however many there are.
+	void ResolvePending();
+
+	// Keeps the system and everything waiting from being garbage collected, for whatever owns the registry.
+	void AddReferencedObjects(FReferenceCollector& collector);
+
+private:
+	ABartlebySystem* System = nullptr;
+
+	// Things waiting to be placed.
+	TArray<ABartlebyRoom*> PendingRooms;
+	TArray<UBartlebyObject*> PendingObjects;
+	TArray<ABartlebyController*> PendingControllers;
+};
@@ -0,0 +1,829 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyResponseParser.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Misc/EngineVersionComparison.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+	// Appends a unicode code point, as a surrogate pair if TCHAR is UTF-16.
+	void AppendCodepoint(FString* Out, uint32 Codepoint)
+	{
+		if (!Out)
+		{
+			return;
+		}
+		if (Codepoint > 0xFFFF && sizeof(TCHAR) == 2)
+		{
+			Codepoint -= 0x10000;
+			Out->AppendChar(static_cast<TCHAR>(0xD800 + (Codepoint >> 10)));
+			Out->AppendChar(static_cast<TCHAR>(0xDC00 + (Codepoint & 0x3FF)));
+			return;
+		}
+		Out->AppendChar(static_cast<TCHAR>(Codepoint));
+	}
+
+	// Decodes a run of UTF-8 with no escapes in it. Bad sequences become U+FFFD rather than failing the whole response.
+	void AppendUtf8(FString* Out, const uint8* Begin, const uint8* End)
+	{
+		if (!Out || Begin == End)
+		{
+			return;
+		}
+		Out->Reserve(Out->Len() + static_cast<int32>(End - Begin));
+		const uint8* p = Begin;
+		while (p < End)
+		{
+			const uint32 lead = *p;
+			if (lead < 0x80)
+			{
+				Out->AppendChar(static_cast<TCHAR>(lead));
+				p++;
+				continue;
+			}
+			int32 numContinuation = 0;
+			uint32 codepoint = 0;
+			uint32 minCodepoint = 0;
+			if ((lead & 0xE0) == 0xC0)
+			{
+				numContinuation = 1;
+				codepoint = lead & 0x1F;
+				minCodepoint = 0x80;
+			}
+			else if ((lead & 0xF0) == 0xE0)
+			{
+				numContinuation = 2;
+				codepoint = lead & 0x0F;
+				minCodepoint = 0x800;
+			}
+			else if ((lead & 0xF8) == 0xF0)
+			{
+				numContinuation = 3;
+				codepoint = lead & 0x07;
+				minCodepoint = 0x10000;
+			}
+			bool isValid = numContinuation > 0 && End - p > numContinuation;
+			for (int32 i = 1; isValid && i <= numContinuation; i++)
+			{
+				isValid = (p[i] & 0xC0) == 0x80;
+				codepoint = (codepoint << 6) | (p[i] & 0x3F);
+			}
+			// Overlong encodings, surrogates and anything past the end of unicode aren't allowed either.
+			if (!isValid || codepoint < minCodepoint || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+			{
+				Out->AppendChar(static_cast<TCHAR>(0xFFFD));
+				p++;
+				continue;
+			}
+			AppendCodepoint(Out, codepoint);
+			p += numContinuation + 1;
+		}
+	}
+
+	bool IsDigit(uint8 Char)
+	{
+		return Char >= '0' && Char <= '9';
+	}
+}
+
+EBartlebyScanResult FBartlebyResponseScanner::Scan(const uint8* Data, int32 Num, FBartlebyCompletion& Out, int32* OutErrorOffset)
+{
+	FBartlebyResponseScanner scanner(Data, Num);
+	EBartlebyScanResult result = scanner.ScanResponse(Out);
+	if (result == EBartlebyScanResult::Malformed && OutErrorOffset)
+	{
+		*OutErrorOffset = static_cast<int32>(scanner.Cur - scanner.Begin);
+	}
+	return result;
+}
+
+EBartlebyScanResult FBartlebyResponseScanner::ScanResponse(FBartlebyCompletion& Out)
+{
+	// The response looks like {"choices":[{"message":{"content":"..."},"finish_reason":"stop"}],"usage":{...}}, or
+	// {"error":{"message":"..."}} if something went wrong.
+	bool isError = false;
+	if (!Consume('{'))
+	{
+		return EBartlebyScanResult::Malformed;
+	}
+	if (!Consume('}'))
+	{
+		bool isClosed = false;
+		while (!isClosed)
+		{
+			const uint8* key = nullptr;
+			int32 keyLength = 0;
+			bool isEscaped = false;
+			if (!ReadKey(key, keyLength, isEscaped))
+			{
+				return EBartlebyScanResult::Malformed;
+			}
+			bool isValid = true;
+			if (KeyIs(key, keyLength, isEscaped, "choices"))
+			{
+				isValid = ScanChoices(Out);
+			}
+			else if (KeyIs(key, keyLength, isEscaped, "usage"))
+			{
+				isValid = ScanUsage(Out);
+			}
+			else if (KeyIs(key, keyLength, isEscaped, "error"))
+			{
+				isError = true;
+				isValid = ScanError(Out);
+			}
+			else
+			{
+				isValid = SkipValue(1);
+			}
+			if (!isValid || !ReadSeparator('}', isClosed))
+			{
+				return EBartlebyScanResult::Malformed;
+			}
+		}
+	}
+	// Nothing but whitespace is allowed after the response.
+	if (Peek() != 0 || Cur != End)
+	{
+		return EBartlebyScanResult::Malformed;
+	}
+	return isError ? EBartlebyScanResult::ApiError : EBartlebyScanResult::Ok;
+}
+
+bool FBartlebyResponseScanner::ScanChoices(FBartlebyCompletion& Out)
+{
+	if (Peek() != '[')
+	{
+		return SkipValue(1);
+	}
+	Cur++;
+	if (Consume(']'))
+	{
+		return true;
+	}
+	// We only want the first choice, the rest are just checked.
+	bool isFirst = true;
+	bool isClosed = false;
+	while (!isClosed)
+	{
+		const bool isValid = isFirst && Peek() == '{' ? ScanChoice(Out) : SkipValue(2);
+		if (!isValid || !ReadSeparator(']', isClosed))
+		{
+			return false;
+		}
+		isFirst = false;
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::ScanChoice(FBartlebyCompletion& Out)
+{
+	Cur++;
+	if (Consume('}'))
+	{
+		return true;
+	}
+	bool isClosed = false;
+	while (!isClosed)
+	{
+		const uint8* key = nullptr;
+		int32 keyLength = 0;
+		bool isEscaped = false;
+		if (!ReadKey(key, keyLength, isEscaped))
+		{
+			return false;
+		}
+		bool isValid = true;
+		// Whole responses have a "message", streamed chunks have a "delta". Both hold the content.
+		if ((KeyIs(key, keyLength, isEscaped, "message") || KeyIs(key, keyLength, isEscaped, "delta")) && Peek() == '{')
+		{
+			isValid = ScanMessage(Out);
+		}
+		else if (KeyIs(key, keyLength, isEscaped, "finish_reason"))
+		{
+			bool wasNull = false;
+			isValid = ReadStringOrNull(Out.FinishReason, wasNull);
+		}
+		else
+		{
+			isValid = SkipValue(3);
+		}
+		if (!isValid || !ReadSeparator('}', isClosed))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::ScanMessage(FBartlebyCompletion& Out)
+{
+	Cur++;
+	if (Consume('}'))
+	{
+		return true;
+	}
+	bool isClosed = false;
+	while (!isClosed)
+	{
+		const uint8* key = nullptr;
+		int32 keyLength = 0;
+		bool isEscaped = false;
+		if (!ReadKey(key, keyLength, isEscaped))
+		{
+			return false;
+		}
+		bool isValid = true;
+		if (KeyIs(key, keyLength, isEscaped, "content"))
+		{
+			bool wasNull = false;
+			isValid = ReadStringOrNull(Out.Content, wasNull);
+			Out.bHasContent = isValid && !wasNull;
+		}
+		else
+		{
+			isValid = SkipValue(4);
+		}
+		if (!isValid || !ReadSeparator('}', isClosed))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::ScanUsage(FBartlebyCompletion& Out)
+{
+	if (Peek() != '{')
+	{
+		return SkipValue(1);
+	}
+	Cur++;
+	if (Consume('}'))
+	{
+		return true;
+	}
+	bool isClosed = false;
+	while (!isClosed)
+	{
+		const uint8* key = nullptr;
+		int32 keyLength = 0;
+		bool isEscaped = false;
+		if (!ReadKey(key, keyLength, isEscaped))
+		{
+			return false;
+		}
+		int32* count = nullptr;
+		if (KeyIs(key, keyLength, isEscaped, "prompt_tokens"))
+		{
+			count = &Out.PromptTokens;
+		}
+		else if (KeyIs(key, keyLength, isEscaped, "completion_tokens"))
+		{
+			count = &Out.CompletionTokens;
+		}
+		else if (KeyIs(key, keyLength, isEscaped, "total_tokens"))
+		{
+			count = &Out.TotalTokens;
+		}
+		const uint8 next = Peek();
+		const bool isValid = count && (next == '-' || IsDigit(next)) ? ReadInt(*count) : SkipValue(2);
+		if (!isValid || !ReadSeparator('}', isClosed))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::ScanError(FBartlebyCompletion& Out)
+{
+	// Usually {"message": "...", "type": ...}, but some servers just send a string.
+	const uint8 next = Peek();
+	if (next == '"')
+	{
+		return ReadString(&Out.ErrorMessage);
+	}
+	if (next != '{')
+	{
+		return SkipValue(1);
+	}
+	Cur++;
+	if (Consume('}'))
+	{
+		return true;
+	}
+	bool isClosed = false;
+	while (!isClosed)
+	{
+		const uint8* key = nullptr;
+		int32 keyLength = 0;
+		bool isEscaped = false;
+		if (!ReadKey(key, keyLength, isEscaped))
+		{
+			return false;
+		}
+		const bool isValid = KeyIs(key, keyLength, isEscaped, "message") && Peek() == '"' ?
+			ReadString(&Out.ErrorMessage) : SkipValue(2);
+		if (!isValid || !ReadSeparator('}', isClosed))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FBartlebyResponseScanner::SkipWhitespace()
+{
+	while (Cur < End && (*Cur == ' ' || *Cur == '\t' || *Cur == '\n' || *Cur == '\r'))
+	{
+		Cur++;
+	}
+}
+
+uint8 FBartlebyResponseScanner::Peek()
+{
+	SkipWhitespace();
+	return Cur < End ? *Cur : 0;
+}
+
+bool FBartlebyResponseScanner::Consume(uint8 Char)
+{
+	if (Peek() != Char || Cur >= End)
+	{
+		return false;
+	}
+	Cur++;
+	return true;
+}
+
+bool FBartlebyResponseScanner::ReadKey(const uint8*& OutKey, int32& OutLength, bool& bOutEscaped)
+{
+	if (Peek() != '"')
+	{
+		return false;
+	}
+	const uint8* start = Cur + 1;
+	if (!ReadString(nullptr))
+	{
+		return false;
+	}
+	OutKey = start;
+	OutLength = static_cast<int32>(Cur - 1 - start);
+	bOutEscaped = false;
+	for (int32 i = 0; i < OutLength && !bOutEscaped; i++)
+	{
+		bOutEscaped = start[i] == '\\';
+	}
+	return Consume(':');
+}
+
+bool FBartlebyResponseScanner::ReadSeparator(uint8 Close, bool& bOutClosed)
+{
+	const uint8 next = Peek();
+	if (next == ',' || (next == Close && Cur < End))
+	{
+		Cur++;
+		bOutClosed = next == Close;
+		return true;
+	}
+	return false;
+}
+
+bool FBartlebyResponseScanner::ReadString(FString* Out)
+{
+	if (Peek() != '"')
+	{
+		return false;
+	}
+	Cur++;
+	if (Out)
+	{
+		Out->Reset();
+	}
+	// Copy runs of plain text in one go, and only stop for escapes.
+	const uint8* runStart = Cur;
+	while (Cur < End)
+	{
+		const uint8 c = *Cur;
+		if (c == '"')
+		{
+			AppendUtf8(Out, runStart, Cur);
+			Cur++;
+			return true;
+		}
+		if (c < 0x20)
+		{
+			// Control characters have to be escaped.
+			return false;
+		}
+		if (c != '\\')
+		{
+			Cur++;
+			continue;
+		}
+		AppendUtf8(Out, runStart, Cur);
+		Cur++;
+		if (Cur >= End)
+		{
+			return false;
+		}
+		const uint8 escape = *Cur++;
+		switch (escape)
+		{
+		case '"': AppendCodepoint(Out, '"'); break;
+		case '\\': AppendCodepoint(Out, '\\'); break;
+		case '/': AppendCodepoint(Out, '/'); break;
+		case 'b': AppendCodepoint(Out, '\b'); break;
+		case 'f': AppendCodepoint(Out, '\f'); break;
+		case 'n': AppendCodepoint(Out, '\n'); break;
+		case 'r': AppendCodepoint(Out, '\r'); break;
+		case 't': AppendCodepoint(Out, '\t'); break;
+		case 'u':
+		{
+			uint32 codepoint = 0;
+			if (!ReadHex4(codepoint))
+			{
+				return false;
+			}
+			// Characters outside the basic plane come in as two escaped surrogates.
+			if (codepoint >= 0xD800 && codepoint <= 0xDBFF && End - Cur >= 6 && Cur[0] == '\\' && Cur[1] == 'u')
+			{
+				const uint8* highEnd = Cur;
+				Cur += 2;
+				uint32 low = 0;
+				if (!ReadHex4(low))
+				{
+					return false;
+				}
+				if (low >= 0xDC00 && low <= 0xDFFF)
+				{
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else
+				{
+					// Not a pair after all, so read the second escape on its own.
+					Cur = highEnd;
+				}
+			}
+			AppendCodepoint(Out, codepoint >= 0xD800 && codepoint <= 0xDFFF ? 0xFFFD : codepoint);
+			break;
+		}
+		default:
+			return false;
+		}
+		runStart = Cur;
+	}
+	// Ran out of bytes before the closing quote.
+	return false;
+}
+
+bool FBartlebyResponseScanner::ReadHex4(uint32& Out)
+{
+	if (End - Cur < 4)
+	{
+		return false;
+	}
+	Out = 0;
+	for (int32 i = 0; i < 4; i++)
+	{
+		const uint8 c = *Cur++;
+		uint32 digit = 0;
+		if (IsDigit(c))
+		{
+			digit = c - '0';
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			digit = c - 'a' + 10;
+		}
+		else if (c >= 'A' && c <= 'F')
+		{
+			digit = c - 'A' + 10;
+		}
+		else
+		{
+			return false;
+		}
+		Out = (Out << 4) | digit;
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::ReadStringOrNull(FString& Out, bool& bOutWasNull)
+{
+	bOutWasNull = Peek() == 'n';
+	if (bOutWasNull)
+	{
+		Out.Reset();
+		return SkipLiteral();
+	}
+	return ReadString(&Out);
+}
+
+bool FBartlebyResponseScanner::ReadInt(int32& Out)
+{
+	SkipWhitespace();
+	const uint8* start = Cur;
+	if (!SkipNumber())
+	{
+		return false;
+	}
+	// Anything after a decimal point is dropped, and anything too big is clamped.
+	const uint8* p = start;
+	const bool isNegative = *p == '-';
+	if (isNegative)
+	{
+		p++;
+	}
+	int64 value = 0;
+	while (p < Cur && IsDigit(*p))
+	{
+		value = FMath::Min<int64>(value * 10 + (*p - '0'), MAX_int32);
+		p++;
+	}
+	Out = static_cast<int32>(isNegative ? -value : value);
+	return true;
+}
+
+bool FBartlebyResponseScanner::SkipValue(int32 Depth)
+{
+	const uint8 next = Peek();
+	if (next == '{' || next == '[')
+	{
+		if (Depth >= MaxDepth)
+		{
+			return false;
+		}
+		const uint8 close = next == '{' ? '}' : ']';
+		Cur++;
+		if (Consume(close))
+		{
+			return true;
+		}
+		bool isClosed = false;
+		while (!isClosed)
+		{
+			if (next == '{')
+			{
+				const uint8* key = nullptr;
+				int32 keyLength = 0;
+				bool isEscaped = false;
+				if (!ReadKey(key, keyLength, isEscaped))
+				{
+					return false;
+				}
+			}
+			if (!SkipValue(Depth + 1) || !ReadSeparator(close, isClosed))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	if (next == '"')
+	{
+		return ReadString(nullptr);
+	}
+	if (next == '-' || IsDigit(next))
+	{
+		return SkipNumber();
+	}
+	return SkipLiteral();
+}
+
+bool FBartlebyResponseScanner::SkipNumber()
+{
+	// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+	if (Cur < End && *Cur == '-')
+	{
+		Cur++;
+	}
+	if (Cur >= End || !IsDigit(*Cur))
+	{
+		return false;
+	}
+	if (*Cur == '0')
+	{
+		Cur++;
+	}
+	else
+	{
+		while (Cur < End && IsDigit(*Cur))
+		{
+			Cur++;
+		}
+	}
+	if (Cur < End && *Cur == '.')
+	{
+		Cur++;
+		if (Cur >= End || !IsDigit(*Cur))
+		{
+			return false;
+		}
+		while (Cur < End && IsDigit(*Cur))
+		{
+			Cur++;
+		}
+	}
+	if (Cur < End && (*Cur == 'e' || *Cur == 'E'))
+	{
+		Cur++;
+		if (Cur < End && (*Cur == '+' || *Cur == '-'))
+		{
+			Cur++;
+		}
+		if (Cur >= End || !IsDigit(*Cur))
+		{
+			return false;
+		}
+		while (Cur < End && IsDigit(*Cur))
+		{
+			Cur++;
+		}
+	}
+	return true;
+}
+
+bool FBartlebyResponseScanner::SkipLiteral()
+{
+	SkipWhitespace();
+	for (const ANSICHAR* literal : { "true", "false", "null" })
+	{
+		const int32 length = FCStringAnsi::Strlen(literal);
+		if (End - Cur >= length && FMemory::Memcmp(Cur, literal, length) == 0)
+		{
+			Cur += length;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FBartlebyResponseScanner::KeyIs(const uint8* Key, int32 Length, bool bEscaped, const ANSICHAR* Name)
+{
+	return !bEscaped && FCStringAnsi::Strlen(Name) == Length && FMemory::Memcmp(Key, Name, Length) == 0;
+}
+
+bool FBartlebyStreamParser::Feed(const TArray<uint8>& Body)
+{
+	// Events are separated by newlines. Only parse whole lines, the rest will come in with the next chunk.
+	for (int32 i = ConsumedBytes; i < Body.Num(); i++)
+	{
+		if (Body[i] != '\n')
+		{
+			continue;
+		}
+		int32 lineLength = i - ConsumedBytes;
+		if (lineLength > 0 && Body[i - 1] == '\r')
+		{
+			lineLength--;
+		}
+		const uint8* line = Body.GetData() + ConsumedBytes;
+		ConsumedBytes = i + 1;
+
+		// Skip comments, blank separators and anything that isn't data.
+		if (lineLength < 5 || FMemory::Memcmp(line, "data:", 5) != 0)
+		{
+			continue;
+		}
+		const uint8* data = line + 5;
+		int32 dataLength = lineLength - 5;
+		while (dataLength > 0 && (data[0] == ' ' || data[0] == '\t'))
+		{
+			data++;
+			dataLength--;
+		}
+		while (dataLength > 0 && (data[dataLength - 1] == ' ' || data[dataLength - 1] == '\t'))
+		{
+			dataLength--;
+		}
+		if (dataLength == 6 && FMemory::Memcmp(data, "[DONE]", 6) == 0)
+		{
+			bIsDone = true;
+			continue;
+		}
+		ParseEvent(data, dataLength);
+	}
+	FString action;
+	return GetFirstAction(action);
+}
+
+void FBartlebyStreamParser::ParseEvent(const uint8* Data, int32 Num)
+{
+	// Each chunk looks like {"choices":[{"delta":{"content":"..."},"finish_reason":null}]}.
+	FBartlebyCompletion chunk;
+	int32 errorOffset = 0;
+	switch (FBartlebyResponseScanner::Scan(Data, Num, chunk, &errorOffset))
+	{
+	case EBartlebyScanResult::Malformed:
+		UE_LOG(LogTemp, Error, TEXT("Failed to parse streamed event at byte %d: %s"), errorOffset,
+			*FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(Data), Num)));
+		bHasError = true;
+		return;
+	case EBartlebyScanResult::ApiError:
+		UE_LOG(LogTemp, Error, TEXT("API returned an error: %s"), *chunk.ErrorMessage);
+		bHasError = true;
+		return;
+	default:
+		break;
+	}
+	if (chunk.bHasContent)
+	{
+		Content += chunk.Content;
+	}
+	if (!chunk.FinishReason.IsEmpty())
+	{
+		bIsDone = true;
+	}
+}
+
+bool FBartlebyStreamParser::GetFirstAction(FString& OutAction) const
+{
+	// Skip any empty lines at the start, just like ParseIntoArrayLines does.
+	int32 start = 0;
+	while (start < Content.Len() && (Content[start] == '\n' || Content[start] == '\r'))
+	{
+		start++;
+	}
+	int32 end = start;
+	while (end < Content.Len() && Content[end] != '\n' && Content[end] != '\r')
+	{
+		end++;
+	}
+	OutAction = Content.Mid(start, end - start);
+	if (OutAction.IsEmpty())
+	{
+		return false;
+	}
+	if (end < Content.Len() || bIsDone)
+	{
+		return true;
+	}
+	// The AI doesn't always bother with a newline, but once both brackets are in, the command can be parsed.
+	int32 openBracketIndex = OutAction.Find(TEXT("("));
+	int32 closeBracketIndex = OutAction.Find(TEXT(")"));
+	return openBracketIndex != INDEX_NONE && closeBracketIndex != INDEX_NONE && closeBracketIndex > openBracketIndex;
+}
+
+FBartlebyStreamBuffer::FBartlebyStreamBuffer()
+{
+	SetIsSaving(true);
+	SetIsPersistent(false);
+}
+
+bool FBartlebyStreamBuffer::Attach(IHttpRequest& Request, const TSharedRef<FBartlebyStreamBuffer>& Buffer)
+{
+	// Before 5.3 the body only comes out of the response, and reading it there while it's still coming in races with
+	// the HTTP thread, so it has to wait until the request is done.
+#if UE_VERSION_OLDER_THAN(5, 3, 0)
+	return false;
+#else
+	return Request.SetResponseBodyReceiveStream(Buffer);
+#endif
+}
+
+void FBartlebyStreamBuffer::Append(const uint8* Data, int32 Num)
+{
+	FScopeLock ScopeLock(&Lock);
+	Incoming.Append(Data, Num);
+}
+
+void FBartlebyStreamBuffer::Serialize(void* Data, int64 Num)
+{
+	Append(static_cast<const uint8*>(Data), static_cast<int32>(Num));
+}
+
+bool FBartlebyStreamBuffer::Update()
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Incoming.Num() == 0)
+	{
+		return false;
+	}
+	Body.Append(Incoming);
+	Incoming.Reset();
+	return true;
+}
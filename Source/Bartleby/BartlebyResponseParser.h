@@ -0,0 +1,179 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The parts of a chat completion (or one streamed chunk of one) that we care about.
+struct BARTLEBY_API FBartlebyCompletion
+{
+	// Text of the first choice. For streamed chunks, this is just the new text.
+	FString Content;
+	// Why the AI stopped generating, e.g. "stop" or "length". Empty if it hasn't stopped yet.
+	FString FinishReason;
+	// The message from an {"error": ...} response.
+	FString ErrorMessage;
+	// Token counts from "usage", or -1 if the response didn't have them.
+	int32 PromptTokens = -1;
+	int32 CompletionTokens = -1;
+	int32 TotalTokens = -1;
+	// True if the first choice had any content, even an empty string.
+	bool bHasContent = false;
+};
+
+// What came of scanning a response.
+enum class EBartlebyScanResult : uint8
+{
+	// The JSON was fine. Check bHasContent to see whether there was anything to say.
+	Ok,
+	// The response wasn't valid JSON, or was nested too deep.
+	Malformed,
+	// The response was valid, but it was an error from the API.
+	ApiError,
+};
+
+// Pulls the content, finish reason and usage out of a chat completion in a single pass over the UTF-8 bytes, without
+// building a JSON DOM. Everything else in the response is skipped over, but still checked to be valid JSON.
+class BARTLEBY_API FBartlebyResponseScanner
+{
+public:
+	// Scans a whole response body, or the payload of a single streamed "data:" event. If the response is malformed,
+	// OutErrorOffset is set to the byte where the problem is.
+	static EBartlebyScanResult Scan(const uint8* Data, int32 Num, FBartlebyCompletion& Out, int32* OutErrorOffset = nullptr);
+	static EBartlebyScanResult Scan(const TArray<uint8>& Body, FBartlebyCompletion& Out, int32* OutErrorOffset = nullptr)
+	{
+		return Scan(Body.GetData(), Body.Num(), Out, OutErrorOffset);
+	}
+
+	// Deepest nesting of arrays and objects that will be scanned before giving up.
+	static constexpr int32 MaxDepth = 64;
+
+private:
+	FBartlebyResponseScanner(const uint8* Data, int32 Num) : Begin(Data), Cur(Data), End(Data + Num) {}
+
+	EBartlebyScanResult ScanResponse(FBartlebyCompletion& Out);
+	bool ScanChoices(FBartlebyCompletion& Out);
+	bool ScanChoice(FBartlebyCompletion& Out);
+	bool ScanMessage(FBartlebyCompletion& Out);
+	bool ScanUsage(FBartlebyCompletion& Out);
+	bool ScanError(FBartlebyCompletion& Out);
+
+	// Skips spaces, tabs and newlines.
+	void SkipWhitespace();
+	// Skips whitespace, then returns the next character without consuming it, or 0 at the end.
+	uint8 Peek();
+	// Skips whitespace, then consumes the given character if it's next.
+	bool Consume(uint8 Char);
+	// Reads an object key and the colon after it. Escaped keys never match anything we look for.
+	bool ReadKey(const uint8*& OutKey, int32& OutLength, bool& bOutEscaped);
+	// Reads the next ',' or the given closing bracket. Sets bOutClosed if it was the bracket.
+	bool ReadSeparator(uint8 Close, bool& bOutClosed);
+	// Reads a string, decoding it into Out if it isn't null.
+	bool ReadString(FString* Out);
+	// Reads the four hex digits of a \u escape.
+	bool ReadHex4(uint32& Out);
+	// Reads a string or null. bOutWasNull is set if it was null.
+	bool ReadStringOrNull(FString& Out, bool& bOutWasNull);
+	// Reads a whole number that fits in an int32.
+	bool ReadInt(int32& Out);
+	// Skips any value, checking that it is valid.
+	bool SkipValue(int32 Depth);
+	// Skips a number.
+	bool SkipNumber();
+	// Skips true, false or null.
+	bool SkipLiteral();
+
+	static bool KeyIs(const uint8* Key, int32 Length, bool bEscaped, const ANSICHAR* Name);
+
+	const uint8* Begin;
+	const uint8* Cur;
+	const uint8* End;
+};
+
+// Incrementally parses a streamed ("stream": true) chat completion. The API sends these as server-sent events, one
+// "data: {...}" line per chunk of generated text. Feed the parser the response body as it grows, and it will
+// accumulate the content of the first choice and tell you when the first action line is complete.
+class BARTLEBY_API FBartlebyStreamParser
+{
+public:
+	// Parses any bytes of the body that haven't been seen yet. Returns true if the first action line is complete.
+	bool Feed(const TArray<uint8>& Body);
+
+	// Gets the first non-empty line of the content. Returns true if that line is a complete action, which is the
+	// case when it ends in a newline, when it contains a full verb(arg), or when the stream is done.
+	bool GetFirstAction(FString& OutAction) const;
+
+	// All of the content streamed so far.
+	const FString& GetContent() const { return Content; }
+
+	// True once the server said it is finished.
+	bool IsDone() const { return bIsDone; }
+
+	// True if any of the events could not be parsed, or the server sent back an error.
+	bool HasError() const { return bHasError; }
+
+	// Marks that the first action was already handed off, so the rest of the stream can be ignored.
+	void MarkDispatched() { bDispatched = true; }
+	bool WasDispatched() const { return bDispatched; }
+
+private:
+	// Parses the payload of a single "data:" event.
+	void ParseEvent(const uint8* Data, int32 Num);
+
+	// How far into the body we've parsed. Always at the start of a line.
+	int32 ConsumedBytes = 0;
+	FString Content;
+	bool bIsDone = false;
+	bool bHasError = false;
+	bool bDispatched = false;
+};
+
+// Collects a streamed response body as it comes in on the HTTP thread, so that the game thread can feed what has arrived
+// to a FBartlebyStreamParser without touching the response while the HTTP thread is still writing to it.
+class BARTLEBY_API FBartlebyStreamBuffer : public FArchive
+{
+public:
+	FBartlebyStreamBuffer();
+
+	// Has the request write its body here as it comes in, on engines that can. Returns false if the engine can't, in
+	// which case the whole body has to be appended once the request is complete.
+	static bool Attach(class IHttpRequest& Request, const TSharedRef<FBartlebyStreamBuffer>& Buffer);
+
+	// Takes the next piece of the body. Safe to call from any thread.
+	void Append(const uint8* Data, int32 Num);
+	void Append(const TArray<uint8>& Data) { Append(Data.GetData(), Data.Num()); }
+	virtual void Serialize(void* Data, int64 Num) override;
+
+	// Moves whatever came in since the last update onto the end of the body. Returns true if there was anything.
+	bool Update();
+
+	// The body so far, as of the last update. Only read this from the thread that calls Update.
+	const TArray<uint8>& GetBody() const { return Body; }
+
+private:
+	// What has come in since the last update, guarded by the lock.
+	FCriticalSection Lock;
+	TArray<uint8> Incoming;
+	TArray<uint8> Body;
+};
@@ -25,6 +25,8 @@ SOFTWARE.
 
 #include "Bartleby/BartlebyRoom.h"
 #include "Bartleby/BartlebyObject.h"
+#include "Bartleby/BartlebyIdIndex.h"
+#include "Bartleby/BartlebySubsystem.h"
 #include "Components/BoxComponent.h"
 
 // Sets default values
@@ -42,14 +44,80 @@ ABartlebyRoom::ABartlebyRoom()
 void ABartlebyRoom::BeginPlay()
 {
 	Super::BeginPlay();
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
+	{
+		subsystem->RegisterRoom(this);
+	}
+}
 
-	
+void ABartlebyRoom::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
+	{
+		subsystem->UnregisterRoom(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+FOrientedBox ABartlebyRoom::GetOrientedBox() const
+{
+	const FTransform& transform = Box->GetComponentTransform();
+	const FVector extent = Box->GetScaledBoxExtent();
+	FOrientedBox box;
+	box.Center = transform.GetLocation();
+	box.AxisX = transform.GetUnitAxis(EAxis::X);
+	box.AxisY = transform.GetUnitAxis(EAxis::Y);
+	box.AxisZ = transform.GetUnitAxis(EAxis::Z);
+	box.ExtentX = extent.X;
+	box.ExtentY = extent.Y;
+	box.ExtentZ = extent.Z;
+	return box;
 }
 
 bool ABartlebyRoom::IsInside(const FVector& pt) const
 {
-	auto bx = Box->GetCollisionShape().Box;
-	FVector ext(bx.HalfExtentX, bx.HalfExtentY, bx.HalfExtentZ);
-	FVector center = Box->GetComponentLocation();
-	return FBox(center - ext, center + ext).IsInside(pt);
+	// Take the point into the box's frame, so that rotated rooms work.
+	const FVector ext = Box->GetScaledBoxExtent();
+	const FVector local = Box->GetComponentTransform().InverseTransformPositionNoScale(pt);
+	return FMath::Abs(local.X) <= ext.X && FMath::Abs(local.Y) <= ext.Y && FMath::Abs(local.Z) <= ext.Z;
+}
+
+UBartlebyObject* ABartlebyRoom::FindObjectOrNull(const FString& id, float minConfidence, float& confidence)
+{
+	// Objects is public, so it may have changed behind our back. Rooms only have a handful, so hashing them every time
+	// costs next to nothing next to the lookup.
+	const uint32 signature = ComputeObjectsSignature();
+	if (!ObjectIdIndex || ObjectIdIndexSignature != signature)
+	{
+		TArray<FString> ids;
+		ids.Reserve(Objects.Num());
+		for (const UBartlebyObject* object : Objects)
+		{
+			ids.Add(object ? object->Id : FString());
+		}
+		ObjectIdIndex = MakeShared<FBartlebyIdIndex>();
+		ObjectIdIndex->Build(ids);
+		ObjectIdIndexSignature = signature;
+	}
+	const int32 index = ObjectIdIndex->Find(id, minConfidence, confidence);
+	return index == INDEX_NONE ? nullptr : Objects[index];
+}
+
+uint32 ABartlebyRoom::ComputeObjectsSignature() const
+{
+	uint32 signature = GetTypeHash(Objects.Num());
+	for (const UBartlebyObject* object : Objects)
+	{
+		signature = HashCombine(signature, GetTypeHash(object));
+		if (object)
+		{
+			signature = HashCombine(signature, GetTypeHash(object->Id));
+		}
+	}
+	return signature;
+}
+
+void ABartlebyRoom::InvalidateObjectIndex()
+{
+	ObjectIdIndex.Reset();
 }
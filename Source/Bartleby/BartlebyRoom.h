@@ -25,6 +25,7 @@ SOFTWARE.
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Math/OrientedBox.h"
 #include "BartlebyRoom.generated.h"
 
 UCLASS()
@@ -39,6 +40,7 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 
@@ -47,6 +49,10 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		FString Description;
 
+	// Gets the room's box in world space.
+	FOrientedBox GetOrientedBox() const;
+
+	// True if the point is in the room's box. The system finds rooms with its own index, so this is for one offs.
 	UFUNCTION()
 		bool IsInside(const FVector& pt) const;
 
@@ -55,4 +61,22 @@ public:
 
 	UPROPERTY(BlueprintReadWrite, VisibleAnywhere)
 		TArray<class UBartlebyObject*> Objects;
+
+	// Gets the object in this room with the given ID, or the closest to it, or null if none is at least minConfidence
+	// sure. Confidence is from 0 to 1.
+	UFUNCTION(BlueprintCallable)
+		class UBartlebyObject* FindObjectOrNull(const FString& id, float minConfidence, float& confidence);
+
+	// Call this if the ID of an object changes, so that it can be found by it. Lookups notice on their own too.
+	UFUNCTION(BlueprintCallable)
+		void InvalidateObjectIndex();
+
+private:
+	// Hashes the objects and their IDs.
+	uint32 ComputeObjectsSignature() const;
+
+	// Finds objects by ID, and the hash of the objects it was built from. Rebuilt the next time it's used after Objects
+	// changes.
+	TSharedPtr<class FBartlebyIdIndex> ObjectIdIndex;
+	uint32 ObjectIdIndexSignature = 0;
 };
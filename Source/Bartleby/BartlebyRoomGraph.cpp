@@ -0,0 +1,171 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyRoomGraph.h"
+#include "Algo/Reverse.h"
+
+void FBartlebyRoomGraph::Build(int32 numRooms, const TArray<TPair<int32, int32>>& connections)
+{
+	// Every connection goes both ways.
+	TArray<TPair<int32, int32>> directed;
+	directed.Reserve(connections.Num() * 2);
+	for (const TPair<int32, int32>& connection : connections)
+	{
+		if (connection.Key == connection.Value || !FMath::IsWithin(connection.Key, 0, numRooms) ||
+			!FMath::IsWithin(connection.Value, 0, numRooms))
+		{
+			continue;
+		}
+		directed.Emplace(connection.Key, connection.Value);
+		directed.Emplace(connection.Value, connection.Key);
+	}
+	directed.Sort([](const TPair<int32, int32>& a, const TPair<int32, int32>& b)
+		{
+			return a.Key != b.Key ? a.Key < b.Key : a.Value < b.Value;
+		});
+
+	Offsets.Reset(numRooms + 1);
+	Neighbors.Reset(directed.Num());
+	int32 next = 0;
+	for (int32 room = 0; room < numRooms; room++)
+	{
+		Offsets.Add(Neighbors.Num());
+		for (; next < directed.Num() && directed[next].Key == room; next++)
+		{
+			if (Neighbors.Num() == Offsets.Last() || Neighbors.Last() != directed[next].Value)
+			{
+				Neighbors.Add(directed[next].Value);
+			}
+		}
+	}
+	Offsets.Add(Neighbors.Num());
+}
+
+TArrayView<const int32> FBartlebyRoomGraph::GetNeighbors(int32 room) const
+{
+	if (!FMath::IsWithin(room, 0, NumRooms()))
+	{
+		return TArrayView<const int32>();
+	}
+	return TArrayView<const int32>(Neighbors.GetData() + Offsets[room], Offsets[room + 1] - Offsets[room]);
+}
+
+bool FBartlebyRoomGraph::FindRoute(int32 from, int32 to, TArray<int32>& outRoute) const
+{
+	outRoute.Reset();
+	if (!FMath::IsWithin(from, 0, NumRooms()) || !FMath::IsWithin(to, 0, NumRooms()))
+	{
+		return false;
+	}
+	if (from == to)
+	{
+		outRoute.Add(to);
+		return true;
+	}
+	// Breadth first, so the first time we get there is through the fewest doors.
+	Parents.Init(INDEX_NONE, NumRooms());
+	Frontier.Reset();
+	Frontier.Add(from);
+	Parents[from] = from;
+	for (int32 i = 0; i < Frontier.Num() && Parents[to] == INDEX_NONE; i++)
+	{
+		const int32 room = Frontier[i];
+		for (const int32 neighbor : GetNeighbors(room))
+		{
+			if (Parents[neighbor] == INDEX_NONE)
+			{
+				Parents[neighbor] = room;
+				Frontier.Add(neighbor);
+			}
+		}
+	}
+	if (Parents[to] == INDEX_NONE)
+	{
+		return false;
+	}
+	for (int32 room = to; room != from; room = Parents[room])
+	{
+		outRoute.Add(room);
+	}
+	Algo::Reverse(outRoute);
+	return true;
+}
+
+bool FBartlebyRoomGraph::AreTouching(const FOrientedBox& a, const FOrientedBox& b, float tolerance, float minWidth)
+{
+	const FVector axesA[3] = { a.AxisX, a.AxisY, a.AxisZ };
+	const FVector axesB[3] = { b.AxisX, b.AxisY, b.AxisZ };
+	const FVector::FReal extentsA[3] = { a.ExtentX + tolerance, a.ExtentY + tolerance, a.ExtentZ + tolerance };
+	const FVector::FReal extentsB[3] = { b.ExtentX + tolerance, b.ExtentY + tolerance, b.ExtentZ + tolerance };
+	const FVector offset = b.Center - a.Center;
+	// Separating axis test: the boxes overlap unless their shadows on one of these axes don't. Returns how much the
+	// shadows overlap, which is negative if they don't.
+	auto overlapAlong = [&](const FVector& axis)
+	{
+		FVector::FReal radiusA = 0.0;
+		FVector::FReal radiusB = 0.0;
+		for (int32 i = 0; i < 3; i++)
+		{
+			radiusA += extentsA[i] * FMath::Abs(FVector::DotProduct(axesA[i], axis));
+			radiusB += extentsB[i] * FMath::Abs(FVector::DotProduct(axesB[i], axis));
+		}
+		return FMath::Min3(radiusA + radiusB - FMath::Abs(FVector::DotProduct(offset, axis)), 2.0 * radiusA, 2.0 * radiusB);
+	};
+	// How wide the overlap is along each of the first box's axes.
+	FVector::FReal widths[3];
+	for (int32 i = 0; i < 3; i++)
+	{
+		const FVector::FReal overlap = overlapAlong(axesA[i]);
+		if (overlap < 0.0)
+		{
+			return false;
+		}
+		widths[i] = overlap;
+		if (overlapAlong(axesB[i]) < 0.0)
+		{
+			return false;
+		}
+		for (int32 j = 0; j < 3; j++)
+		{
+			const FVector axis = FVector::CrossProduct(axesA[i], axesB[j]);
+			// Parallel edges give no new axis.
+			if (axis.SizeSquared() > KINDA_SMALL_NUMBER && overlapAlong(axis.GetUnsafeNormal()) < 0.0)
+			{
+				return false;
+			}
+		}
+	}
+	// Where the boxes meet is thinnest across it. If that's up and down, one room is on top of the other, and they share
+	// a floor rather than a wall.
+	int32 thin = 0;
+	for (int32 i = 1; i < 3; i++)
+	{
+		thin = widths[i] < widths[thin] ? i : thin;
+	}
+	if (thin == 2)
+	{
+		return false;
+	}
+	// A wall is thin one way and long the other along the floor. A corner is thin both ways.
+	return widths[1 - thin] >= minWidth;
+}
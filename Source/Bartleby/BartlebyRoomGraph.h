@@ -0,0 +1,59 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/OrientedBox.h"
+
+// Which rooms connect to which, compiled into compressed sparse rows: the neighbours of room i are
+// Neighbors[Offsets[i]] up to Neighbors[Offsets[i + 1]]. Rooms are numbered by their place in the system's Rooms.
+class BARTLEBY_API FBartlebyRoomGraph
+{
+public:
+	// Builds the graph from pairs of connected rooms, which go both ways. Duplicates and rooms connected to themselves
+	// are dropped.
+	void Build(int32 numRooms, const TArray<TPair<int32, int32>>& connections);
+
+	// Gets the rooms next to the given room, in order.
+	TArrayView<const int32> GetNeighbors(int32 room) const;
+
+	// Finds the route through the fewest doors from one room to another, not counting the first room. Returns false
+	// if there isn't one. Not thread safe: it reuses scratch space.
+	bool FindRoute(int32 from, int32 to, TArray<int32>& outRoute) const;
+
+	// Number of rooms, and number of connections between them (each counted once).
+	int32 NumRooms() const { return FMath::Max(Offsets.Num() - 1, 0); }
+	int32 NumConnections() const { return Neighbors.Num() / 2; }
+
+	// True if the boxes, grown by the tolerance, overlap on a patch of wall at least minWidth wide. Rooms that only
+	// meet at a corner, or that are stacked one on top of the other, don't count.
+	static bool AreTouching(const FOrientedBox& a, const FOrientedBox& b, float tolerance, float minWidth);
+
+private:
+	TArray<int32> Offsets;
+	TArray<int32> Neighbors;
+	// Scratch space for FindRoute: how each room was reached, and the rooms to visit next.
+	mutable TArray<int32> Parents;
+	mutable TArray<int32> Frontier;
+};
@@ -0,0 +1,177 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyRoomIndex.h"
+#include "Math/VectorRegister.h"
+
+namespace
+{
+	// Most cells along one side of the grid.
+	constexpr int32 MaxCellsPerSide = 1024;
+}
+
+void FBartlebyRoomIndex::Build(const TArray<FOrientedBox>& boxes)
+{
+	Groups.Reset();
+	CellStarts.Reset();
+	NumBoxes = boxes.Num();
+	NumCellsX = 0;
+	NumCellsY = 0;
+
+	// The part of the ground each box covers.
+	TArray<FBox2D> footprints;
+	footprints.Reserve(boxes.Num());
+	FBox2D bounds(ForceInit);
+	for (const FOrientedBox& box : boxes)
+	{
+		if (box.ExtentX < 0.0f || box.ExtentY < 0.0f || box.ExtentZ < 0.0f)
+		{
+			footprints.Add(FBox2D(ForceInit));
+			continue;
+		}
+		const FVector::FReal halfX = FMath::Abs(box.AxisX.X) * box.ExtentX + FMath::Abs(box.AxisY.X) * box.ExtentY + FMath::Abs(box.AxisZ.X) * box.ExtentZ;
+		const FVector::FReal halfY = FMath::Abs(box.AxisX.Y) * box.ExtentX + FMath::Abs(box.AxisY.Y) * box.ExtentY + FMath::Abs(box.AxisZ.Y) * box.ExtentZ;
+		const FVector2D center(box.Center.X, box.Center.Y);
+		const FBox2D footprint(center - FVector2D(halfX, halfY), center + FVector2D(halfX, halfY));
+		footprints.Add(footprint);
+		bounds += footprint;
+	}
+	if (!bounds.bIsValid)
+	{
+		return;
+	}
+
+	// About one cell per box, so that a cell usually has a box or two in it.
+	const FVector2D size = bounds.GetSize();
+	const double cellSize = FMath::Max3(FMath::Sqrt(size.X * size.Y / boxes.Num()), FMath::Max(size.X, size.Y) / boxes.Num(), 1.0);
+	NumCellsX = FMath::Clamp(FMath::CeilToInt(size.X / cellSize), 1, MaxCellsPerSide);
+	NumCellsY = FMath::Clamp(FMath::CeilToInt(size.Y / cellSize), 1, MaxCellsPerSide);
+	MinX = static_cast<float>(bounds.Min.X);
+	MinY = static_cast<float>(bounds.Min.Y);
+	InvCellSize = static_cast<float>(1.0 / FMath::Max(size.X / NumCellsX, size.Y / NumCellsY));
+
+	// Boxes go into cells in order, so the first box in a cell is also the first in the list.
+	TArray<TArray<int32>> cells;
+	cells.SetNum(NumCellsX * NumCellsY);
+	for (int32 i = 0; i < boxes.Num(); i++)
+	{
+		const FBox2D& footprint = footprints[i];
+		if (!footprint.bIsValid)
+		{
+			continue;
+		}
+		const int32 x0 = FMath::Clamp(FMath::FloorToInt((footprint.Min.X - MinX) * InvCellSize), 0, NumCellsX - 1);
+		const int32 x1 = FMath::Clamp(FMath::FloorToInt((footprint.Max.X - MinX) * InvCellSize), 0, NumCellsX - 1);
+		const int32 y0 = FMath::Clamp(FMath::FloorToInt((footprint.Min.Y - MinY) * InvCellSize), 0, NumCellsY - 1);
+		const int32 y1 = FMath::Clamp(FMath::FloorToInt((footprint.Max.Y - MinY) * InvCellSize), 0, NumCellsY - 1);
+		for (int32 y = y0; y <= y1; y++)
+		{
+			for (int32 x = x0; x <= x1; x++)
+			{
+				cells[y * NumCellsX + x].Add(i);
+			}
+		}
+	}
+
+	CellStarts.Reserve(cells.Num() + 1);
+	for (const TArray<int32>& cell : cells)
+	{
+		CellStarts.Add(Groups.Num());
+		for (int32 first = 0; first < cell.Num(); first += 4)
+		{
+			FBoxGroup& group = Groups.AddZeroed_GetRef();
+			for (int32 lane = 0; lane < 4; lane++)
+			{
+				if (first + lane >= cell.Num())
+				{
+					// Nothing fits in a negative extent.
+					group.Extent[0][lane] = -1.0f;
+					group.Extent[1][lane] = -1.0f;
+					group.Extent[2][lane] = -1.0f;
+					group.Box[lane] = INDEX_NONE;
+					continue;
+				}
+				const FOrientedBox& box = boxes[cell[first + lane]];
+				const FVector axes[3] = { box.AxisX, box.AxisY, box.AxisZ };
+				group.CenterX[lane] = static_cast<float>(box.Center.X);
+				group.CenterY[lane] = static_cast<float>(box.Center.Y);
+				group.CenterZ[lane] = static_cast<float>(box.Center.Z);
+				for (int32 axis = 0; axis < 3; axis++)
+				{
+					group.Axis[axis][0][lane] = static_cast<float>(axes[axis].X);
+					group.Axis[axis][1][lane] = static_cast<float>(axes[axis].Y);
+					group.Axis[axis][2][lane] = static_cast<float>(axes[axis].Z);
+				}
+				group.Extent[0][lane] = static_cast<float>(box.ExtentX);
+				group.Extent[1][lane] = static_cast<float>(box.ExtentY);
+				group.Extent[2][lane] = static_cast<float>(box.ExtentZ);
+				group.Box[lane] = cell[first + lane];
+			}
+		}
+	}
+	CellStarts.Add(Groups.Num());
+}
+
+int32 FBartlebyRoomIndex::FindBoxAt(const FVector& point) const
+{
+	if (NumCellsX == 0)
+	{
+		return INDEX_NONE;
+	}
+	int32 x = FMath::FloorToInt((static_cast<float>(point.X) - MinX) * InvCellSize);
+	int32 y = FMath::FloorToInt((static_cast<float>(point.Y) - MinY) * InvCellSize);
+	if (x < 0 || y < 0 || x > NumCellsX || y > NumCellsY)
+	{
+		return INDEX_NONE;
+	}
+	// A point exactly on the far edge of the grid lands one past the last cell, and the boxes there are in the last one.
+	x = FMath::Min(x, NumCellsX - 1);
+	y = FMath::Min(y, NumCellsY - 1);
+	const int32 cell = y * NumCellsX + x;
+	const VectorRegister4Float pointX = VectorSetFloat1(static_cast<float>(point.X));
+	const VectorRegister4Float pointY = VectorSetFloat1(static_cast<float>(point.Y));
+	const VectorRegister4Float pointZ = VectorSetFloat1(static_cast<float>(point.Z));
+	for (int32 i = CellStarts[cell]; i < CellStarts[cell + 1]; i++)
+	{
+		const FBoxGroup& group = Groups[i];
+		const VectorRegister4Float dx = VectorSubtract(pointX, VectorLoadAligned(group.CenterX));
+		const VectorRegister4Float dy = VectorSubtract(pointY, VectorLoadAligned(group.CenterY));
+		const VectorRegister4Float dz = VectorSubtract(pointZ, VectorLoadAligned(group.CenterZ));
+		VectorRegister4Float inside[3];
+		for (int32 axis = 0; axis < 3; axis++)
+		{
+			// Distance from the center along this axis of the box.
+			VectorRegister4Float along = VectorMultiply(dx, VectorLoadAligned(group.Axis[axis][0]));
+			along = VectorMultiplyAdd(dy, VectorLoadAligned(group.Axis[axis][1]), along);
+			along = VectorMultiplyAdd(dz, VectorLoadAligned(group.Axis[axis][2]), along);
+			inside[axis] = VectorCompareLE(VectorAbs(along), VectorLoadAligned(group.Extent[axis]));
+		}
+		const int32 mask = VectorMaskBits(VectorBitwiseAnd(inside[0], VectorBitwiseAnd(inside[1], inside[2])));
+		if (mask != 0)
+		{
+			// The lanes are in the same order as the boxes.
+			return group.Box[FMath::CountTrailingZeros(static_cast<uint32>(mask))];
+		}
+	}
+	return INDEX_NONE;
+}
@@ -0,0 +1,67 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/OrientedBox.h"
+
+// Finds which room a point is in without looking at every room. The rooms' boxes are bucketed on a grid over the
+// ground, and each cell keeps the boxes that touch it four to a group, laid out so that one group is tested against
+// the point at once with vector instructions. Rotated boxes work. Build it again whenever a box moves.
+class BARTLEBY_API FBartlebyRoomIndex
+{
+public:
+	// Indexes the given boxes. Boxes with a negative extent are never hit, which is handy for rooms that went away.
+	void Build(const TArray<FOrientedBox>& boxes);
+
+	// Gets the index of the first box (in the order they were built from) containing the point, or INDEX_NONE.
+	int32 FindBoxAt(const FVector& point) const;
+
+	// Number of boxes it was built from.
+	int32 Num() const { return NumBoxes; }
+
+private:
+	// Four boxes, one per lane. The axes are the rows of the boxes' rotations, so that a dot product with the offset
+	// from the center takes the offset into the box's frame.
+	struct alignas(16) FBoxGroup
+	{
+		float CenterX[4];
+		float CenterY[4];
+		float CenterZ[4];
+		float Axis[3][3][4];
+		float Extent[3][4];
+		int32 Box[4];
+	};
+
+	// Groups for each cell, one cell after another. Cell i has the groups from CellStarts[i] up to CellStarts[i + 1].
+	TArray<FBoxGroup> Groups;
+	TArray<int32> CellStarts;
+	// Where the grid starts, how big its cells are, and how many there are along each side.
+	float MinX = 0.0f;
+	float MinY = 0.0f;
+	float InvCellSize = 0.0f;
+	int32 NumCellsX = 0;
+	int32 NumCellsY = 0;
+	int32 NumBoxes = 0;
+};
@@ -0,0 +1,103 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyStatusSnapshot.h"
+#include "Bartleby/BartlebyTrace.h"
+#include "Algo/StableSort.h"
+
+FString FBartlebyStatusSnapshot::Render(const FString& seeGuestPrompt, const FString& guestSaidPrompt) const
+{
+	BARTLEBY_TRACE_SCOPE(RenderStatus);
+	TArray<int32, TInlineAllocator<32>> order;
+	SortObjects(order);
+	FString status;
+	status.Reserve(256 + RoomDescription.Len() + guestSaidPrompt.Len() + GuestSaid.Len());
+	status += TEXT("You are in room_id=\"");
+	status += RoomId;
+	status += TEXT("\".\nroom_description=\"");
+	status += RoomDescription;
+	status += TEXT("\"\nnearby_object_ids=[");
+	for (int32 i = 0; i < order.Num(); i++)
+	{
+		status += i > 0 ? TEXT(",") : TEXT("");
+		status += ObjectIds[order[i]];
+	}
+	status += TEXT("]\nadjacent_rooms=");
+	AppendList(status, AdjacentRooms);
+	status += TEXT("\nrecent_rooms=");
+	AppendList(status, RecentRooms);
+	status += TEXT("\n");
+	status += seeGuestPrompt;
+	if (!GuestSaid.IsEmpty())
+	{
+		status += guestSaidPrompt + TEXT(" \"") + GuestSaid + TEXT("\"");
+	}
+	return status;
+}
+
+bool FBartlebyStatusSnapshot::RendersSameAs(const FBartlebyStatusSnapshot& other) const
+{
+	if (RoomId != other.RoomId || RoomDescription != other.RoomDescription || GuestSaid != other.GuestSaid ||
+		ObjectIds != other.ObjectIds || AdjacentRooms != other.AdjacentRooms || RecentRooms != other.RecentRooms)
+	{
+		return false;
+	}
+	// The same objects from somewhere else can still come out in a different order.
+	TArray<int32, TInlineAllocator<32>> order;
+	TArray<int32, TInlineAllocator<32>> otherOrder;
+	SortObjects(order);
+	other.SortObjects(otherOrder);
+	for (int32 i = 0; i < order.Num(); i++)
+	{
+		if (ObjectIds[order[i]] != other.ObjectIds[otherOrder[i]])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FBartlebyStatusSnapshot::SortObjects(TArray<int32, TInlineAllocator<32>>& outOrder) const
+{
+	outOrder.SetNumUninitialized(ObjectIds.Num());
+	for (int32 i = 0; i < outOrder.Num(); i++)
+	{
+		outOrder[i] = i;
+	}
+	// Squared distances sort the same, without the square roots. Ties keep the room's order.
+	Algo::StableSort(outOrder, [this](int32 a, int32 b)
+		{
+			return FVector::DistSquared(ObjectPositions[a], Position) < FVector::DistSquared(ObjectPositions[b], Position);
+		});
+}
+
+void FBartlebyStatusSnapshot::AppendList(FString& out, const TArray<FString>& items)
+{
+	out += TEXT("[");
+	for (int32 i = 0; i < items.Num(); i++)
+	{
+		out += i > 0 ? TEXT(",") : TEXT("");
+		out += items[i];
+	}
+	out += TEXT("]");
+}
@@ -0,0 +1,56 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Everything an AI's status is written from, copied out of the world on the game thread. It doesn't point at any actors,
+// so the status can be written on any thread, and two snapshots can be compared to tell whether they'd say the same
+// thing.
+struct BARTLEBY_API FBartlebyStatusSnapshot
+{
+	FString RoomId;
+	FString RoomDescription;
+	// Where the AI is, or will be.
+	FVector Position = FVector::ZeroVector;
+	// The objects in the room, and where each one is.
+	TArray<FString> ObjectIds;
+	TArray<FVector> ObjectPositions;
+	// Rooms a door leads to from here.
+	TArray<FString> AdjacentRooms;
+	// Rooms the AI was in lately.
+	TArray<FString> RecentRooms;
+	// What the guest said, if anything.
+	FString GuestSaid;
+
+	// Writes the status the AI sees, with the objects closest first.
+	FString Render(const FString& seeGuestPrompt, const FString& guestSaidPrompt) const;
+	// True if the other snapshot would write the same status, even if it was taken from somewhere else.
+	bool RendersSameAs(const FBartlebyStatusSnapshot& other) const;
+
+private:
+	// Gets the order to list the objects in, closest first.
+	void SortObjects(TArray<int32, TInlineAllocator<32>>& outOrder) const;
+	static void AppendList(FString& out, const TArray<FString>& items);
+};
@@ -0,0 +1,133 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebySubsystem.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+
+UBartlebySubsystem* UBartlebySubsystem::Get(const UObject* worldContext)
+{
+	const UWorld* world = worldContext ? worldContext->GetWorld() : nullptr;
+	return world ? world->GetSubsystem<UBartlebySubsystem>() : nullptr;
+}
+
+void UBartlebySubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	CastChecked<UBartlebySubsystem>(InThis)->Registry.AddReferencedObjects(Collector);
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
+void UBartlebySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UBartlebySubsystem::OnLevelAddedToWorld);
+}
+
+void UBartlebySubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	Super::Deinitialize();
+}
+
+void UBartlebySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+	// This is called before the actors begin play, so wait for the world to say they're done.
+	InWorld.OnWorldBeginPlay.AddUObject(this, &UBartlebySubsystem::OnActorsBegunPlay);
+}
+
+void UBartlebySubsystem::OnActorsBegunPlay()
+{
+	HasBegunPlay = true;
+	ResolvePending();
+}
+
+void UBartlebySubsystem::OnLevelAddedToWorld(ULevel* level, UWorld* world)
+{
+	// A streamed level's actors have all begun play by now, so there's no need to wait for the tick.
+	if (world == GetWorld() && HasBegunPlay)
+	{
+		ResolvePending();
+	}
+}
+
+void UBartlebySubsystem::ScheduleResolve()
+{
+	if (!HasBegunPlay || IsResolveScheduled)
+	{
+		return;
+	}
+	IsResolveScheduled = true;
+	GetWorld()->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &UBartlebySubsystem::ResolvePending));
+}
+
+void UBartlebySubsystem::RegisterSystem(ABartlebySystem* system)
+{
+	Registry.RegisterSystem(system);
+	ScheduleResolve();
+}
+
+void UBartlebySubsystem::UnregisterSystem(ABartlebySystem* system)
+{
+	Registry.UnregisterSystem(system);
+}
+
+void UBartlebySubsystem::RegisterRoom(ABartlebyRoom* room)
+{
+	Registry.RegisterRoom(room);
+	ScheduleResolve();
+}
+
+void UBartlebySubsystem::UnregisterRoom(ABartlebyRoom* room)
+{
+	Registry.UnregisterRoom(room);
+}
+
+void UBartlebySubsystem::RegisterObject(UBartlebyObject* object)
+{
+	Registry.RegisterObject(object);
+	ScheduleResolve();
+}
+
+void UBartlebySubsystem::UnregisterObject(UBartlebyObject* object)
+{
+	Registry.UnregisterObject(object);
+}
+
+void UBartlebySubsystem::RegisterController(ABartlebyController* controller)
+{
+	Registry.RegisterController(controller);
+	ScheduleResolve();
+}
+
+void UBartlebySubsystem::UnregisterController(ABartlebyController* controller)
+{
+	Registry.UnregisterController(controller);
+}
+
+void UBartlebySubsystem::ResolvePending()
+{
+	// Whatever is scheduled gets placed now, so a timer that fires later has nothing left to do.
+	IsResolveScheduled = false;
+	Registry.ResolvePending();
+}
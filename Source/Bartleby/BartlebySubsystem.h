@@ -0,0 +1,90 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Bartleby/BartlebyRegistry.h"
+#include "BartlebySubsystem.generated.h"
+
+class ULevel;
+
+// Keeps track of the Bartleby system, rooms, objects and controllers in a world, so that none of them has to search
+// the world for the others. Each registers itself in BeginPlay. Until everything in the level has begun play, they
+// are held, and then all placed in one pass: rooms go to the system, and objects and controllers go in the rooms they
+// start in. Whatever registers after that, like the contents of a streamed sublevel, is held until the level has been
+// added to the world or the next tick, whichever comes first, and then placed together, so the rooms are only
+// indexed once for the lot.
+UCLASS()
+class BARTLEBY_API UBartlebySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+public:
+	// Gets the subsystem of the world the given object is in, or null.
+	static UBartlebySubsystem* Get(const UObject* worldContext);
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	void RegisterSystem(ABartlebySystem* system);
+	void UnregisterSystem(ABartlebySystem* system);
+	void RegisterRoom(ABartlebyRoom* room);
+	void UnregisterRoom(ABartlebyRoom* room);
+	void RegisterObject(UBartlebyObject* object);
+	void UnregisterObject(UBartlebyObject* object);
+	void RegisterController(ABartlebyController* controller);
+	void UnregisterController(ABartlebyController* controller);
+
+	// Gets the system, or null if there isn't one yet.
+	ABartlebySystem* GetSystem() const { return Registry.GetSystem(); }
+
+	// Places everything that is waiting, if there is a system to place it with. Called once everything in the level
+	// has begun play, and after that once per batch of late registrations.
+	void ResolvePending();
+
+private:
+	// Called after every actor in the level has begun play.
+	void OnActorsBegunPlay();
+
+	// Called when a streamed level has been added to a world.
+	void OnLevelAddedToWorld(ULevel* level, UWorld* world);
+
+	// Places whatever registered late on the next tick, unless it's already been asked to.
+	void ScheduleResolve();
+
+	// The system, and everything waiting to be placed with it.
+	FBartlebyRegistry Registry;
+
+	// The handle of the LevelAddedToWorld delegate.
+	FDelegateHandle LevelAddedHandle;
+
+	// True once everything in the level has begun play, after which late registrations are placed in batches.
+	bool HasBegunPlay = false;
+
+	// True while a resolve is waiting for the next tick.
+	bool IsResolveScheduled = false;
+};
@@ -27,14 +27,34 @@ SOFTWARE.
 #include "GameFramework/Character.h"
 #include "Bartleby/BartlebyRoom.h"
 #include "Bartleby/BartlebyObject.h"
-#include "Kismet/GameplayStatics.h"
 #include "Blueprint/UserWidget.h"
 #include "HttpModule.h"
 #include "Bartleby/BartlebyInput.h"
-#include "JsonObjectConverter.h"
 #include "Interfaces/IHttpRequest.h"
 #include "Interfaces/IHttpResponse.h"
 #include "Bartleby/BartlebyController.h"
+#include "Bartleby/BartlebyResponseParser.h"
+#include "Bartleby/BartlebyCompletionCache.h"
+#include "Bartleby/BartlebyUtteranceCache.h"
+#include "Bartleby/BartlebyTokenizer.h"
+#include "Bartleby/BartlebyJsonWriter.h"
+#include "Bartleby/BartlebyConnectionManager.h"
+#include "Bartleby/BartlebyRateLimiter.h"
+#include "Bartleby/BartlebyEpisodicMemory.h"
+#include "Bartleby/BartlebyRoomIndex.h"
+#include "Bartleby/BartlebyIdIndex.h"
+#include "Bartleby/BartlebyRoomGraph.h"
+#include "Bartleby/BartlebySubsystem.h"
+#include "NavigationSystem.h"
+#include "NavigationPath.h"
+#include "Components/BoxComponent.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Bartleby/BartlebyTrace.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+
+CSV_DEFINE_CATEGORY(Bartleby, true);
 
 
 ABartlebySystem::ABartlebySystem()
@@ -46,13 +66,54 @@ ABartlebySystem::ABartlebySystem()
 void ABartlebySystem::BeginPlay()
 {
 	Super::BeginPlay();
-	// Get all the rooms.
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ABartlebyRoom::StaticClass(), FoundActors);
+	// Load the vocabulary for counting tokens. Without it, counts are only estimates.
+	Tokenizer = MakeShared<FBartlebyTokenizer>();
+	Tokenizer->LoadRanks(FPaths::ProjectContentDir() / TokenizerRanksFile);
+
+	if (UseCompletionCache)
+	{
+		CompletionCache = MakeShared<FBartlebyCompletionCache>(CompletionCacheMemoryEntries);
+		CompletionCache->Open(FPaths::ProjectSavedDir() / CompletionCacheFile);
+	}
+	if (UseUtteranceCache)
+	{
+		UtteranceCache = MakeShared<FBartlebyUtteranceCache>();
+	}
+	UpdateCacheStats();
+
+	if (Transport != EBartlebyTransport::Live)
+	{
+		Recording = MakeShared<FBartlebyCallRecording>();
+		const FString path = FPaths::ProjectSavedDir() / RecordingFile;
+		if (Transport == EBartlebyTransport::Record)
+		{
+			if (!Recording->OpenForRecording(path))
+			{
+				Recording.Reset();
+			}
+		}
+		else
+		{
+			// Without a recording every call will fail, which is still better than quietly calling the AI.
+			Recording->LoadForReplay(path);
+		}
+	}
 
-	for (AActor* actor : FoundActors)
+	// Replayed calls don't go to the server, so there's no limit to keep to.
+	if (UseRateLimiting && Transport != EBartlebyTransport::Replay)
 	{
-		Rooms.Add(Cast<ABartlebyRoom>(actor));
+		RateLimiter = MakeShared<FBartlebyRateLimiter>(RequestsPerMinute, TokensPerMinute);
+	}
+
+	// The first greeting is the call players wait on the most, so get the connection ready before it's needed. If the
+	// system is off, nothing is sent until it's turned on, and the keep-alive pings warm it from then on.
+	if (UseConnectionWarming && Transport != EBartlebyTransport::Replay)
+	{
+		ConnectionManager = MakeShared<FBartlebyConnectionManager>(URL, KeepAliveInterval);
+		if (IsEnabled)
+		{
+			ConnectionManager->Warm();
+		}
 	}
 
 	// Creat the input widget and start it hidden.
@@ -63,6 +124,59 @@ void ABartlebySystem::BeginPlay()
 		inputWidget->SetVisibility(ESlateVisibility::Hidden);
 	}
 
+	// The rooms, objects and controllers come from the subsystem, once everything has begun play.
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
+	{
+		subsystem->RegisterSystem(this);
+	}
+}
+
+void ABartlebySystem::PrepareRooms()
+{
+	// Work out where the rooms are and which connect now, rather than in the middle of the game.
+	CheckWorldChanged();
+	RebuildRoomIndex();
+	GetRoomGraph();
+}
+
+void ABartlebySystem::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UBartlebySubsystem* subsystem = UBartlebySubsystem::Get(this))
+	{
+		subsystem->UnregisterSystem(this);
+	}
+	CancelAllCalls();
+	if (CompletionCache)
+	{
+		CompletionCache->Close();
+		CompletionCache.Reset();
+	}
+	if (UtteranceCache)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%s"), *GetUtteranceCacheReport());
+		UtteranceCache.Reset();
+	}
+	if (Telemetry.GetNumRecorded() != NumRecordedAtLastDump)
+	{
+		DumpTelemetry();
+	}
+	if (Recording)
+	{
+		if (Transport == EBartlebyTransport::Replay)
+		{
+			UE_LOG(LogTemp, Display, TEXT("Replayed %d of %d recorded calls: %d matched, %d out of order, %d unanswered."),
+				Recording->GetNumExactMatches() + Recording->GetNumFallbacks(), Recording->GetNumLoaded(),
+				Recording->GetNumExactMatches(), Recording->GetNumFallbacks(), Recording->GetNumMisses());
+		}
+		Recording->Close();
+		Recording.Reset();
+	}
+	if (ConnectionManager)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Connection reuse: %d warm, %d cold (%.0f%%)."), WarmRequests, ColdRequests, ConnectionReuseRatio * 100.0f);
+		ConnectionManager.Reset();
+	}
+	Super::EndPlay(EndPlayReason);
 }
 
 void ABartlebySystem::CollectInput()
@@ -87,7 +201,9 @@ void ABartlebySystem::CollectInput()
 // Called every frame.
 void ABartlebySystem::Tick(float DeltaTime)
 {
+	BARTLEBY_TRACE_SCOPE(Tick);
 	Super::Tick(DeltaTime);
+	CheckWorldChanged();
 
 	// If we're waiting on input, try to get the text that was said.
 	if (IsWaitingOnInput)
@@ -117,57 +233,391 @@ void ABartlebySystem::Tick(float DeltaTime)
 		}
 	}
 
+	// Build what was asked for last frame, send off anything that was waiting for a free slot, and keep an eye on what's
+	// already out.
+	BuildPendingCalls();
+	PumpScheduler();
+	CheckDeadlines(FPlatformTime::Seconds());
+
+	if (ConnectionManager && IsEnabled)
+	{
+		ConnectionManager->Tick(FPlatformTime::Seconds());
+		UpdateConnectionStats();
+	}
+	if (RateLimiter)
+	{
+		RemainingRequests = RateLimiter->GetRemainingRequests();
+		RemainingTokens = RateLimiter->GetRemainingTokens();
+	}
+	// Whatever was remembered this frame is written out in one go, off the game thread.
+	for (ABartlebyController* controller : Controllers)
+	{
+		if (controller && controller->EpisodicMemory)
+		{
+			controller->EpisodicMemory->Flush();
+		}
+	}
+	if (Recording)
+	{
+		NumRecordedCalls = Recording->GetNumRecorded();
+		NumReplayedCalls = Recording->GetNumExactMatches() + Recording->GetNumFallbacks();
+		NumReplayFallbacks = Recording->GetNumFallbacks();
+	}
+
+	CSV_CUSTOM_STAT(Bartleby, QueuedRequests, NumQueuedRequests, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Bartleby, InFlightRequests, NumInFlightRequests, ECsvCustomStatOp::Set);
+	TRACE_COUNTER_SET(BartlebyQueuedRequests, NumQueuedRequests);
+	TRACE_COUNTER_SET(BartlebyInFlightRequests, NumInFlightRequests);
+#if COUNTERSTRACE_ENABLED
+	int32 numWaiting = 0;
+	for (const ABartlebyController* controller : Controllers)
+	{
+		numWaiting += controller && controller->IsWaitingOnOpenAI ? 1 : 0;
+	}
+	TRACE_COUNTER_SET(BartlebyWaitingControllers, numWaiting);
+#endif
+	const double now = FPlatformTime::Seconds();
+	if (TelemetryDumpInterval > 0.0f && now >= NextTelemetryDumpTime)
+	{
+		// Only bother writing it out if something happened since last time.
+		if (Telemetry.GetNumRecorded() != NumRecordedAtLastDump)
+		{
+			DumpTelemetry();
+		}
+		NextTelemetryDumpTime = now + TelemetryDumpInterval;
+	}
 }
 
 
 ABartlebyRoom* ABartlebySystem::GetRoomOrNull(const FString& id)
 {
-	// Use lower case.
-	FString lower = id.ToLower();
+	float confidence = 0.0f;
+	return FindRoomOrNull(id, confidence);
+}
+
+ABartlebyRoom* ABartlebySystem::FindRoomOrNull(const FString& id, float& confidence)
+{
+	BARTLEBY_TRACE_SCOPE(GetRoomOrNull);
+	// Rooms is public, so it may have changed behind our back. A change in number is caught right away, anything else
+	// after the next tick.
+	if (!RoomIdIndex || RoomIdIndexRevision != WorldRevision || RoomIdIndex->Num() != Rooms.Num())
+	{
+		TArray<FString> ids;
+		ids.Reserve(Rooms.Num());
+		for (const ABartlebyRoom* room : Rooms)
+		{
+			ids.Add(room ? room->Id : FString());
+		}
+		RoomIdIndex = MakeShared<FBartlebyIdIndex>();
+		RoomIdIndex->Build(ids);
+		RoomIdIndexRevision = WorldRevision;
+	}
+	// The AI sometimes abbreviates room names, so the closest one will do.
+	const int32 index = RoomIdIndex->Find(id, MinIdConfidence, confidence);
+	return index == INDEX_NONE ? nullptr : Rooms[index];
+}
+
+void ABartlebySystem::InvalidateIdIndex()
+{
+	RoomIdIndex.Reset();
 	for (ABartlebyRoom* room : Rooms)
 	{
-		// The AI sometimes abbreviates room names, so abbreviations are valid?
-		if (room && room->Id == id || room->Id.ToLower().Contains(lower))
+		if (room)
 		{
-			return room;
+			room->InvalidateObjectIndex();
 		}
 	}
-	return nullptr;
 }
 
 
 TArray<FDoor> ABartlebySystem::GetDoorsAt(const FString& roomId)
 {
 	TArray<FDoor> out;
-	// Any door connecting this room to another will be added.
+	GetRoomGraph();
+	const int32* room = RoomNumbersById.Find(roomId);
+	if (!room)
+	{
+		return out;
+	}
+	// Any door connecting this room to another will be added, as it was placed.
+	for (int32 i = DoorStarts[*room]; i < DoorStarts[*room + 1]; i++)
+	{
+		out.Add(GraphDoors[DoorsByRoom[i]]);
+	}
+	return out;
+}
+
+void ABartlebySystem::InvalidateRoomGraph()
+{
+	RoomGraph.Reset();
+}
+
+bool ABartlebySystem::FindRoute(ABartlebyRoom* from, ABartlebyRoom* to, TArray<ABartlebyRoom*>& route)
+{
+	route.Reset();
+	const FBartlebyRoomGraph& graph = GetRoomGraph();
+	TArray<int32> rooms;
+	if (!graph.FindRoute(GetRoomNumber(from), GetRoomNumber(to), rooms))
+	{
+		return false;
+	}
+	for (const int32 room : rooms)
+	{
+		route.Add(Rooms[room]);
+	}
+	return true;
+}
+
+int32 ABartlebySystem::GetRoomNumber(const ABartlebyRoom* room)
+{
+	GetRoomGraph();
+	const int32* number = RoomNumbers.Find(room);
+	return number ? *number : INDEX_NONE;
+}
+
+const FBartlebyRoomGraph& ABartlebySystem::GetRoomGraph()
+{
+	// Rooms and Doors are public, so they may have changed behind our back. A change in number is caught right away,
+	// anything else after the next tick.
+	if (RoomGraph && RoomGraphRevision == WorldRevision && RoomGraphRooms == Rooms.Num() && RoomGraphDoors == Doors.Num())
+	{
+		return *RoomGraph;
+	}
+	BARTLEBY_TRACE_SCOPE(BuildRoomGraph);
+	RoomGraphRevision = WorldRevision;
+	RoomGraphRooms = Rooms.Num();
+	RoomGraphDoors = Doors.Num();
+	RoomNumbers.Reset();
+	RoomNumbersById.Reset();
+	for (int32 i = 0; i < Rooms.Num(); i++)
+	{
+		if (Rooms[i])
+		{
+			RoomNumbers.Add(Rooms[i], i);
+			if (!RoomNumbersById.Contains(Rooms[i]->Id))
+			{
+				RoomNumbersById.Add(Rooms[i]->Id, i);
+			}
+		}
+	}
+	TArray<TPair<int32, int32>> connections;
 	for (const FDoor& door : Doors)
 	{
-		if (door.Room1 == roomId || door.Room2 == roomId)
+		const int32* room1 = RoomNumbersById.Find(door.Room1);
+		const int32* room2 = RoomNumbersById.Find(door.Room2);
+		if (room1 && room2)
+		{
+			connections.Emplace(*room1, *room2);
+		}
+		else
 		{
-			out.Add(door);
+			UE_LOG(LogTemp, Warning, TEXT("Door from %s to %s doesn't connect two rooms."), *door.Room1, *door.Room2);
+		}
+	}
+	const int32 numManual = connections.Num();
+	if (UseAutoDoors)
+	{
+		FindAutoDoors(connections);
+	}
+	BuildDoorIndex(connections, numManual);
+	RoomGraph = MakeShared<FBartlebyRoomGraph>();
+	RoomGraph->Build(Rooms.Num(), connections);
+	NumRoomGraphBuilds++;
+	NumDoors = RoomGraph->NumConnections();
+	UE_LOG(LogTemp, Display, TEXT("Bartleby found %d doors between %d rooms (%d placed by hand, %d found touching)."),
+		NumDoors, Rooms.Num(), numManual, connections.Num() - numManual);
+	return *RoomGraph;
+}
+
+void ABartlebySystem::BuildDoorIndex(const TArray<TPair<int32, int32>>& connections, int32 numPlaced)
+{
+	GraphDoors.Reset();
+	// The room each door is listed at, and the door.
+	TArray<TPair<int32, int32>> listings;
+	// Doors placed by hand are listed as they are, at whichever of their rooms exist.
+	for (const FDoor& door : Doors)
+	{
+		const int32* room1 = RoomNumbersById.Find(door.Room1);
+		const int32* room2 = RoomNumbersById.Find(door.Room2);
+		if (!room1 && !room2)
+		{
+			continue;
+		}
+		const int32 index = GraphDoors.Add(door);
+		if (room1)
+		{
+			listings.Emplace(*room1, index);
+		}
+		if (room2 && (!room1 || *room2 != *room1))
+		{
+			listings.Emplace(*room2, index);
+		}
+	}
+	// Doors that were found get made up, unless one placed by hand already joins the same rooms.
+	TSet<TPair<int32, int32>> placed;
+	for (int32 i = 0; i < numPlaced; i++)
+	{
+		const int32 room1 = connections[i].Key;
+		const int32 room2 = connections[i].Value;
+		placed.Add(TPair<int32, int32>(FMath::Min(room1, room2), FMath::Max(room1, room2)));
+	}
+	for (int32 i = numPlaced; i < connections.Num(); i++)
+	{
+		const int32 room1 = connections[i].Key;
+		const int32 room2 = connections[i].Value;
+		if (placed.Contains(TPair<int32, int32>(FMath::Min(room1, room2), FMath::Max(room1, room2))))
+		{
+			continue;
+		}
+		const int32 index = GraphDoors.AddDefaulted();
+		GraphDoors[index].Room1 = Rooms[room1]->Id;
+		GraphDoors[index].Room2 = Rooms[room2]->Id;
+		listings.Emplace(room1, index);
+		listings.Emplace(room2, index);
+	}
+	// Group them by room, keeping their order.
+	DoorStarts.Init(0, Rooms.Num() + 1);
+	for (const TPair<int32, int32>& listing : listings)
+	{
+		DoorStarts[listing.Key + 1]++;
+	}
+	for (int32 i = 0; i < Rooms.Num(); i++)
+	{
+		DoorStarts[i + 1] += DoorStarts[i];
+	}
+	TArray<int32> next(DoorStarts.GetData(), Rooms.Num());
+	DoorsByRoom.SetNumUninitialized(listings.Num());
+	for (const TPair<int32, int32>& listing : listings)
+	{
+		DoorsByRoom[next[listing.Key]++] = listing.Value;
+	}
+}
+
+void ABartlebySystem::FindAutoDoors(TArray<TPair<int32, int32>>& outDoors)
+{
+	BARTLEBY_TRACE_SCOPE(FindAutoDoors);
+	struct FCandidate
+	{
+		int32 Room;
+		FBox Bounds;
+	};
+	TArray<FCandidate> candidates;
+	TArray<FOrientedBox> boxes;
+	boxes.SetNum(Rooms.Num());
+	for (int32 i = 0; i < Rooms.Num(); i++)
+	{
+		if (Rooms[i] && Rooms[i]->Box)
+		{
+			boxes[i] = Rooms[i]->GetOrientedBox();
+			candidates.Add({ i, Rooms[i]->Box->Bounds.GetBox().ExpandBy(AutoDoorGap * 0.5f) });
+		}
+	}
+	UNavigationSystemV1* navigation = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (navigation && !navigation->GetDefaultNavDataInstance(FNavigationSystem::DontCreate))
+	{
+		navigation = nullptr;
+	}
+	// Sweep along X, so that only rooms whose bounds overlap on X get a closer look.
+	candidates.Sort([](const FCandidate& a, const FCandidate& b) { return a.Bounds.Min.X < b.Bounds.Min.X; });
+	for (int32 i = 0; i < candidates.Num(); i++)
+	{
+		for (int32 j = i + 1; j < candidates.Num() && candidates[j].Bounds.Min.X <= candidates[i].Bounds.Max.X; j++)
+		{
+			const int32 room1 = candidates[i].Room;
+			const int32 room2 = candidates[j].Room;
+			if (!candidates[i].Bounds.Intersect(candidates[j].Bounds) ||
+				!FBartlebyRoomGraph::AreTouching(boxes[room1], boxes[room2], AutoDoorGap * 0.5f, AutoDoorMinWidth))
+			{
+				continue;
+			}
+			if (navigation && AutoDoorMaxDetour > 0.0f)
+			{
+				// The walk from the middle of one room to the middle of the other shouldn't have to go the long way around.
+				FNavLocation start;
+				FNavLocation end;
+				const FOrientedBox& box1 = boxes[room1];
+				const FOrientedBox& box2 = boxes[room2];
+				if (!navigation->ProjectPointToNavigation(box1.Center, start, FVector(box1.ExtentX, box1.ExtentY, box1.ExtentZ)) ||
+					!navigation->ProjectPointToNavigation(box2.Center, end, FVector(box2.ExtentX, box2.ExtentY, box2.ExtentZ)))
+				{
+					continue;
+				}
+				const UNavigationPath* path = navigation->FindPathToLocationSynchronously(GetWorld(), start.Location, end.Location);
+				if (!path || !path->IsValid() || path->IsPartial() ||
+					path->GetPathLength() > AutoDoorMaxDetour * FVector::Dist(start.Location, end.Location))
+				{
+					continue;
+				}
+			}
+			outDoors.Emplace(room1, room2);
 		}
 	}
-	return out;
 }
 
 
 ABartlebyRoom* ABartlebySystem::GetRoomAtOrNull(const FVector& pos)
 {
+	BARTLEBY_TRACE_SCOPE(GetRoomAtOrNull);
+	// Rooms is public, so it may have changed behind our back. A change in number is caught right away, anything else
+	// after the next tick.
+	if (!RoomIndex || IsRoomIndexDirty || RoomIndexRevision != WorldRevision || RoomIndex->Num() != Rooms.Num())
+	{
+		RebuildRoomIndex();
+	}
 	// Get the first room containing this position.
+	const int32 index = RoomIndex->FindBoxAt(pos);
+	return index == INDEX_NONE ? nullptr : Rooms[index];
+}
+
+void ABartlebySystem::InvalidateRoomIndex()
+{
+	IsRoomIndexDirty = true;
+}
+
+void ABartlebySystem::RebuildRoomIndex()
+{
+	BARTLEBY_TRACE_SCOPE(RebuildRoomIndex);
+	TArray<FOrientedBox> boxes;
+	boxes.Reserve(Rooms.Num());
 	for (ABartlebyRoom* room : Rooms)
 	{
-		if (room->IsInside(pos))
+		if (!room || !room->Box)
+		{
+			// Keeps the indices lined up with Rooms, but is never hit.
+			FOrientedBox& box = boxes.AddDefaulted_GetRef();
+			box.ExtentX = box.ExtentY = box.ExtentZ = -1.0f;
+			continue;
+		}
+		boxes.Add(room->GetOrientedBox());
+		if (!room->Box->TransformUpdated.IsBoundToObject(this))
 		{
-			return room;
+			room->Box->TransformUpdated.AddUObject(this, &ABartlebySystem::OnRoomMoved);
 		}
 	}
-	return nullptr;
+	if (!RoomIndex)
+	{
+		RoomIndex = MakeShared<FBartlebyRoomIndex>();
+	}
+	RoomIndex->Build(boxes);
+	IsRoomIndexDirty = false;
+	RoomIndexRevision = WorldRevision;
+}
+
+void ABartlebySystem::OnRoomMoved(USceneComponent* component, EUpdateTransformFlags flags, ETeleportType teleport)
+{
+	IsRoomIndexDirty = true;
 }
 
 void ABartlebySystem::Say(AActor* actor, const FString& title, const FString& text)
 {
 	// Implement in your game.
 	UE_LOG(LogTemp, Display, TEXT("Implement this part in your game."));
+	// Remember who is talking, so that the answer goes to them.
+	APawn* pawn = Cast<APawn>(actor);
+	if (pawn)
+	{
+		InputController = Cast<ABartlebyController>(pawn->GetController());
+	}
 	OnSay(actor, title, text);
 	OnSayCompleted();
 }
@@ -188,72 +638,25 @@ TArray<UBartlebyObject*> ABartlebySystem::GetObjectsAt(const FString& roomId)
 	return room->Objects;
 }
 
-FString ABartlebySystem::GenerateYouSeeString()
-{
-	if (!Controller)
-	{
-		UE_LOG(LogTemp, Error, TEXT("NO controller"));
-		return "";
-	}
-	// Get any nearby objects.
-	TArray<UBartlebyObject*> objects = GetObjectsAt(Controller->CurrentRoom->Id);
-	FVector pos = Controller->GetCharacter()->GetActorLocation();
-	// Sort the objects by distance to the AI.
-	Algo::Sort(objects, [&pos](const UBartlebyObject* a, const UBartlebyObject* b)
-		{
-			return FVector::Dist(a->GetOwner()->GetActorLocation(), pos) < FVector::Dist(b->GetOwner()->GetActorLocation(), pos);
-		});
-	// No objects, empty list.
-	if (objects.Num() == 0)
-	{
-		return "[]";
-	}
-
-	//  Make a formatted list of objects.
-	FString S = "[";
-	for (int32 i = 0; i < objects.Num(); i++)
-	{
-		S += objects[i]->Id;
-		if (i < objects.Num() - 1)
-		{
-			S += ",";
-		}
-	}
-	S += "]";
-	return S;
-	
-}
-
-FString ABartlebySystem::GenerateDoorsString()
+FString ABartlebySystem::GenerateDoorsString(const FString& roomId)
 {
-	if (!Controller)
-	{
-		UE_LOG(LogTemp, Error, TEXT("NO controller"));
-		return "";
-	}
-	// Get all the doors as a list.
-	const auto& roomId = Controller->CurrentRoom->Id;
-	auto doors = GetDoorsAt(roomId);
+	BARTLEBY_TRACE_SCOPE(GenerateDoorsStringRoom);
+	const FBartlebyRoomGraph& graph = GetRoomGraph();
+	const int32* room = RoomNumbersById.Find(roomId);
 
 	// No doors, empty list.
-	if (doors.Num() == 0)
+	if (!room)
 	{
 		return "[]";
 	}
 
 	// Formatted list of doors.
+	TArrayView<const int32> neighbors = graph.GetNeighbors(*room);
 	FString S = "[";
-	for (int32 i = 0; i < doors.Num(); i++)
+	for (int32 i = 0; i < neighbors.Num(); i++)
 	{
-		if (doors[i].Room1 == roomId)
-		{
-			S += doors[i].Room2;
-		}
-		else
-		{
-			S += doors[i].Room1;
-		}
-		if (i < doors.Num() - 1)
+		S += Rooms[neighbors[i]]->Id;
+		if (i < neighbors.Num() - 1)
 		{
 			S += ",";
 		}
@@ -262,65 +665,88 @@ FString ABartlebySystem::GenerateDoorsString()
 	return S;
 }
 
-FString ABartlebySystem::GenerateRecentPlacesString()
+FBartlebyStatusSnapshot ABartlebySystem::CaptureStatus(ABartlebyController* controller)
 {
-	if (!Controller)
+	// A controller that lost its pawn is nowhere, so there's nothing to say about where it is.
+	const ACharacter* character = controller->GetCharacter();
+	if (!character)
 	{
-		UE_LOG(LogTemp, Error, TEXT("NO controller"));
-		return "";
+		return FBartlebyStatusSnapshot();
 	}
-	// Get the list of recent places, make an empty or formatted list of them.
-	auto places = Controller->RecentPlaces;
-	if (places.Num() == 0)
+	return CaptureStatus(controller, character->GetActorLocation());
+}
+
+FBartlebyStatusSnapshot ABartlebySystem::CaptureStatus(ABartlebyController* controller, const FVector& pos)
+{
+	BARTLEBY_TRACE_SCOPE(CaptureStatus);
+	FBartlebyStatusSnapshot snapshot;
+	snapshot.Position = pos;
+	snapshot.RecentRooms = controller->RecentPlaces;
+	snapshot.GuestSaid = GetGuestSaid(controller);
+	const ABartlebyRoom* room = controller->CurrentRoom;
+	if (!room)
 	{
-		return "[]";
+		UE_LOG(LogTemp, Error, TEXT("NO room"));
+		return snapshot;
 	}
-
-	FString S = "[";
-	for (int32 i = 0; i < places.Num(); i++)
+	snapshot.RoomId = room->Id;
+	snapshot.RoomDescription = room->Description;
+	// Only copy where things are. Sorting them and writing them out is left for whoever renders the status.
+	snapshot.ObjectIds.Reserve(room->Objects.Num());
+	snapshot.ObjectPositions.Reserve(room->Objects.Num());
+	for (const UBartlebyObject* object : room->Objects)
 	{
-		S += places[i];
-		if (i < places.Num() - 1)
+		// Objects that were destroyed, or came off their actor, can still be in the room until it's told.
+		const AActor* owner = IsValid(object) ? object->GetOwner() : nullptr;
+		if (!IsValid(owner))
 		{
-			S += ",";
+			continue;
 		}
+		snapshot.ObjectIds.Add(object->Id);
+		snapshot.ObjectPositions.Add(owner->GetActorLocation());
 	}
-	S += "]";
-	return S;
+	const FBartlebyRoomGraph& graph = GetRoomGraph();
+	for (const int32 neighbor : graph.GetNeighbors(GetRoomNumber(room)))
+	{
+		snapshot.AdjacentRooms.Add(Rooms[neighbor]->Id);
+	}
+	return snapshot;
 }
 
-FString ABartlebySystem::GenerateStatusString()
+ABartlebySystem::BartlebyPromptSettings ABartlebySystem::MakePromptSettings() const
 {
-	if (!Controller)
-	{
-		UE_LOG(LogTemp, Error, TEXT("NO controller"));
-		return "";
-	}
-	FString guestString;
-	if (LastThingPlayerSaid != "")
-	{
-		guestString = GuestSaidPrompt + " \"" + LastThingPlayerSaid + "\"";
-	}
-	// Big ol' concatenation.
-	return "You are in room_id=\"" + Controller->CurrentRoom->Id + "\"."
-		"\nroom_description=\"" + Controller->CurrentRoom->Description + "\""
-		"\nnearby_object_ids=" + GenerateYouSeeString() +
-		"\nadjacent_rooms=" + GenerateDoorsString() +
-		"\nrecent_rooms=" + GenerateRecentPlacesString() + 
-		"\n" + SeeGuestPrompt + guestString;
+	BartlebyPromptSettings settings;
+	settings.GroundingPrompt = GroundingPrompt;
+	settings.HelpPrompt = HelpPrompt;
+	settings.SeeGuestPrompt = SeeGuestPrompt;
+	settings.GuestSaidPrompt = GuestSaidPrompt;
+	settings.Model = Model;
+	settings.Temperature = Temperature;
+	settings.UseStablePrefix = UseStablePrefix;
+	settings.MaxPromptTokens = MaxPromptTokens;
+	settings.MaxNumLogElements = MaxNumLogElements;
+	settings.LogEvictionChunk = LogEvictionChunk;
+	settings.KeepForgotten = UseMemorySummary;
+	settings.ExpectedCompletionTokens = ExpectedCompletionTokens;
+	settings.BodySizeHint = BodySizeHint;
+	settings.Tokenizer = Tokenizer;
+	return settings;
 }
 
-FString ABartlebySystem::GeneratePrompt(bool askForHelp)
+FString ABartlebySystem::GeneratePrompt(const BartlebyPromptSettings& settings, bool askForHelp, const FString& status)
 {
+	BARTLEBY_TRACE_SCOPE(GeneratePrompt);
 	FString helpString;
 	if (askForHelp)
 	{
-		helpString = GenerateHelpString() + "\n";
+		helpString = settings.HelpPrompt + "\n";
 	}
+	// With a stable prefix, the grounding prompt is already at the very front of every request.
+	FString groundingString = settings.UseStablePrefix ? FString() : settings.GroundingPrompt;
 	// Big ol' concatenation.
-	return GroundingPrompt +
+	return groundingString +
 		helpString +
-		"STATUS:\n" + GenerateStatusString() + "\n" +
+		"STATUS:\n" + status + "\n" +
 		"Enter exactly one action now:\n"; // This is super important for making the AI actually emit just one action.
 }
 
@@ -329,179 +755,1648 @@ FString ABartlebySystem::GenerateHelpString()
 	return HelpPrompt;
 }
 
-void ABartlebySystem::StartOpenAICall()
+FString ABartlebySystem::GenerateWorldSummaryString()
 {
-	if (!IsEnabled)
+	BARTLEBY_TRACE_SCOPE(GenerateWorldSummaryString);
+	// Only rebuild the summary when the world changed. Rooms and doors hardly ever change once the game starts.
+	const uint32 signature = GetWorldSummarySignature();
+	if (!WorldSummary.IsEmpty() && signature == WorldSummarySignature)
 	{
-		return;
+		return WorldSummary;
+	}
+	WorldSummarySignature = signature;
+	// List every room, and the rooms that can be reached from it.
+	WorldSummary = "MAP:\n";
+	for (ABartlebyRoom* room : Rooms)
+	{
+		if (room)
+		{
+			WorldSummary += room->Id + " -> " + GenerateDoorsString(room->Id) + "\n";
+		}
 	}
+	return WorldSummary;
+}
 
-	// Set up our HTTP request.
-	FHttpModule& httpModule = FHttpModule::Get();
-	FHttpRequestRef request = httpModule.CreateRequest();
-	request->SetURL(URL);
-	request->SetVerb(TEXT("POST"));
-	request->SetHeader(TEXT("Content-type"), TEXT("application/json"));
-	request->SetHeader(TEXT("Authorization"), TEXT("Bearer " + OpenAiKey));
-	// Create a new JSON object
-	TSharedPtr<FJsonObject> JsonObject = MakeShareable(new FJsonObject);
+uint32 ABartlebySystem::GetWorldSummarySignature()
+{
+	// The map is written from the room graph, which can also be rebuilt on its own, e.g. by InvalidateRoomGraph.
+	GetRoomGraph();
+	return HashCombine(GetTypeHash(WorldRevision), GetTypeHash(NumRoomGraphBuilds));
+}
 
-	// Add the model name, messages, and temperature to the object
-	JsonObject->SetStringField(TEXT("model"), Model);
+void ABartlebySystem::InvalidateWorldSummary()
+{
+	WorldSummary.Empty();
+	NumHelpTokens = -1;
+}
 
-	LastFullPrompt = "";
-	if (!appendedMsg.IsEmpty())
+uint32 ABartlebySystem::ComputeWorldSignature() const
+{
+	BARTLEBY_TRACE_SCOPE(ComputeWorldSignature);
+	uint32 signature = GetTypeHash(Rooms.Num());
+	for (const ABartlebyRoom* room : Rooms)
 	{
-		AddLog(appendedMsg);
-		LastFullPrompt += appendedMsg + "\n";
-		appendedMsg = "";
+		signature = HashCombine(signature, GetTypeHash(room));
+		if (room)
+		{
+			signature = HashCombine(signature, GetTypeHash(room->Id));
+		}
 	}
-	FString nextPrompt = GeneratePrompt(false);
-	LastFullPrompt += nextPrompt;
-	AddLog(nextPrompt);
-	NeedsHelpString = false; // TODO, when the AI fails, give it another help string?
-	TArray<TSharedPtr<FJsonValue>> MessagesArray;
-	// Construct the messages array.
+	signature = HashCombine(signature, GetTypeHash(Doors.Num()));
+	for (const FDoor& door : Doors)
 	{
-		// Always generate the help string.
-		TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
-		MessageObject->SetStringField(TEXT("role"), TEXT("user"));
-		MessageObject->SetStringField(TEXT("content"), GenerateHelpString());
-		MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
+		signature = HashCombine(signature, HashCombine(GetTypeHash(door.Room1), GetTypeHash(door.Room2)));
+		signature = HashCombine(signature, GetTypeHash(door.Description));
 	}
-	// Add a bunch of messages.
-	for (const auto& log_element : Log)
+	return signature;
+}
+
+void ABartlebySystem::CheckWorldChanged()
+{
+	const uint32 signature = ComputeWorldSignature();
+	if (signature != WorldSignature)
 	{
-		TSharedPtr<FJsonObject> MessageObject = MakeShareable(new FJsonObject);
-		if (log_element.Type == BartlebyLogType::Prompt)
-		{
-			MessageObject->SetStringField(TEXT("role"), TEXT("user"));
-		}
-		else
-		{
-			MessageObject->SetStringField(TEXT("role"), TEXT("assistant"));
-		}
-		MessageObject->SetStringField(TEXT("content"), log_element.Content);
-		MessagesArray.Add(MakeShareable(new FJsonValueObject(MessageObject)));
+		WorldSignature = signature;
+		WorldRevision++;
 	}
-	JsonObject->SetArrayField(TEXT("messages"), MessagesArray);
-
-	JsonObject->SetNumberField(TEXT("temperature"), Temperature);
+}
 
-	// Convert the JSON object to a string.
-	FString JsonString;
-	TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<>::Create(&JsonString);
-	FJsonSerializer::Serialize(JsonObject.ToSharedRef(), JsonWriter);
-	request->SetContentAsString(JsonString);
-	IsWaitingOnOpenAI = true;
-	auto completionCallback = [&](
-		FHttpRequestPtr pRequest,
-		FHttpResponsePtr pResponse,
-		bool connectedSuccessfully)
+FString ABartlebySystem::GenerateFirstMessage()
+{
+	BARTLEBY_TRACE_SCOPE(GenerateFirstMessage);
+	if (!UseStablePrefix)
 	{
-		IsWaitingOnOpenAI = false;
-		if (connectedSuccessfully) {
-
-			// We should have a JSON response - attempt to process it.
-			IsWaitingOnOpenAI = false;
-			// Validate http called us back on the Game Thread...
-			check(IsInGameThread());
-			UE_LOG(LogTemp, Display, TEXT("%s"), *(pResponse->GetContentAsString()));
-			TSharedRef<TJsonReader<TCHAR>> JsonReader = 
-				TJsonReaderFactory<TCHAR>::Create(pResponse->GetContentAsString());
-			TSharedPtr<FJsonObject> jsonObject;
-			bool wasParsingError = false;
-			// Deserialize the json into an object.
-			if (FJsonSerializer::Deserialize(JsonReader, jsonObject))
-			{
-				// If that was successful..
-				if (jsonObject)
-				{
-					// AI should have generated a list of "choices". We just want the first one.
-					if (jsonObject->HasField("choices"))
+		return GenerateHelpString();
+	}
+	// Everything here changes rarely if ever, so it makes a long prefix that is the same from request to request.
+	return GroundingPrompt + GenerateHelpString() + "\n" + GenerateWorldSummaryString();
+}
+
+void ABartlebySystem::RegisterController(ABartlebyController* controller)
+{
+	if (controller && !Controllers.Contains(controller))
+	{
+		Controllers.Add(controller);
+		if (UseEpisodicMemory && !controller->EpisodicMemory)
+		{
+			// The pawn's name stays the same from session to session, unlike the controller's.
+			const FString name = controller->GetPawn() ? controller->GetPawn()->GetName() : controller->GetName();
+			controller->EpisodicMemory = MakeShared<FBartlebyEpisodicMemory>();
+			controller->EpisodicMemory->Open(FPaths::ProjectSavedDir() / EpisodicMemoryDirectory / name + TEXT(".bin"));
+		}
+	}
+}
+
+void ABartlebySystem::UnregisterController(ABartlebyController* controller)
+{
+	Controllers.Remove(controller);
+	// Anything this controller was waiting on is no longer needed.
+	for (int32 i = PendingCalls.Num() - 1; i >= 0; i--)
+	{
+		if (PendingCalls[i]->Controller == controller)
+		{
+			PendingCalls.RemoveAt(i);
+		}
+	}
+	if (controller && controller->PrefetchCall)
+	{
+		CancelCall(controller->PrefetchCall.ToSharedRef());
+		controller->PrefetchCall.Reset();
+	}
+	// Its answers would land in a queue nobody drains, so give up on them now and free their slots.
+	TArray<TSharedRef<BartlebyCall>> inFlight = InFlightCalls;
+	for (const TSharedRef<BartlebyCall>& call : inFlight)
+	{
+		if (call->Controller == controller)
+		{
+			CancelCall(call);
+			FinishCall(call);
+		}
+	}
+	if (InputController == controller)
+	{
+		InputController = nullptr;
+	}
+	if (controller)
+	{
+		controller->EpisodicMemory.Reset();
+	}
+}
+
+void ABartlebySystem::StartOpenAICall(ABartlebyController* controller)
+{
+	BARTLEBY_TRACE_SCOPE(StartOpenAICall);
+	if (!IsEnabled || !controller)
+	{
+		return;
+	}
+
+	StartOpenAICall(controller, CaptureStatus(controller));
+}
+
+void ABartlebySystem::StartOpenAICall(ABartlebyController* controller, FBartlebyStatusSnapshot&& snapshot)
+{
+	// If we guessed right about what things would look like by now, we may already have (or be getting) the answer.
+	if (controller->PrefetchCall)
+	{
+		TSharedRef<BartlebyCall> call = controller->PrefetchCall.ToSharedRef();
+		controller->PrefetchCall.Reset();
+		if (call->Snapshot.RendersSameAs(snapshot) && call->Appended == controller->AppendedMsg && call->BaseLogRevision == controller->LogRevision)
+		{
+			PrefetchHits++;
+			call->IsSpeculative = false;
+			// A guess that's still being built gets committed once it is.
+			if (!call->IsBuilt)
+			{
+				controller->IsWaitingOnOpenAI = true;
+				return;
+			}
+			CommitCall(call);
+			if (call->IsComplete)
+			{
+				DispatchAction(controller, call->Result);
+			}
+			else
+			{
+				controller->IsWaitingOnOpenAI = true;
+			}
+			return;
+		}
+		PrefetchMisses++;
+		CancelCall(call);
+	}
+
+	TSharedRef<BartlebyCall> call = MakeCall(controller, controller->AppendedMsg, MoveTemp(snapshot));
+	controller->IsWaitingOnOpenAI = true;
+	QueueBuild(call);
+}
+
+void ABartlebySystem::PrefetchOpenAICall(ABartlebyController* controller, const FVector& arrivalPos, const FString& arrivalMsg)
+{
+	BARTLEBY_TRACE_SCOPE(PrefetchOpenAICall);
+	if (!IsEnabled || !UsePrefetch || !controller || !controller->CurrentRoom || controller->IsWaitingOnOpenAI)
+	{
+		return;
+	}
+	if (controller->PrefetchCall)
+	{
+		CancelCall(controller->PrefetchCall.ToSharedRef());
+		controller->PrefetchCall.Reset();
+	}
+	// Predict what the next call will look like once the controller gets there.
+	TSharedRef<BartlebyCall> call = MakeCall(controller, controller->AppendedMsg + arrivalMsg, CaptureStatus(controller, arrivalPos));
+	call->IsSpeculative = true;
+	controller->PrefetchCall = call;
+	QueueBuild(call);
+}
+
+TSharedRef<ABartlebySystem::BartlebyCall> ABartlebySystem::MakeCall(ABartlebyController* controller, const FString& appended,
+	FBartlebyStatusSnapshot&& snapshot)
+{
+	BARTLEBY_TRACE_SCOPE(MakeCall);
+	TSharedRef<BartlebyCall> call = MakeShared<BartlebyCall>();
+	call->Controller = controller;
+	call->Appended = appended;
+	call->Snapshot = MoveTemp(snapshot);
+	call->BaseLogRevision = controller->LogRevision;
+	call->FirstMemory = GetNumMemories(controller);
+	call->AppendedFirstMemory = controller->AppendedMsg.IsEmpty() ? call->FirstMemory : controller->AppendedFirstMemory;
+	// Work on a copy of the log, so that nothing changes until the call is committed.
+	call->Log = controller->Log;
+	// Gather everything else that reads the controller now, so that the call can be built from copies.
+	call->Recall = GenerateRecallString(controller);
+	call->FirstMessage = GenerateFirstMessage() + GenerateMemoryString(controller);
+	call->FixedTokens = CountPromptTokens({}, UseMemorySummary ? controller->MemorySummaryTokens : 0);
+	call->IsStreaming = UseStreaming;
+	// Remember what the guest asked and where, in case someone asks something like it again.
+	if (UtteranceCache && controller->CurrentRoom && !call->Snapshot.GuestSaid.IsEmpty())
+	{
+		call->Utterance = call->Snapshot.GuestSaid;
+		call->UtteranceContext = FBartlebyUtteranceCache::MakeContextKey(call->Snapshot.RoomId, call->Snapshot.ObjectIds);
+	}
+	return call;
+}
+
+bool ABartlebySystem::CommitCall(const TSharedRef<BartlebyCall>& call)
+{
+	BARTLEBY_TRACE_SCOPE(CommitCall);
+	ABartlebyController* controller = call->Controller.Get();
+	if (!controller)
+	{
+		return false;
+	}
+	// An action or a failure since the call was made changed the log, and the call's copy doesn't have that.
+	if (call->BaseLogRevision != controller->LogRevision)
+	{
+		NumStaleCommits++;
+		return false;
+	}
+	controller->Log = call->Log;
+	controller->LogRevision++;
+	controller->LastFullPrompt = call->FullPrompt;
+	controller->LastPromptTokens = CountPromptTokens(call->Log, UseMemorySummary ? controller->MemorySummaryTokens : 0);
+	// An adopted prefetch has already handed its body to the request.
+	const TArray<uint8>& body = call->Request ? call->Request->GetContent() : call->Body;
+	UpdatePrefixStats(controller, body);
+	TRACE_COUNTER_SET(BartlebyPromptTokens, controller->LastPromptTokens);
+	TRACE_COUNTER_SET(BartlebyPromptBytes, body.Num());
+	// Anything appended while the call was being built goes in the next one.
+	controller->AppendedMsg = controller->AppendedMsg.StartsWith(call->Appended, ESearchCase::CaseSensitive) ?
+		controller->AppendedMsg.RightChop(call->Appended.Len()) : FString();
+	// What the guest said when the call was made, since they may have started talking to someone else since.
+	const FString& guestSaid = call->Snapshot.GuestSaid;
+	if (!guestSaid.IsEmpty() && guestSaid != controller->LastRememberedUtterance)
+	{
+		Remember(controller, GuestSaidPrompt + " \"" + guestSaid + "\"");
+		controller->LastRememberedUtterance = guestSaid;
+	}
+	if (call->Forgotten.Num() > 0)
+	{
+		controller->PendingMemory.Append(MoveTemp(call->Forgotten));
+		SummarizeMemory(controller);
+	}
+	NeedsHelpString = false; // TODO, when the AI fails, give it another help string?
+	return true;
+}
+
+void ABartlebySystem::CancelCall(const TSharedRef<BartlebyCall>& call)
+{
+	call->IsCancelled = true;
+	if (call->Request)
+	{
+		call->Request->CancelRequest();
+	}
+	else
+	{
+		PendingBuilds.Remove(call);
+		PendingCalls.Remove(call);
+	}
+}
+
+void ABartlebySystem::CancelAllCalls()
+{
+	TArray<TSharedRef<BartlebyCall>> calls = MoveTemp(InFlightCalls);
+	calls.Append(MoveTemp(PendingCalls));
+	calls.Append(MoveTemp(PendingBuilds));
+	InFlightCalls.Reset();
+	PendingCalls.Reset();
+	PendingBuilds.Reset();
+	for (ABartlebyController* controller : Controllers)
+	{
+		if (controller && controller->PrefetchCall)
+		{
+			calls.AddUnique(controller->PrefetchCall.ToSharedRef());
+			controller->PrefetchCall.Reset();
+		}
+	}
+	for (const TSharedRef<BartlebyCall>& call : calls)
+	{
+		// Bump the attempt first, so that anything already on its way back is ignored.
+		call->Attempt++;
+		call->IsCancelled = true;
+		call->IsFinished = true;
+		for (const FHttpRequestPtr& request : { call->Request, call->HedgeRequest })
+		{
+			if (!request)
+			{
+				continue;
+			}
+			// Streamed answers call back into the system on the game thread, so they're cut off before cancelling,
+			// which can call back right away. Other answers only touch the call and the controller's queue, and
+			// complete on the HTTP thread, where unbinding could race with them.
+			if (call->IsStreaming)
+			{
+				request->OnRequestProgress().Unbind();
+				request->OnProcessRequestComplete().Unbind();
+			}
+			request->CancelRequest();
+		}
+		call->HedgeRequest.Reset();
+	}
+	NumInFlightRequests = 0;
+	NumQueuedRequests = 0;
+}
+
+void ABartlebySystem::QueueBuild(const TSharedRef<BartlebyCall>& call)
+{
+	if (!BuildPromptsInBackground)
+	{
+		BuildCall(*call, MakePromptSettings());
+		OnCallBuilt(call);
+		return;
+	}
+	PendingBuilds.Add(call);
+}
+
+void ABartlebySystem::BuildPendingCalls()
+{
+	if (PendingBuilds.Num() == 0)
+	{
+		return;
+	}
+	BARTLEBY_TRACE_SCOPE(BuildPendingCalls);
+	TWeakObjectPtr<ABartlebySystem> weakThis = this;
+	TArray<TSharedRef<BartlebyCall>> calls = MoveTemp(PendingBuilds);
+	PendingBuilds.Reset();
+	Async(EAsyncExecution::ThreadPool, [weakThis, calls = MoveTemp(calls), settings = MakePromptSettings()]()
+		{
+			// Each call only touches its own copies, so they can all be built at once.
+			ParallelFor(calls.Num(), [&calls, &settings](int32 i)
+				{
+					BuildCall(*calls[i], settings);
+				});
+			AsyncTask(ENamedThreads::GameThread, [weakThis, calls]()
+				{
+					// Calls finished building after the system ended play have nowhere to go.
+					if (weakThis.IsValid() && weakThis->HasActorBegunPlay())
 					{
-						TArray<TSharedPtr<FJsonValue>> ChoicesArray = jsonObject->GetArrayField("choices");
-						if (ChoicesArray.Num() > 0)
-						{
-							TSharedPtr<FJsonObject> ChoiceObject = ChoicesArray[0]->AsObject();
-							// We got an object, figure out what the AI said.
-							if (ChoiceObject)
-							{
-								TSharedPtr<FJsonObject> MessageObject = ChoiceObject->GetObjectField("message");
-								FString Role = MessageObject->GetStringField("role");
-								FString Content = MessageObject->GetStringField("content");
-								LastThingOpenAISaid = Content;
-								TArray<FString> Lines;
-								// AI sometimes says a lot of things. Infer each line to be exactly one command and ignore
-								// all but the first.
-								LastThingOpenAISaid.ParseIntoArrayLines(Lines, true);
-								if (Lines.Num() > 0)
-								{
-									LastThingOpenAISaid = Lines[0];
-								}
-								Log.push_back(BartlebyLogElement{ BartlebyLogType::Output, LastThingOpenAISaid });
-							}
-						}
-						else
+						for (const TSharedRef<BartlebyCall>& call : calls)
 						{
-							wasParsingError = true;
+							weakThis->OnCallBuilt(call);
 						}
 					}
-					else
-					{
-						wasParsingError = true;
-					}
-				}
-				else
-				{
-					wasParsingError = true;
-				}
-				
-			}
-			else
+				});
+		});
+}
+
+void ABartlebySystem::BuildCall(BartlebyCall& call, const BartlebyPromptSettings& settings)
+{
+	BARTLEBY_TRACE_SCOPE(BuildCall);
+	TArray<FBartlebyMemoryEntry>* forgotten = settings.KeepForgotten ? &call.Forgotten : nullptr;
+	call.Status = call.Snapshot.Render(settings.SeeGuestPrompt, settings.GuestSaidPrompt);
+	if (!call.Appended.IsEmpty())
+	{
+		AddLog(call.Log, call.Appended, call.AppendedFirstMemory, call.FixedTokens, settings, forgotten);
+		call.FullPrompt += call.Appended + "\n";
+	}
+	FString nextPrompt = GeneratePrompt(settings, false, call.Status + call.Recall);
+	call.FullPrompt += nextPrompt;
+	AddLog(call.Log, nextPrompt, call.FirstMemory, call.FixedTokens, settings, forgotten);
+	call.EstimatedTokens = call.FixedTokens + CountLogTokens(call.Log) + settings.ExpectedCompletionTokens;
+	WriteRequestBody(call.Body, settings.Model, settings.Temperature, call.IsStreaming, call.FirstMessage, call.Log,
+		settings.BodySizeHint);
+}
+
+void ABartlebySystem::OnCallBuilt(const TSharedRef<BartlebyCall>& call)
+{
+	BARTLEBY_TRACE_SCOPE(OnCallBuilt);
+	call->IsBuilt = true;
+	BodySizeHint = FMath::Max(BodySizeHint, call->Body.Num());
+	if (call->IsCancelled || !call->Controller.IsValid())
+	{
+		return;
+	}
+	// Guesses are only committed once they turn out right, which may have happened while they were being built.
+	if (!call->IsSpeculative && !CommitCall(call))
+	{
+		// The log changed while the call was being built, so it would have undone that. Build it again on top of the
+		// log as it is now, with the same status and messages.
+		QueueBuild(MakeCall(call->Controller.Get(), call->Appended, MoveTemp(call->Snapshot)));
+		return;
+	}
+	EnqueueCall(call);
+}
+
+void ABartlebySystem::EnqueueCall(const TSharedRef<BartlebyCall>& call)
+{
+	BARTLEBY_TRACE_SCOPE(EnqueueCall);
+	// If we've sent this exact request before, we already know the answer. Only actions are cached.
+	if (CompletionCache && !call->IsMemorySummary)
+	{
+		call->CacheKey = FBartlebyCompletionCache::MakeKey(call->Body);
+		FString cached;
+		bool found = CompletionCache->Find(call->CacheKey, cached);
+		UpdateCacheStats();
+		if (found)
+		{
+			call->IsFromCache = true;
+			call->IsFinished = true;
+			OnCallSucceeded(call, cached);
+			return;
+		}
+	}
+	// If a guest asked something close enough to this before, give the same answer.
+	if (UtteranceCache && !call->Utterance.IsEmpty())
+	{
+		FString answer;
+		float similarity = 0.0f;
+		bool found = UtteranceCache->Find(call->UtteranceContext, call->Utterance, UtteranceSimilarityThreshold,
+			UtteranceCacheTimeToLive, FPlatformTime::Seconds(), answer, similarity);
+		UpdateCacheStats();
+		if (found)
+		{
+			UE_LOG(LogTemp, Display, TEXT("Answering \"%s\" from the utterance cache (similarity %.2f)."), *call->Utterance, similarity);
+			call->IsFromCache = true;
+			call->IsFinished = true;
+			OnCallSucceeded(call, answer);
+			return;
+		}
+	}
+	call->EnqueueTime = FPlatformTime::Seconds();
+	PendingCalls.Add(call);
+	PumpScheduler();
+}
+
+float ABartlebySystem::GetCallPriority(const BartlebyCall& call, double now) const
+{
+	ABartlebyController* controller = call.Controller.Get();
+	if (!controller || !controller->GetPawn())
+	{
+		return TNumericLimits<float>::Max();
+	}
+	// Agents closest to a player go first.
+	FVector pos = controller->GetPawn()->GetActorLocation();
+	float closest = TNumericLimits<float>::Max();
+	for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+	{
+		APlayerController* player = it->Get();
+		if (player && player->GetPawn())
+		{
+			closest = FMath::Min(closest, FVector::Dist(player->GetPawn()->GetActorLocation(), pos));
+		}
+	}
+	// Guesses and memory summaries can wait for the real thing.
+	if (call.IsSpeculative || call.IsMemorySummary)
+	{
+		closest += SpeculativePriorityPenalty;
+	}
+	// The longer something waits, the closer it pretends to be, so nothing waits forever.
+	return closest - static_cast<float>(now - call.EnqueueTime) * PriorityAgingSpeed;
+}
+
+void ABartlebySystem::PumpScheduler()
+{
+	BARTLEBY_TRACE_SCOPE(PumpScheduler);
+	const double now = FPlatformTime::Seconds();
+	RateLimitWait = 0.0f;
+	while (PendingCalls.Num() > 0 && NumInFlightRequests < MaxConcurrentRequests)
+	{
+		// Calls backing off before a retry aren't ready yet.
+		int32 best = INDEX_NONE;
+		float bestPriority = 0.0f;
+		for (int32 i = 0; i < PendingCalls.Num(); i++)
+		{
+			if (PendingCalls[i]->NotBefore > now)
 			{
-				UE_LOG(LogTemp, Error, TEXT("Failed to deserialize from json reader!"));
-				wasParsingError = true;
+				continue;
 			}
-
-			if (wasParsingError)
+			float priority = GetCallPriority(*PendingCalls[i], now);
+			if (best == INDEX_NONE || priority < bestPriority)
 			{
-				UE_LOG(LogTemp, Warning, TEXT("Clearing the log, openAI failed."));
-				Log.clear();
+				best = i;
+				bestPriority = priority;
 			}
 		}
-		else 
+		if (best == INDEX_NONE)
+		{
+			break;
+		}
+		TSharedRef<BartlebyCall> call = PendingCalls[best];
+		// If the server would turn it away, it keeps its place in line until there's room. Nothing else goes ahead of
+		// it, so the most urgent call is the first to go once there is.
+		if (RateLimiter)
 		{
-			// Sometimes the internet fails us.
-			switch (pRequest->GetStatus()) 
+			float wait = 0.0f;
+			if (!RateLimiter->TryAcquire(now, call->EstimatedTokens, wait))
 			{
-			case EHttpRequestStatus::Failed_ConnectionError:
-				UE_LOG(LogTemp, Error, TEXT("Connection failed."));
-				break;
-			default:
-				UE_LOG(LogTemp, Error, TEXT("Request failed."));
+				NumPacedRequests += call->WasPaced ? 0 : 1;
+				call->WasPaced = true;
+				RateLimitWait = wait;
 				break;
 			}
+			call->ReservedRequests++;
+			call->ReservedTokens += call->EstimatedTokens;
+		}
+		PendingCalls.RemoveAt(best);
+
+		// Keep track of how long things wait in line.
+		const float wait = static_cast<float>(now - call->EnqueueTime);
+		TotalQueueWait += wait;
+		NumScheduledRequests++;
+		AverageQueueWait = static_cast<float>(TotalQueueWait / NumScheduledRequests);
+		MaxQueueWait = FMath::Max(MaxQueueWait, wait);
+		if (wait > StarvationTime)
+		{
+			NumStarvedRequests++;
+		}
+		NumInFlightRequests++;
+		InFlightCalls.Add(call);
+		call->IsFinished = false;
+		SendCall(call);
+	}
+	NumQueuedRequests = PendingCalls.Num();
+}
+
+void ABartlebySystem::FinishCall(const TSharedRef<BartlebyCall>& call)
+{
+	if (call->IsFinished)
+	{
+		return;
+	}
+	call->IsFinished = true;
+	ReleaseRateLimit(*call);
+	InFlightCalls.Remove(call);
+	NumInFlightRequests--;
+	if (ConnectionManager)
+	{
+		ConnectionManager->OnRequestFinished(FPlatformTime::Seconds(), false);
+	}
+	PumpScheduler();
+}
+
+void ABartlebySystem::WriteRequestBody(TArray<uint8>& out, const FString& model, double temperature, bool stream,
+	const FString& firstMessage, const std::deque<BartlebyLogElement>& log, int32 sizeHint)
+{
+	BARTLEBY_TRACE_SCOPE(WriteRequestBody);
+	out.Reset(sizeHint);
+	FBartlebyJsonWriter writer(out);
+	writer.BeginObject();
+	// Add the model name, messages, and temperature to the object
+	writer.WriteField("model", model);
+	writer.WriteKey("messages");
+	writer.BeginArray();
+	// Always generate the help string.
+	writer.BeginObject();
+	writer.WriteField("role", FString(TEXT("user")));
+	writer.WriteField("content", firstMessage);
+	writer.EndObject();
+	// Add a bunch of messages.
+	for (const auto& log_element : log)
+	{
+		writer.BeginObject();
+		if (log_element.Type == BartlebyLogType::Prompt)
+		{
+			writer.WriteField("role", FString(TEXT("user")));
+		}
+		else
+		{
+			writer.WriteField("role", FString(TEXT("assistant")));
 		}
-		};
-	// When done, the completion callback will be called.
-	request->OnProcessRequestComplete().BindLambda(completionCallback);
+		writer.WriteField("content", log_element.Content);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.WriteField("temperature", temperature);
+	if (stream)
+	{
+		writer.WriteField("stream", true);
+	}
+	writer.EndObject();
+}
 
+void ABartlebySystem::SendCall(const TSharedRef<BartlebyCall>& call)
+{
+	BARTLEBY_TRACE_SCOPE(SendCall);
+	ABartlebyController* controller = call->Controller.Get();
+	if (!controller)
+	{
+		FinishCall(call);
+		return;
+	}
+	call->SendTime = FPlatformTime::Seconds();
+	call->FirstByteTime = 0.0;
+	call->NumOutstanding = 1;
+	call->HedgeRequest.Reset();
+	if (Transport == EBartlebyTransport::Replay)
+	{
+		ReplayCall(call);
+		return;
+	}
+	// The body is already UTF-8, so hand it straight over.
+	FHttpRequestRef request = MakeRequest(call, MoveTemp(call->Body), false);
+	call->Request = request;
 	// Finally, submit the request for processing
 	request->ProcessRequest();
 }
 
-void ABartlebySystem::AppendMsg(const FString& append)
+FHttpRequestRef ABartlebySystem::MakeRequest(const TSharedRef<BartlebyCall>& call, TArray<uint8>&& body, bool isHedge)
+{
+	// Set up our HTTP request.
+	FHttpModule& httpModule = FHttpModule::Get();
+	FHttpRequestRef request = httpModule.CreateRequest();
+	request->SetURL(URL);
+	request->SetVerb(TEXT("POST"));
+	request->SetHeader(TEXT("Content-type"), TEXT("application/json"));
+	request->SetHeader(TEXT("Authorization"), TEXT("Bearer " + OpenAiKey));
+	request->SetContent(MoveTemp(body));
+	if (ConnectionManager)
+	{
+		ConnectionManager->OnRequestSent(FPlatformTime::Seconds());
+	}
+	const int32 attempt = call->Attempt;
+	if (call->IsStreaming)
+	{
+		// Parse the response as it comes in, rather than waiting for the whole thing. The body is handed over by the HTTP
+		// thread through the buffer, so the response itself is never read while it's still being written.
+		// These run on the game thread, but the request can outlive the system, so they only hold on to it weakly.
+		TSharedRef<FBartlebyStreamParser> parser = MakeShared<FBartlebyStreamParser>();
+		TSharedRef<FBartlebyStreamBuffer> buffer = MakeShared<FBartlebyStreamBuffer>();
+		const bool isAttached = FBartlebyStreamBuffer::Attach(*request, buffer);
+		TWeakObjectPtr<ABartlebySystem> weakThis = this;
+		request->OnRequestProgress().BindLambda([weakThis, call, parser, buffer, attempt](FHttpRequestPtr pRequest, int32 bytesSent, int32 bytesReceived)
+			{
+				if (!weakThis.IsValid())
+				{
+					return;
+				}
+				if (attempt == call->Attempt)
+				{
+					if (bytesReceived > 0 && call->FirstByteTime == 0.0)
+					{
+						call->FirstByteTime = FPlatformTime::Seconds();
+					}
+					weakThis->OnStreamProgress(call, parser, *buffer);
+				}
+			});
+		request->OnProcessRequestComplete().BindLambda([weakThis, call, parser, buffer, isAttached, attempt](FHttpRequestPtr pRequest,
+			FHttpResponsePtr pResponse, bool connectedSuccessfully)
+			{
+				if (!weakThis.IsValid())
+				{
+					return;
+				}
+				if (attempt == call->Attempt && !call->IsFinished)
+				{
+					const bool hasResponse = connectedSuccessfully && pResponse;
+					if (hasResponse && !isAttached)
+					{
+						buffer->Append(pResponse->GetContent());
+					}
+					buffer->Update();
+					weakThis->OnStreamComplete(call, hasResponse ? &buffer->GetBody() : nullptr, hasResponse ? pResponse->GetResponseCode() : 0,
+						hasResponse ? FBartlebyRateLimitHeaders::FromResponse(*pResponse) : FBartlebyRateLimitHeaders(), parser);
+				}
+			});
+		return request;
+	}
+	// Progress is reported on the game thread, at most once a frame, which is close enough for the first byte.
+	request->OnRequestProgress().BindLambda([call, attempt](FHttpRequestPtr pRequest, int32 bytesSent, int32 bytesReceived)
+		{
+			if (bytesReceived > 0 && attempt == call->Attempt && call->FirstByteTime == 0.0)
+			{
+				call->FirstByteTime = FPlatformTime::Seconds();
+			}
+		});
+	// The answer is parsed on the HTTP thread, so a big response can't hitch the game. The result is handed to the
+	// controller through its queue, and the controller is woken up on the game thread to dispatch it.
+	request->SetDelegateThreadPolicy(EHttpRequestDelegateThreadPolicy::CompleteOnHttpThread);
+	TSharedRef<BartlebyResultQueue> results = call->Controller->CompletedCalls;
+	TWeakObjectPtr<ABartlebyController> controller = call->Controller;
+	const bool logBody = LogResponseBodies;
+	const bool isRecording = Transport == EBartlebyTransport::Record && Recording;
+	request->OnProcessRequestComplete().BindLambda([call, results, controller, logBody, isRecording, attempt, isHedge](
+		FHttpRequestPtr pRequest,
+		FHttpResponsePtr pResponse,
+		bool connectedSuccessfully)
+		{
+			BartlebyCallResult result;
+			result.Call = call;
+			result.Attempt = attempt;
+			result.IsHedge = isHedge;
+			if (connectedSuccessfully && pResponse)
+			{
+				if (isRecording)
+				{
+					// Whether this answer is the one the call goes on with is only known on the game thread, so keep a
+					// copy for it to record.
+					result.RecordedRequest = pRequest->GetContent();
+					result.RecordedResponse = pResponse->GetContent();
+					result.Latency = pRequest->GetElapsedTime();
+				}
+				result.RateLimits = FBartlebyRateLimitHeaders::FromResponse(*pResponse);
+				ReadResponse(pResponse->GetContent(), pResponse->GetResponseCode(), logBody, result);
+			}
+			else
+			{
+				result.WasConnectionError = pRequest->GetStatus() == EHttpRequestStatus::Failed_ConnectionError;
+			}
+			results->Enqueue(MoveTemp(result));
+			AsyncTask(ENamedThreads::GameThread, [controller]()
+				{
+					if (controller.IsValid())
+					{
+						controller->DispatchCompletedCalls();
+					}
+				});
+		});
+	return request;
+}
+
+void ABartlebySystem::HedgeCall(const TSharedRef<BartlebyCall>& call)
 {
-	appendedMsg += append;
+	if (!call->Controller.IsValid())
+	{
+		return;
+	}
+	// A duplicate isn't worth going over the rate limit for.
+	if (RateLimiter)
+	{
+		float wait = 0.0f;
+		if (!RateLimiter->TryAcquire(FPlatformTime::Seconds(), call->EstimatedTokens, wait))
+		{
+			return;
+		}
+		call->ReservedRequests++;
+		call->ReservedTokens += call->EstimatedTokens;
+	}
+	NumHedgedRequests++;
+	TArray<uint8> body = call->Request->GetContent();
+	FHttpRequestRef request = MakeRequest(call, MoveTemp(body), true);
+	call->HedgeRequest = request;
+	call->NumOutstanding++;
+	request->ProcessRequest();
 }
 
-void ABartlebySystem::AddLog(const FString& log)
+void ABartlebySystem::AbandonAttempt(const TSharedRef<BartlebyCall>& call)
 {
-	Log.push_back(BartlebyLogElement{ BartlebyLogType::Prompt, log });
-	// Remove the first element whenever we have too many!
-	if (Log.size() > MaxNumLogElements)
+	// Bump the attempt first, since cancelling can call back right away.
+	call->Attempt++;
+	call->NumOutstanding = 0;
+	if (call->Request)
 	{
-		Log.pop_front();
+		call->Request->CancelRequest();
 	}
-}
\ No newline at end of file
+	if (call->HedgeRequest)
+	{
+		call->HedgeRequest->CancelRequest();
+		call->HedgeRequest.Reset();
+	}
+}
+
+bool ABartlebySystem::TryRetryCall(const TSharedRef<BartlebyCall>& call, float minDelay)
+{
+	if (call->Retries >= MaxRetries || call->IsCancelled || !call->Request)
+	{
+		return false;
+	}
+	call->Retries++;
+	NumRetries++;
+	// The body was handed to the request, so get it back from there.
+	call->Body = call->Request->GetContent();
+	call->Request.Reset();
+	call->HedgeRequest.Reset();
+	call->Attempt++;
+	// Back off exponentially, with jitter so that calls that failed together don't all come back together.
+	const float delay = FMath::Min(RetryMaxDelay, RetryBaseDelay * FMath::Pow(2.0f, static_cast<float>(call->Retries - 1)));
+	call->NotBefore = FPlatformTime::Seconds() + FMath::Max(minDelay, delay * FMath::FRandRange(0.5f, 1.0f));
+	UE_LOG(LogTemp, Warning, TEXT("Retrying call in %.1f seconds (retry %d of %d)."), call->NotBefore - FPlatformTime::Seconds(),
+		call->Retries, MaxRetries);
+	FinishCall(call);
+	PendingCalls.Add(call);
+	NumQueuedRequests = PendingCalls.Num();
+	return true;
+}
+
+void ABartlebySystem::CheckDeadlines(double now)
+{
+	BARTLEBY_TRACE_SCOPE(CheckDeadlines);
+	const bool canHedge = UseHedging && RecentLatencies.Num() >= HedgingMinSamples;
+	TArray<TSharedRef<BartlebyCall>> inFlight = InFlightCalls;
+	for (const TSharedRef<BartlebyCall>& call : inFlight)
+	{
+		// Streamed calls that already handed off their action are just waiting to be cancelled.
+		if (call->IsComplete || call->IsCancelled || call->IsFinished || !call->Request)
+		{
+			continue;
+		}
+		const double age = now - call->SendTime;
+		if (RequestTimeout > 0.0f && age > RequestTimeout)
+		{
+			NumTimeouts++;
+			UE_LOG(LogTemp, Warning, TEXT("Call timed out after %.1f seconds."), age);
+			AbandonAttempt(call);
+			if (!TryRetryCall(call))
+			{
+				FinishCall(call);
+				OnCallFailed(call, false);
+			}
+			continue;
+		}
+		if (canHedge && !call->IsStreaming && !call->IsMemorySummary && !call->HedgeRequest && age > LatencyP95)
+		{
+			HedgeCall(call);
+		}
+	}
+}
+
+void ABartlebySystem::RecordLatency(float seconds)
+{
+	const int32 maxSamples = 128;
+	if (RecentLatencies.Num() < maxSamples)
+	{
+		RecentLatencies.Add(seconds);
+	}
+	else
+	{
+		RecentLatencies[NextLatencyIndex] = seconds;
+	}
+	NextLatencyIndex = (NextLatencyIndex + 1) % maxSamples;
+	TArray<float> sorted = RecentLatencies;
+	sorted.Sort();
+	LatencyP95 = sorted[FMath::Min(sorted.Num() - 1, FMath::FloorToInt(sorted.Num() * 0.95f))];
+}
+
+void ABartlebySystem::RecordCallTelemetry(const BartlebyCall& call, int32 responseBytes, int32 promptTokens, int32 completionTokens)
+{
+	const double now = FPlatformTime::Seconds();
+	const int32 latencyMs = FMath::RoundToInt((now - call.SendTime) * 1000.0);
+	const int32 requestBytes = call.Request ? call.Request->GetContent().Num() : call.Body.Num();
+	Telemetry.Record(EBartlebyMetric::Latency, latencyMs);
+	Telemetry.Record(EBartlebyMetric::RequestBytes, requestBytes);
+	Telemetry.Record(EBartlebyMetric::ResponseBytes, responseBytes);
+	Telemetry.Record(EBartlebyMetric::Retries, call.Retries);
+	CSV_CUSTOM_STAT(Bartleby, LatencyMs, latencyMs, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Bartleby, RequestBytes, requestBytes, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(Bartleby, ResponseBytes, responseBytes, ECsvCustomStatOp::Set);
+	if (call.FirstByteTime > 0.0)
+	{
+		const int32 firstByteMs = FMath::RoundToInt((call.FirstByteTime - call.SendTime) * 1000.0);
+		Telemetry.Record(EBartlebyMetric::TimeToFirstByte, firstByteMs);
+		CSV_CUSTOM_STAT(Bartleby, TimeToFirstByteMs, firstByteMs, ECsvCustomStatOp::Set);
+	}
+	if (promptTokens >= 0)
+	{
+		Telemetry.Record(EBartlebyMetric::PromptTokens, promptTokens);
+		CSV_CUSTOM_STAT(Bartleby, PromptTokens, promptTokens, ECsvCustomStatOp::Set);
+	}
+	if (completionTokens >= 0)
+	{
+		Telemetry.Record(EBartlebyMetric::CompletionTokens, completionTokens);
+		CSV_CUSTOM_STAT(Bartleby, CompletionTokens, completionTokens, ECsvCustomStatOp::Set);
+	}
+}
+
+float ABartlebySystem::GetCallMetricPercentile(EBartlebyMetric metric, float percent) const
+{
+	if (metric == EBartlebyMetric::Count)
+	{
+		return 0.0f;
+	}
+	return static_cast<float>(Telemetry.Get(metric).GetPercentile(percent));
+}
+
+int32 ABartlebySystem::GetCallMetricCount(EBartlebyMetric metric) const
+{
+	if (metric == EBartlebyMetric::Count)
+	{
+		return 0;
+	}
+	return static_cast<int32>(Telemetry.Get(metric).GetCount());
+}
+
+void ABartlebySystem::DumpTelemetry()
+{
+	NumRecordedAtLastDump = Telemetry.GetNumRecorded();
+	if (TelemetryFile.IsEmpty())
+	{
+		return;
+	}
+	const FString path = FPaths::ProjectSavedDir() / TelemetryFile;
+	const FDateTime now = FDateTime::UtcNow();
+	TMap<FString, int64> counters;
+	counters.Add(TEXT("failed_calls"), NumFailedCalls);
+	counters.Add(TEXT("parse_failures"), NumParseFailures);
+	counters.Add(TEXT("timeouts"), NumTimeouts);
+	counters.Add(TEXT("retries"), NumRetries);
+	counters.Add(TEXT("paced_requests"), NumPacedRequests);
+	counters.Add(TEXT("rate_limited_responses"), NumRateLimitedResponses);
+	counters.Add(TEXT("server_errors"), NumServerErrors);
+	counters.Add(TEXT("hedged_requests"), NumHedgedRequests);
+	counters.Add(TEXT("hedge_wins"), NumHedgeWins);
+	counters.Add(TEXT("prompt_tokens_used"), PromptTokensUsed);
+	counters.Add(TEXT("completion_tokens_used"), CompletionTokensUsed);
+	if (!Telemetry.AppendCsv(path + TEXT(".csv"), now) || !Telemetry.WriteJson(path + TEXT(".json"), now, counters))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't write telemetry to %s."), *path);
+	}
+}
+
+bool ABartlebySystem::ParseCompletion(const TArray<uint8>& body, bool logBody, BartlebyCallResult& result)
+{
+	BARTLEBY_TRACE_SCOPE(ParseCompletion);
+	if (logBody)
+	{
+		UE_LOG(LogTemp, Display, TEXT("%s"), *FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(body.GetData()), body.Num())));
+	}
+	FBartlebyCompletion completion;
+	int32 errorOffset = 0;
+	switch (FBartlebyResponseScanner::Scan(body, completion, &errorOffset))
+	{
+	case EBartlebyScanResult::Malformed:
+		UE_LOG(LogTemp, Error, TEXT("Failed to parse the response at byte %d of %d. Turn on LogResponseBodies to see it."),
+			errorOffset, body.Num());
+		return false;
+	case EBartlebyScanResult::ApiError:
+		UE_LOG(LogTemp, Error, TEXT("API returned an error: %s"), *completion.ErrorMessage);
+		return false;
+	default:
+		break;
+	}
+	result.PromptTokens = completion.PromptTokens;
+	result.CompletionTokens = completion.CompletionTokens;
+	// AI should have generated a list of "choices", and we just want what the first one said.
+	if (!completion.bHasContent)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Response had no content."));
+		return false;
+	}
+	if (completion.FinishReason == TEXT("length"))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The AI ran out of tokens, its answer may be cut off."));
+	}
+	FString& Content = completion.Content;
+	FString& action = result.Action;
+	action = Content;
+	if (result.Call && result.Call->IsMemorySummary)
+	{
+		return true;
+	}
+	TArray<FString> Lines;
+	// AI sometimes says a lot of things. Infer each line to be exactly one command and ignore
+	// all but the first.
+	Content.ParseIntoArrayLines(Lines, true);
+	if (Lines.Num() > 0)
+	{
+		action = Lines[0];
+	}
+	return true;
+}
+
+void ABartlebySystem::ReadResponse(const TArray<uint8>& body, int32 status, bool logBody, BartlebyCallResult& result)
+{
+	result.Status = status;
+	result.ResponseBytes = body.Num();
+	// Being told to slow down says nothing about the prompt, so don't go looking for an answer in it.
+	if (IsTransientStatus(status))
+	{
+		result.WasRateLimited = status == 429;
+		result.WasServerError = status >= 500;
+		return;
+	}
+	result.Succeeded = ParseCompletion(body, logBody, result);
+	result.WasParsingError = !result.Succeeded;
+}
+
+float ABartlebySystem::OnTransientError(int32 status, const FBartlebyRateLimitHeaders& limits)
+{
+	const float delay = FMath::Max(0.0f, limits.GetRetryDelay());
+	if (status == 429)
+	{
+		NumRateLimitedResponses++;
+		UE_LOG(LogTemp, Warning, TEXT("Rate limited, holding calls back for %.1f seconds."), delay);
+		// Everything else would be turned away too.
+		if (RateLimiter)
+		{
+			RateLimiter->Pause(FPlatformTime::Seconds(), delay);
+		}
+	}
+	else
+	{
+		NumServerErrors++;
+		UE_LOG(LogTemp, Error, TEXT("The server had an error (%d)."), status);
+	}
+	return delay;
+}
+
+void ABartlebySystem::UpdateRateLimits(const BartlebyCall& call, const FBartlebyRateLimitHeaders& limits)
+{
+	if (!RateLimiter || !limits.HasAny())
+	{
+		return;
+	}
+	RateLimiter->Update(FPlatformTime::Seconds(), limits, call.ReservedRequests, call.ReservedTokens);
+}
+
+void ABartlebySystem::ReleaseRateLimit(BartlebyCall& call)
+{
+	if (RateLimiter)
+	{
+		RateLimiter->Release(call.ReservedRequests, call.ReservedTokens);
+	}
+	call.ReservedRequests = 0;
+	call.ReservedTokens = 0;
+}
+
+void ABartlebySystem::OnCallCompleted(const BartlebyCallResult& result)
+{
+	BARTLEBY_TRACE_SCOPE(OnCallCompleted);
+	check(IsInGameThread());
+	TSharedRef<BartlebyCall> call = result.Call.ToSharedRef();
+	PromptTokensUsed += FMath::Max(0, result.PromptTokens);
+	CompletionTokensUsed += FMath::Max(0, result.CompletionTokens);
+	// Answers to a try we already gave up on, or the slower of two hedged requests.
+	if (result.Attempt != call->Attempt || call->IsFinished)
+	{
+		return;
+	}
+	UpdateRateLimits(*call, result.RateLimits);
+	call->NumOutstanding--;
+	// Failures the other request of a hedged call can still make up for don't change what happens next, so they're
+	// left out of the recording along with the answers thrown away above.
+	if (result.Succeeded || call->NumOutstanding == 0)
+	{
+		RecordCall(result);
+	}
+	if (result.Succeeded)
+	{
+		// Summaries are longer than actions, and nothing waits on them, so they'd only throw off when to hedge.
+		if (!call->IsMemorySummary)
+		{
+			RecordLatency(static_cast<float>(FPlatformTime::Seconds() - call->SendTime));
+		}
+		RecordCallTelemetry(*call, result.ResponseBytes, result.PromptTokens, result.CompletionTokens);
+		// Whichever request answered first wins, and the other one is no longer needed.
+		FHttpRequestPtr loser = result.IsHedge ? call->Request : call->HedgeRequest;
+		if (result.IsHedge)
+		{
+			NumHedgeWins++;
+		}
+		if (loser && call->NumOutstanding > 0)
+		{
+			call->Attempt++;
+			loser->CancelRequest();
+		}
+		FinishCall(call);
+		if (!call->IsCancelled)
+		{
+			OnCallSucceeded(call, result.Action);
+		}
+		return;
+	}
+	// If the call was hedged, the other request might still come through.
+	if (call->NumOutstanding > 0)
+	{
+		return;
+	}
+	if (ConnectionManager && result.WasConnectionError)
+	{
+		ConnectionManager->OnRequestFinished(FPlatformTime::Seconds(), true);
+	}
+	if (call->IsCancelled)
+	{
+		FinishCall(call);
+		return;
+	}
+	// Sometimes the internet fails us, or the server is busy. Either way, the prompt was fine, so try it again.
+	if (!result.WasParsingError)
+	{
+		float retryDelay = 0.0f;
+		if (result.WasRateLimited || result.WasServerError)
+		{
+			retryDelay = OnTransientError(result.Status, result.RateLimits);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s"), result.WasConnectionError ? TEXT("Connection failed.") : TEXT("Request failed."));
+		}
+		if (TryRetryCall(call, retryDelay))
+		{
+			return;
+		}
+	}
+	FinishCall(call);
+	OnCallFailed(call, result.WasParsingError);
+}
+
+void ABartlebySystem::OnCallSucceeded(const TSharedRef<BartlebyCall>& call, const FString& action)
+{
+	call->IsComplete = true;
+	call->Result = action;
+	if (call->IsMemorySummary)
+	{
+		OnMemorySummaryCallFinished(call, action);
+		return;
+	}
+	if (CompletionCache && !call->IsFromCache)
+	{
+		CompletionCache->Add(call->CacheKey, action);
+		UpdateCacheStats();
+	}
+	if (UtteranceCache && !call->IsFromCache && !call->Utterance.IsEmpty())
+	{
+		UtteranceCache->Add(call->UtteranceContext, call->Utterance, action, FPlatformTime::Seconds());
+		UpdateCacheStats();
+	}
+	// Speculative calls hold on to their answer until we know whether they guessed right.
+	if (!call->IsSpeculative)
+	{
+		DispatchAction(call->Controller.Get(), action);
+	}
+}
+
+void ABartlebySystem::OnCallFailed(const TSharedRef<BartlebyCall>& call, bool wasParsingError)
+{
+	NumFailedCalls++;
+	if (wasParsingError)
+	{
+		NumParseFailures++;
+	}
+	Telemetry.Record(EBartlebyMetric::Retries, call->Retries);
+	ABartlebyController* controller = call->Controller.Get();
+	if (!controller)
+	{
+		return;
+	}
+	if (call->IsMemorySummary)
+	{
+		OnMemorySummaryCallFinished(call, FString());
+		return;
+	}
+	if (call->IsSpeculative)
+	{
+		// Nothing lost, the real call will just be made on arrival.
+		if (controller->PrefetchCall == call)
+		{
+			controller->PrefetchCall.Reset();
+		}
+		return;
+	}
+	controller->IsWaitingOnOpenAI = false;
+	if (wasParsingError)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Clearing the log, openAI failed."));
+		controller->Log.clear();
+		controller->LogRevision++;
+	}
+}
+
+void ABartlebySystem::OnStreamProgress(const TSharedRef<BartlebyCall>& call, TSharedRef<FBartlebyStreamParser> parser,
+	FBartlebyStreamBuffer& buffer)
+{
+	BARTLEBY_TRACE_SCOPE(OnStreamProgress);
+	FHttpResponsePtr response = call->Request->GetResponse();
+	// Only what came in since last time is copied, and only that is parsed.
+	if (!response || parser->WasDispatched() || call->IsCancelled || !buffer.Update())
+	{
+		return;
+	}
+	// An error isn't a stream, and is dealt with once it's all come in.
+	if (IsTransientStatus(response->GetResponseCode()))
+	{
+		return;
+	}
+	if (!parser->Feed(buffer.GetBody()))
+	{
+		return;
+	}
+	FString action;
+	parser->GetFirstAction(action);
+	parser->MarkDispatched();
+	RecordStreamedCall(*call, buffer.GetBody(), response->GetResponseCode());
+	// Streams don't come with usage, so there are no token counts.
+	RecordCallTelemetry(*call, buffer.GetBody().Num(), -1, -1);
+	OnCallSucceeded(call, action);
+	// We have what we need, so stop paying for the rest of the generation. Cancelling from inside the progress
+	// callback isn't safe, so do it on the next tick.
+	FHttpRequestPtr request = call->Request;
+	GetWorldTimerManager().SetTimerForNextTick([request]()
+		{
+			request->CancelRequest();
+		});
+}
+
+void ABartlebySystem::OnStreamComplete(const TSharedRef<BartlebyCall>& call, const TArray<uint8>* body, int32 status,
+	const FBartlebyRateLimitHeaders& limits, TSharedRef<FBartlebyStreamParser> parser)
+{
+	BARTLEBY_TRACE_SCOPE(OnStreamComplete);
+	UpdateRateLimits(*call, limits);
+	// If we already handed off an action, this is just the cancellation coming back.
+	if (parser->WasDispatched() || call->IsCancelled)
+	{
+		FinishCall(call);
+		return;
+	}
+	if (!body || IsTransientStatus(status))
+	{
+		float retryDelay = 0.0f;
+		if (body)
+		{
+			retryDelay = OnTransientError(status, limits);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("Streaming request failed."));
+		}
+		if (!TryRetryCall(call, retryDelay))
+		{
+			FinishCall(call);
+			OnCallFailed(call, false);
+		}
+		return;
+	}
+	FinishCall(call);
+	// The whole body is here now, so parse whatever is left.
+	parser->Feed(*body);
+	FString action;
+	parser->GetFirstAction(action);
+	if (parser->HasError() || action.IsEmpty())
+	{
+		OnCallFailed(call, true);
+		return;
+	}
+	parser->MarkDispatched();
+	if (call->Request && call->Request->GetResponse())
+	{
+		RecordStreamedCall(*call, *body, call->Request->GetResponse()->GetResponseCode());
+	}
+	RecordCallTelemetry(*call, body->Num(), -1, -1);
+	OnCallSucceeded(call, action);
+}
+void ABartlebySystem::RecordStreamedCall(const BartlebyCall& call, const TArray<uint8>& response, int32 status)
+{
+	if (!Recording || Transport != EBartlebyTransport::Record || !call.Request)
+	{
+		return;
+	}
+	// The answer is recorded up to where the action was handed off, which is all a replay needs.
+	const double now = FPlatformTime::Seconds();
+	const double firstByte = call.FirstByteTime > 0.0 ? call.FirstByteTime - call.SendTime : now - call.SendTime;
+	Recording->Append(call.Request->GetContent(), response, status, true, now - call.SendTime, firstByte);
+}
+void ABartlebySystem::RecordCall(const BartlebyCallResult& result)
+{
+	if (!Recording || Transport != EBartlebyTransport::Record || result.RecordedRequest.IsEmpty())
+	{
+		return;
+	}
+	// The whole answer shows up at once, so the first byte is as late as the last.
+	Recording->Append(result.RecordedRequest, result.RecordedResponse, result.Status, false, result.Latency, result.Latency);
+}
+void ABartlebySystem::ReplayCall(const TSharedRef<BartlebyCall>& call)
+{
+	BARTLEBY_TRACE_SCOPE(ReplayCall);
+	const FBartlebyRecordedCall* recorded = Recording ? Recording->Find(call->Body) : nullptr;
+	if (!recorded)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Nothing left in the recording to answer this call with."));
+	}
+	const int32 attempt = call->Attempt;
+	FTimerDelegate deliver = FTimerDelegate::CreateWeakLambda(this, [this, call, recorded, attempt]()
+		{
+			if (attempt == call->Attempt && !call->IsFinished)
+			{
+				DeliverReplayedCall(call, recorded);
+			}
+		});
+	const float delay = recorded ? recorded->Latency * FMath::Max(ReplayLatencyScale, 0.0f) : 0.0f;
+	if (delay > 0.0f)
+	{
+		FTimerHandle handle;
+		GetWorldTimerManager().SetTimer(handle, deliver, delay, false);
+	}
+	else
+	{
+		GetWorldTimerManager().SetTimerForNextTick(deliver);
+	}
+}
+void ABartlebySystem::DeliverReplayedCall(const TSharedRef<BartlebyCall>& call, const FBartlebyRecordedCall* recorded)
+{
+	BARTLEBY_TRACE_SCOPE(DeliverReplayedCall);
+	if (call->IsCancelled)
+	{
+		FinishCall(call);
+		return;
+	}
+	if (recorded)
+	{
+		call->FirstByteTime = call->SendTime + recorded->FirstByte * FMath::Max(ReplayLatencyScale, 0.0f);
+	}
+	// Whatever kind of call this is, the answer is handled the way it was recorded.
+	if (recorded && recorded->IsStreamed)
+	{
+		OnStreamComplete(call, &recorded->Response, recorded->Status, FBartlebyRateLimitHeaders(), MakeShared<FBartlebyStreamParser>());
+		return;
+	}
+	BartlebyCallResult result;
+	result.Call = call;
+	result.Attempt = call->Attempt;
+	if (recorded)
+	{
+		ReadResponse(recorded->Response, recorded->Status, LogResponseBodies, result);
+	}
+	else
+	{
+		result.WasConnectionError = true;
+	}
+	OnCallCompleted(result);
+}
+
+void ABartlebySystem::DispatchAction(ABartlebyController* controller, const FString& action)
+{
+	BARTLEBY_TRACE_SCOPE(DispatchAction);
+	if (!controller)
+	{
+		return;
+	}
+	controller->IsWaitingOnOpenAI = false;
+	controller->Log.push_back(BartlebyLogElement{ BartlebyLogType::Output, action, Tokenizer->CountMessageTokens(action),
+		GetNumMemories(controller) });
+	controller->LogRevision++;
+	controller->LastThingOpenAISaid = action;
+	Remember(controller, action);
+	controller->OnOpenAICallback(action);
+}
+
+void ABartlebySystem::UpdateCacheStats()
+{
+	if (CompletionCache)
+	{
+		CacheHits = CompletionCache->GetNumHits();
+		CacheMisses = CompletionCache->GetNumMisses();
+		CacheEvictions = CompletionCache->GetNumEvictions();
+		CacheEntriesOnDisk = CompletionCache->GetNumOnDisk();
+	}
+	if (UtteranceCache)
+	{
+		UtteranceCacheHits = UtteranceCache->GetNumHits();
+		UtteranceCacheMisses = UtteranceCache->GetNumMisses();
+		const int32 numLookups = UtteranceCacheHits + UtteranceCacheMisses;
+		UtteranceCacheHitRate = numLookups > 0 ? static_cast<float>(UtteranceCacheHits) / numLookups : 0.0f;
+	}
+}
+
+void ABartlebySystem::UpdateConnectionStats()
+{
+	WarmRequests = ConnectionManager->GetNumWarmRequests();
+	ColdRequests = ConnectionManager->GetNumColdRequests();
+	ConnectionReuseRatio = ConnectionManager->GetReuseRatio();
+	ColdPingTime = ConnectionManager->GetColdPingTime();
+	WarmPingTime = ConnectionManager->GetWarmPingTime();
+}
+
+void ABartlebySystem::UpdatePrefixStats(ABartlebyController* controller, const TArray<uint8>& body)
+{
+	// Count how much of this request is exactly the same as the last one, from the start.
+	const uint8* bytes = body.GetData();
+	const int32 length = body.Num();
+	const int32 maxMatch = FMath::Min(length, controller->LastRequestBody.Num());
+	int32 match = 0;
+	while (match < maxMatch && bytes[match] == controller->LastRequestBody[match])
+	{
+		match++;
+	}
+	controller->LastRequestBody.SetNumUninitialized(length);
+	FMemory::Memcpy(controller->LastRequestBody.GetData(), bytes, length);
+
+	controller->LastPrefixMatchBytes = match;
+	controller->LastPrefixMatchFraction = length > 0 ? static_cast<float>(match) / length : 0.0f;
+	TotalPrefixMatchFraction += controller->LastPrefixMatchFraction;
+	NumPrefixSamples++;
+	AveragePrefixMatchFraction = static_cast<float>(TotalPrefixMatchFraction / NumPrefixSamples);
+}
+
+FString ABartlebySystem::GetUtteranceCacheReport() const
+{
+	if (!UtteranceCache)
+	{
+		return "Utterance cache is off.";
+	}
+	return UtteranceCache->GetReport(UtteranceSimilarityThreshold);
+}
+
+FString ABartlebySystem::GetGuestSaid(const ABartlebyController* controller) const
+{
+	return controller && controller == InputController ? LastThingPlayerSaid : FString();
+}
+
+void ABartlebySystem::AppendMsg(const FString& append)
+{
+	AppendMsg(InputController ? InputController : (Controllers.Num() > 0 ? Controllers[0] : nullptr), append);
+}
+
+void ABartlebySystem::AppendMsg(ABartlebyController* controller, const FString& append)
+{
+	if (controller)
+	{
+		if (controller->AppendedMsg.IsEmpty())
+		{
+			controller->AppendedFirstMemory = GetNumMemories(controller);
+		}
+		controller->AppendedMsg += append;
+		if (append.StartsWith(TEXT("action_result:")))
+		{
+			Remember(controller, append);
+		}
+	}
+}
+
+void ABartlebySystem::AddLog(std::deque<BartlebyLogElement>& log, const FString& msg, int32 firstMemory, int32 fixedTokens,
+	const BartlebyPromptSettings& settings, TArray<FBartlebyMemoryEntry>* forgotten)
+{
+	BARTLEBY_TRACE_SCOPE(AddLog);
+	log.push_back(BartlebyLogElement{ BartlebyLogType::Prompt, msg, settings.Tokenizer->CountMessageTokens(msg), firstMemory });
+	if (settings.MaxPromptTokens <= 0)
+	{
+		// Remove the first element whenever we have too many!
+		if (log.size() > settings.MaxNumLogElements)
+		{
+			const int32 targetElements = settings.UseStablePrefix ?
+				FMath::Max(1, FMath::FloorToInt(settings.MaxNumLogElements * (1.0f - settings.LogEvictionChunk))) : settings.MaxNumLogElements;
+			while (log.size() > targetElements)
+			{
+				if (forgotten)
+				{
+					forgotten->Add({ log.front().Type == BartlebyLogType::Output, log.front().Content });
+				}
+				log.pop_front();
+			}
+		}
+		return;
+	}
+	// Remove elements from the front until everything fits in the budget. Always keep the newest one though.
+	int32 numTokens = fixedTokens + CountLogTokens(log);
+	if (numTokens <= settings.MaxPromptTokens)
+	{
+		return;
+	}
+	// With a stable prefix, make extra room while we're at it, so that the front of the log stays the same for a few turns.
+	const int32 targetTokens = settings.UseStablePrefix ?
+		FMath::FloorToInt(settings.MaxPromptTokens * (1.0f - settings.LogEvictionChunk)) : settings.MaxPromptTokens;
+	while (log.size() > 1 && numTokens > targetTokens)
+	{
+		numTokens -= log.front().NumTokens;
+		if (forgotten)
+		{
+			forgotten->Add({ log.front().Type == BartlebyLogType::Output, log.front().Content });
+		}
+		log.pop_front();
+	}
+}
+
+int32 ABartlebySystem::GetHelpTokens()
+{
+	// The first message hardly ever changes, so only build it and count it when something that goes in it does.
+	uint32 signature = HashCombine(GetTypeHash(HelpPrompt), GetTypeHash(UseStablePrefix));
+	if (UseStablePrefix)
+	{
+		signature = HashCombine(signature, HashCombine(GetTypeHash(GroundingPrompt), GetWorldSummarySignature()));
+	}
+	if (NumHelpTokens < 0 || signature != HelpSignature)
+	{
+		HelpSignature = signature;
+		NumHelpTokens = Tokenizer->CountMessageTokens(GenerateFirstMessage());
+	}
+	return NumHelpTokens;
+}
+
+int32 ABartlebySystem::CountPromptTokens(const std::deque<BartlebyLogElement>& log, int32 memoryTokens)
+{
+	BARTLEBY_TRACE_SCOPE(CountPromptTokens);
+	return FBartlebyTokenizer::TokensPerReply + GetHelpTokens() + memoryTokens + CountLogTokens(log);
+}
+
+int32 ABartlebySystem::CountLogTokens(const std::deque<BartlebyLogElement>& log)
+{
+	int32 numTokens = 0;
+	for (const auto& log_element : log)
+	{
+		numTokens += log_element.NumTokens;
+	}
+	return numTokens;
+}
+
+FString ABartlebySystem::GenerateMemoryString(const ABartlebyController* controller) const
+{
+	if (!UseMemorySummary || !controller || controller->MemorySummary.IsEmpty())
+	{
+		return FString();
+	}
+	return "\n" + MemoryPrompt + "\n" + controller->MemorySummary;
+}
+
+void ABartlebySystem::SummarizeMemory(ABartlebyController* controller)
+{
+	BARTLEBY_TRACE_SCOPE(SummarizeMemory);
+	if (controller->IsSummarizingMemory || controller->PendingMemory.Num() == 0)
+	{
+		return;
+	}
+	controller->IsSummarizingMemory = true;
+	TArray<FBartlebyMemoryEntry> entries = MoveTemp(controller->PendingMemory);
+	controller->PendingMemory.Reset();
+	if (MemorySummarizer == EBartlebyMemorySummarizer::AI)
+	{
+		SummarizeMemoryWithAI(controller, MoveTemp(entries));
+	}
+	else
+	{
+		SummarizeMemoryInBackground(controller, MoveTemp(entries));
+	}
+}
+
+void ABartlebySystem::SummarizeMemoryInBackground(ABartlebyController* controller, TArray<FBartlebyMemoryEntry>&& entries)
+{
+	TWeakObjectPtr<ABartlebySystem> weakThis = this;
+	TWeakObjectPtr<ABartlebyController> weakController = controller;
+	TSharedPtr<FBartlebyTokenizer> tokenizer = Tokenizer;
+	Async(EAsyncExecution::ThreadPool, [weakThis, weakController, tokenizer, entries = MoveTemp(entries),
+		summary = controller->MemorySummary, maxTokens = MaxMemoryTokens, guestSaidPrompt = GuestSaidPrompt]()
+		{
+			FString newSummary = FBartlebyMemorySummarizer::Summarize(summary, entries, maxTokens, guestSaidPrompt, tokenizer.Get());
+			AsyncTask(ENamedThreads::GameThread, [weakThis, weakController, newSummary = MoveTemp(newSummary)]()
+				{
+					if (weakThis.IsValid() && weakController.IsValid())
+					{
+						weakThis->OnMemorySummarized(weakController.Get(), newSummary);
+					}
+				});
+		});
+}
+
+void ABartlebySystem::SummarizeMemoryWithAI(ABartlebyController* controller, TArray<FBartlebyMemoryEntry>&& entries)
+{
+	BARTLEBY_TRACE_SCOPE(SummarizeMemoryWithAI);
+	// It goes through the scheduler like any other call, so it keeps to the rate limit, is retried, recorded and
+	// replayed, and shows up in the telemetry.
+	TSharedRef<BartlebyCall> call = MakeShared<BartlebyCall>();
+	call->Controller = controller;
+	call->IsMemorySummary = true;
+	call->IsBuilt = true;
+	FBartlebyMemorySummarizer::WriteSummaryRequest(call->Body, SummaryModel, SummaryPrompt, controller->MemorySummary,
+		entries, MaxMemoryTokens);
+	call->EstimatedTokens = Tokenizer->CountTokens(SummaryPrompt) + Tokenizer->CountTokens(controller->MemorySummary) + MaxMemoryTokens;
+	for (const FBartlebyMemoryEntry& entry : entries)
+	{
+		call->EstimatedTokens += Tokenizer->CountTokens(entry.Text);
+	}
+	call->Forgotten = MoveTemp(entries);
+	EnqueueCall(call);
+}
+
+void ABartlebySystem::OnMemorySummaryCallFinished(const TSharedRef<BartlebyCall>& call, const FString& summary)
+{
+	ABartlebyController* controller = call->Controller.Get();
+	if (!controller)
+	{
+		return;
+	}
+	if (summary.TrimStartAndEnd().IsEmpty())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't get a memory summary from the AI, so making one locally instead."));
+		SummarizeMemoryInBackground(controller, MoveTemp(call->Forgotten));
+		return;
+	}
+	// The AI doesn't always stay under the limit it was given.
+	OnMemorySummarized(controller, FBartlebyMemorySummarizer::Trim(summary, MaxMemoryTokens, Tokenizer.Get()));
+}
+
+void ABartlebySystem::OnMemorySummarized(ABartlebyController* controller, const FString& summary)
+{
+	BARTLEBY_TRACE_SCOPE(OnMemorySummarized);
+	controller->MemorySummary = summary;
+	controller->MemorySummaryTokens = summary.IsEmpty() ? 0 : Tokenizer->CountTokens(GenerateMemoryString(controller));
+	controller->IsSummarizingMemory = false;
+	NumMemorySummaries++;
+	// More of the log may have fallen off while this summary was being made.
+	SummarizeMemory(controller);
+}
+
+int32 ABartlebySystem::GetNumMemories(const ABartlebyController* controller) const
+{
+	return controller->EpisodicMemory ? controller->EpisodicMemory->Num() : 0;
+}
+
+void ABartlebySystem::Remember(ABartlebyController* controller, const FString& text)
+{
+	if (!controller->EpisodicMemory)
+	{
+		return;
+	}
+	BARTLEBY_TRACE_SCOPE(Remember);
+	const FString where = controller->CurrentRoom ? "in " + controller->CurrentRoom->Id + ": " : FString();
+	controller->EpisodicMemory->Add(where + text);
+}
+
+FString ABartlebySystem::GenerateRecallString(ABartlebyController* controller)
+{
+	if (!controller->EpisodicMemory || RecallCount <= 0 || !controller->CurrentRoom)
+	{
+		return FString();
+	}
+	BARTLEBY_TRACE_SCOPE(GenerateRecallString);
+	// Look for what happened here, with these things, or about what the guest is talking about.
+	FString query = controller->CurrentRoom->Id;
+	for (const UBartlebyObject* object : controller->CurrentRoom->Objects)
+	{
+		if (object)
+		{
+			query += " " + object->Id;
+		}
+	}
+	query += " " + GetGuestSaid(controller);
+	// Whatever is still in the log doesn't need remembering: everything remembered since its oldest element was added.
+	const int32 numInLog = controller->Log.empty() ? 0 :
+		FMath::Max(0, controller->EpisodicMemory->Num() - controller->Log.front().FirstMemory);
+	TArray<FBartlebyEpisodicMemory::FRecall> recalls;
+	controller->EpisodicMemory->Query(query, RecallCount, numInLog, recalls);
+	if (recalls.Num() == 0)
+	{
+		return FString();
+	}
+	FString recalled = "\n" + RecallPrompt;
+	for (const FBartlebyEpisodicMemory::FRecall& recall : recalls)
+	{
+		recalled += "\n- " + controller->EpisodicMemory->Get(recall.Index);
+	}
+	return recalled;
+}
@@ -27,6 +27,14 @@ SOFTWARE.
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Misc/SecureHash.h"
+#include "Containers/Queue.h"
+#include "Bartleby/BartlebyTelemetry.h"
+#include "Bartleby/BartlebyTransport.h"
+#include "Bartleby/BartlebyMemory.h"
+#include "Bartleby/BartlebyRateLimiter.h"
+#include "Bartleby/BartlebyStatusSnapshot.h"
 #include "BartlebySystem.generated.h"
 
 class UBartlebyInput;
@@ -45,8 +53,10 @@ public:
 		FString Description = "door";
 };
 class ABartlebyRoom;
+class ABartlebyController;
 
-// Implements the Bartleby system. Keeps track of a single AI, a collection of rooms, and a collection of objects.
+// Implements the Bartleby system. Keeps track of any number of AIs, a collection of rooms, and a collection of objects.
+// All of the AIs share a single scheduler for their calls to OpenAI.
 UCLASS()
 class BARTLEBY_API ABartlebySystem : public AActor
 {
@@ -59,11 +69,21 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
-	class ABartlebyController* Controller = nullptr;
+
+	// Every AI controller the system knows about. Each one keeps its own log and memory.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Bartleby")
+		TArray<ABartlebyController*> Controllers;
+
+	// Adds a controller to the system. Called by the controller when it begins play.
+	void RegisterController(ABartlebyController* controller);
+
+	// Removes a controller from the system, dropping any calls it was waiting on.
+	void UnregisterController(ABartlebyController* controller);
 	
 	// Causes the actor to say the given text, with the given title text.
 	UFUNCTION(BlueprintCallable)
@@ -81,19 +101,71 @@ public:
 	UPROPERTY(BlueprintReadWrite, VisibleAnywhere, Category = "Bartleby")
 		TArray<ABartlebyRoom*> Rooms;
 
-	// List of doors the system knows about.
+	// List of doors the system knows about. Rooms that touch get doors of their own if UseAutoDoors is on.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Bartleby")
 		TArray<FDoor> Doors;
 
-	// Gets the room with the given ID, or null otherwise.
+	// Adds doors between rooms whose boxes touch along a wall, and that can be walked between on the navmesh.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Doors")
+		bool UseAutoDoors = true;
+
+	// How far apart, in centimeters, two room boxes can be and still count as touching.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Doors")
+		float AutoDoorGap = 50.0f;
+
+	// How long the wall two room boxes share has to be, in centimeters, to get a door. Keeps rooms that only meet at
+	// a corner apart.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Doors")
+		float AutoDoorMinWidth = 150.0f;
+
+	// How much longer than a straight line the walk between two touching rooms can be for them to get a door. A wall
+	// without an opening makes the walk go around. Zero skips the navmesh, as does not having one.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Doors")
+		float AutoDoorMaxDetour = 2.0f;
+
+	// Number of doors between rooms, counting the ones added by UseAutoDoors.
+	UPROPERTY(BlueprintReadOnly, VisibleAnywhere, Category = "Doors")
+		int32 NumDoors = 0;
+
+	// Call this if rooms or doors change after the game starts, so that the map of which room connects to which is
+	// rebuilt. Rooms and doors being added is noticed on its own.
+	UFUNCTION(BlueprintCallable, Category = "Doors")
+		void InvalidateRoomGraph();
+
+	// Finds the way from one room to another through the fewest doors, not counting the first room. Returns false if
+	// there is no way.
+	UFUNCTION(BlueprintCallable, Category = "Doors")
+		bool FindRoute(ABartlebyRoom* from, ABartlebyRoom* to, TArray<ABartlebyRoom*>& route);
+
+	// Gets the room with the given ID, or the closest to it, or null if none is close enough.
 	UFUNCTION(BlueprintCallable)
 		ABartlebyRoom* GetRoomOrNull(const FString& id);
 
-	// Gets the room containing the given position, or null otherwise.
+	// Like GetRoomOrNull, but also says how sure it is of the match, from 0 to 1.
+	UFUNCTION(BlueprintCallable)
+		ABartlebyRoom* FindRoomOrNull(const FString& id, float& confidence);
+
+	// How sure a match for a room or object the AI named has to be. IDs containing what it said always are.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Bartleby")
+		float MinIdConfidence = 0.6f;
+
+	// Call this if the ID of a room or object changes, so that they can be found by it right away. Otherwise rooms can
+	// be found by their new IDs after the next tick, and objects the next time they're looked up.
+	UFUNCTION(BlueprintCallable)
+		void InvalidateIdIndex();
+
+	// Gets the room containing the given position, or null otherwise. If rooms overlap, the first in Rooms wins.
 	UFUNCTION(BlueprintCallable)
 		ABartlebyRoom* GetRoomAtOrNull(const FVector& pos);
 
-	// Gets the doors adjacent to the given room ID.
+	// Indexes the rooms and finds the doors between them up front, so that the first calls don't have to.
+	void PrepareRooms();
+
+	// Call this if a room's box changes size, so that GetRoomAtOrNull sees it. Moving a room is noticed on its own.
+	UFUNCTION(BlueprintCallable)
+		void InvalidateRoomIndex();
+
+	// Gets the doors adjacent to the given room ID: the ones in Doors as they were placed, then the ones found touching.
 	UFUNCTION(BlueprintCallable)
 		TArray<FDoor> GetDoorsAt(const FString& roomId);
 
@@ -109,17 +181,17 @@ public:
 	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
 		bool IsWaitingOnInput = false;
 
-	// If true, the system is waiting on OpenAI to say something.
+	// Stores the last thing that the player inputted. It was said to InputController.
 	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
-		bool IsWaitingOnOpenAI = false;
+		FString LastThingPlayerSaid;
 
-	// Stores the last thing that the OpenAI system returned.
-	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
-		FString LastThingOpenAISaid = "";
+	// The controller that last said something, and so is waiting on the player to answer.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly)
+		ABartlebyController* InputController = nullptr;
 
-	// Stores the last thing that the player inputted.
-	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly)
-		FString LastThingPlayerSaid;
+	// Gets the last thing the player said to the given controller, or nothing if they're talking to another one.
+	UFUNCTION(BlueprintCallable)
+		FString GetGuestSaid(const ABartlebyController* controller) const;
 
 	// Called when the "Say" function is done.
 	UFUNCTION()
@@ -170,10 +242,6 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
 		FString OpenAiKey = "ENTER_YOUR_OPENAI_KEY_HERE";
 
-	// Stores the last prompt that was given to the AI.
-	UPROPERTY(BlueprintReadWrite, VisibleInstanceOnly, Category = "Prompt")
-		FString LastFullPrompt = "";
-
 	// Temperature parameter. Higher numbers are noisier and funnier. Lower numbers are more predictable and likely helpful.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
 		double Temperature = 0.4;
@@ -182,8 +250,382 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
 		FString Model = "gpt-3.5-turbo";
 
-	// Kicks off a call to the OpenAI system in the background.
-	void StartOpenAICall();
+	// If true, asks the API to stream the completion back. As soon as the first complete action line arrives it is
+	// handed to the controller, and the rest of the generation is cancelled.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
+		bool UseStreaming = false;
+
+	// If true, starts the next call to the AI while the controller is still walking, using a guess of what the status
+	// will be on arrival. The answer is only used if the guess turns out to be right, otherwise it costs an extra call.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
+		bool UsePrefetch = false;
+
+	// If true, every response from the AI is written to the log in full. Useful for debugging, but slow and noisy.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
+		bool LogResponseBodies = false;
+
+	// Prompt tokens the API says it has billed for so far.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "API")
+		int64 PromptTokensUsed = 0;
+
+	// Completion tokens the API says it has billed for so far.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "API")
+		int64 CompletionTokensUsed = 0;
+
+	// Number of prefetched calls whose prediction matched on arrival.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "API")
+		int32 PrefetchHits = 0;
+
+	// Number of prefetched calls that were thrown away because the prediction was wrong.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "API")
+		int32 PrefetchMisses = 0;
+
+	// Most calls to the AI that can be in flight at once. The rest wait in line.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Scheduler")
+		int32 MaxConcurrentRequests = 4;
+
+	// Calls are sent in order of how close their AI is to a player. Every second a call waits in line, it is treated as
+	// being this much (in cm) closer, so that far away AIs still get a turn.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Scheduler")
+		float PriorityAgingSpeed = 500.0f;
+
+	// Speculative calls are treated as being this much (in cm) further away than they are.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Scheduler")
+		float SpeculativePriorityPenalty = 100000.0f;
+
+	// A call that waits in line longer than this many seconds counts as starved.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Scheduler")
+		float StarvationTime = 5.0f;
+
+	// Number of calls waiting in line.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Scheduler")
+		int32 NumQueuedRequests = 0;
+
+	// Number of calls currently being answered.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Scheduler")
+		int32 NumInFlightRequests = 0;
+
+	// Number of calls that waited in line longer than StarvationTime.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Scheduler")
+		int32 NumStarvedRequests = 0;
+
+	// Average time in seconds that calls waited in line.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Scheduler")
+		float AverageQueueWait = 0.0f;
+
+	// Longest time in seconds that a call waited in line.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Scheduler")
+		float MaxQueueWait = 0.0f;
+
+	// Seconds to wait for an answer before giving up on a request. Zero waits forever.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		float RequestTimeout = 30.0f;
+
+	// Times a call is tried again after it times out or can't connect, before the controller is told it failed.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		int32 MaxRetries = 2;
+
+	// Seconds to wait before the first retry. Each retry after that waits twice as long, give or take some jitter.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		float RetryBaseDelay = 0.5f;
+
+	// Longest wait between retries, in seconds.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		float RetryMaxDelay = 8.0f;
+
+	// If true, a call that takes longer than LatencyP95 gets a second, identical request. Whichever answers first is
+	// used, and the other is cancelled. This cuts down on slow outliers, for the cost of a few duplicate calls.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		bool UseHedging = false;
+
+	// Number of answers to time before hedging starts, so LatencyP95 means something.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Retry")
+		int32 HedgingMinSamples = 20;
+
+	// 95% of recent calls were answered within this many seconds.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Retry")
+		float LatencyP95 = 0.0f;
+
+	// Number of requests that ran out of time.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Retry")
+		int32 NumTimeouts = 0;
+
+	// Number of times a call was tried again.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Retry")
+		int32 NumRetries = 0;
+
+	// Number of duplicate requests sent for slow calls.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Retry")
+		int32 NumHedgedRequests = 0;
+
+	// Number of times the duplicate request answered first.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Retry")
+		int32 NumHedgeWins = 0;
+
+	// If true, calls wait in line until the server's rate limit has room for them, instead of going out and being turned
+	// away. How much room is left comes from the x-ratelimit headers of every answer.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Rate Limit")
+		bool UseRateLimiting = true;
+
+	// Requests and tokens per minute to assume until the server says what its limits are. Zero doesn't hold anything
+	// back until then.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Rate Limit")
+		int32 RequestsPerMinute = 0;
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Rate Limit")
+		int32 TokensPerMinute = 0;
+
+	// Tokens to count against the limit for the answer, on top of the prompt, since it isn't known before it comes back.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Rate Limit")
+		int32 ExpectedCompletionTokens = 100;
+
+	// What the server last said was left of its limits, less what's been sent since. -1 if it hasn't said.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		int32 RemainingRequests = -1;
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		int32 RemainingTokens = -1;
+
+	// Seconds until the next call in line fits in the rate limit, or zero if nothing is waiting on it.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		float RateLimitWait = 0.0f;
+
+	// Number of calls that had to wait for room in the rate limit.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		int32 NumPacedRequests = 0;
+
+	// Number of times the server turned a request away for going over the rate limit (HTTP 429).
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		int32 NumRateLimitedResponses = 0;
+
+	// Number of times the server had trouble of its own (HTTP 5xx).
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Rate Limit")
+		int32 NumServerErrors = 0;
+
+	// Number of calls that failed for good, after any retries.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Telemetry")
+		int32 NumFailedCalls = 0;
+
+	// Number of answers from the AI that couldn't be parsed.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Telemetry")
+		int32 NumParseFailures = 0;
+
+	// Seconds between writing the telemetry out to TelemetryFile, as .csv (a row per metric, appended) and .json (the
+	// latest numbers). Zero only writes it at the end of play.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Telemetry")
+		float TelemetryDumpInterval = 60.0f;
+
+	// Where to write the telemetry, relative to the project's Saved directory, without the extension. Leave empty to not
+	// write it at all.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Telemetry")
+		FString TelemetryFile = "Bartleby/Telemetry";
+
+	// Gets the value of the metric that the given percent (0 to 100) of calls came in under, e.g. 95 for p95.
+	UFUNCTION(BlueprintCallable, Category = "Telemetry")
+		float GetCallMetricPercentile(EBartlebyMetric metric, float percent) const;
+
+	// Gets the number of calls the metric was measured for.
+	UFUNCTION(BlueprintCallable, Category = "Telemetry")
+		int32 GetCallMetricCount(EBartlebyMetric metric) const;
+
+	// Writes the telemetry out to TelemetryFile now.
+	UFUNCTION(BlueprintCallable, Category = "Telemetry")
+		void DumpTelemetry();
+
+	// Whether calls go to the AI, go to the AI and get recorded, or get played back from a recording.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Transport")
+		EBartlebyTransport Transport = EBartlebyTransport::Live;
+
+	// Where calls are recorded to and replayed from, relative to the project's Saved directory.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Transport")
+		FString RecordingFile = "Bartleby/Recording.jsonl";
+
+	// Replayed answers take this many times as long as they did when they were recorded. 0 answers right away.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Transport")
+		float ReplayLatencyScale = 1.0f;
+
+	// Number of calls written to the recording.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Transport")
+		int32 NumRecordedCalls = 0;
+
+	// Number of calls answered from the recording, and how many of those had to use a different request's answer.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Transport")
+		int32 NumReplayedCalls = 0;
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Transport")
+		int32 NumReplayFallbacks = 0;
+
+	// If true, opens a connection to the AI's server as soon as play starts, so the first call doesn't have to wait for
+	// one to be set up, and pings the server now and then so it doesn't close the connection while we're idle. Nothing
+	// is sent while IsEnabled is off. Off by default, since the pings are requests of their own.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Connection")
+		bool UseConnectionWarming = false;
+
+	// Seconds of quiet before the server is pinged to keep the connection open.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Connection")
+		float KeepAliveInterval = 20.0f;
+
+	// Number of calls that went out while the connection should have been open.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Connection")
+		int32 WarmRequests = 0;
+
+	// Number of calls that had to open a new connection first.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Connection")
+		int32 ColdRequests = 0;
+
+	// Fraction of calls that reused an open connection.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Connection")
+		float ConnectionReuseRatio = 0.0f;
+
+	// Seconds it took to warm up the connection at the start, including DNS, TCP and TLS.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Connection")
+		float ColdPingTime = 0.0f;
+
+	// Average seconds for a ping over an open connection.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Connection")
+		float WarmPingTime = 0.0f;
+
+	// If true, remembers what the AI said for every request, and answers the exact same request again without calling
+	// the AI at all.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache")
+		bool UseCompletionCache = false;
+
+	// Number of answers the cache keeps in memory. Everything else is read back from disk.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache")
+		int32 CompletionCacheMemoryEntries = 256;
+
+	// Where the cache is kept on disk, relative to the project's Saved directory.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache")
+		FString CompletionCacheFile = "Bartleby/CompletionCache.bin";
+
+	// Number of requests answered from the cache.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 CacheHits = 0;
+
+	// Number of requests that had to go to the AI.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 CacheMisses = 0;
+
+	// Number of answers pushed out of memory to make room. They can still be found on disk.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 CacheEvictions = 0;
+
+	// Number of answers stored on disk.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 CacheEntriesOnDisk = 0;
+
+	// If true, remembers how the AI answered what guests said. When a guest says something similar enough in the same
+	// room, with the same objects around, they get the same answer without calling the AI.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache")
+		bool UseUtteranceCache = false;
+
+	// How similar (0 to 1) what a guest said has to be to something said before to reuse the answer.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float UtteranceSimilarityThreshold = 0.75f;
+
+	// How long in seconds an answer to a guest is remembered.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Cache")
+		float UtteranceCacheTimeToLive = 3600.0f;
+
+	// Number of things guests said that were answered from the utterance cache.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 UtteranceCacheHits = 0;
+
+	// Number of things guests said that had to go to the AI.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		int32 UtteranceCacheMisses = 0;
+
+	// Fraction of things guests said that were answered from the utterance cache.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Cache")
+		float UtteranceCacheHitRate = 0.0f;
+
+	// Gets a report of how the utterance cache is doing, for tuning the threshold.
+	UFUNCTION(BlueprintCallable, Category = "Cache")
+		FString GetUtteranceCacheReport() const;
+
+	// If true, lays the prompt out so that consecutive requests share as long a prefix as possible, which makes them
+	// cheaper and faster on backends with prompt caching. The persona, help and a map of the world go in the first
+	// message, the status only goes at the end, and the log is trimmed in chunks instead of one element at a time.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Prompt")
+		bool UseStablePrefix = false;
+
+	// With a stable prefix, the fraction of the log budget that is freed up whenever the log gets too long.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Prompt", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float LogEvictionChunk = 0.5f;
+
+	// If true, the game thread only takes a snapshot of what each AI sees, and the prompts and request bodies are
+	// built from the snapshots on worker threads, all of a frame's calls at once. Calls go out a frame later, and any
+	// that find the log changed in the meantime are built again.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Prompt")
+		bool BuildPromptsInBackground = false;
+
+	// Number of calls that had to be built again because the log changed while they were being built.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		int32 NumStaleCommits = 0;
+
+	// On average, the fraction of each request that was exactly the same as the last one from the same controller.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Prompt")
+		float AveragePrefixMatchFraction = 0.0f;
+
+	// If true, log elements that no longer fit in the prompt are folded into a short summary that goes in the first
+	// message, instead of being forgotten. The summary is made in the background, and only changes when something
+	// falls off the log, so it doesn't break up the stable prefix much.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		bool UseMemorySummary = false;
+
+	// How the summary is made: locally, or by asking the AI.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		EBartlebyMemorySummarizer MemorySummarizer = EBartlebyMemorySummarizer::Extractive;
+
+	// Most tokens the summary can take up. It comes out of MaxPromptTokens, so a bigger summary means a shorter log.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		int32 MaxMemoryTokens = 300;
+
+	// Goes in front of the summary in the prompt.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		FString MemoryPrompt = "MEMORY (what happened before the messages below):";
+
+	// Model used to write the summary, if MemorySummarizer is AI. A cheap one is fine.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		FString SummaryModel = "gpt-3.5-turbo";
+
+	// Tells the AI how to write the summary, if MemorySummarizer is AI.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		FString SummaryPrompt = "You are keeping the memory of a museum tour guide. Rewrite the summary so that it also "
+		"covers the new events. The first line must be rooms_visited=[...] with every room id visited, then one short "
+		"fact per line starting with \"- \": what guests said, what you told them, and what you saw. Drop the least "
+		"important facts to keep it short. Answer with only the summary.";
+
+	// Number of times a summary was made.
+	UPROPERTY(BlueprintReadOnly, VisibleInstanceOnly, Category = "Memory")
+		int32 NumMemorySummaries = 0;
+
+	// If true, every action, action result and thing a guest said is remembered for good, and the memories that best
+	// match the AI's room, the objects around it and what the guest said are added to the status.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		bool UseEpisodicMemory = false;
+
+	// Where each AI's memories are kept between sessions, relative to the project's Saved directory. Each AI gets a
+	// file named after its pawn.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		FString EpisodicMemoryDirectory = "Bartleby/Memory";
+
+	// Most memories added to the status at once.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		int32 RecallCount = 3;
+
+	// Goes in front of the memories in the status.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Memory")
+		FString RecallPrompt = "You remember:";
+
+	// Call this if rooms or doors change, so the map of the world in the stable prefix is rebuilt right away. Otherwise
+	// it's rebuilt after the next tick.
+	UFUNCTION(BlueprintCallable, Category = "Prompt")
+		void InvalidateWorldSummary();
+
+	// Kicks off a call to the OpenAI system in the background for the given controller.
+	void StartOpenAICall(ABartlebyController* controller);
+
+	// Kicks off a speculative call for when the controller arrives at the given position. arrivalMsg is whatever will
+	// be appended to the next message once it gets there.
+	void PrefetchOpenAICall(ABartlebyController* controller, const FVector& arrivalPos, const FString& arrivalMsg);
 
 	// Type of data to send to OpenAI.
 	enum class BartlebyLogType
@@ -197,38 +639,395 @@ public:
 	{
 		BartlebyLogType Type;
 		FString Content;
+		// Number of tokens this element takes up, counted once when it is added.
+		int32 NumTokens = 0;
+		// Number of memories in the controller's episodic memory before this element's were added. Anything remembered
+		// from there on is still in the log while this element is.
+		int32 FirstMemory = 0;
+	};
+	// A single call to the AI. Speculative calls are made ahead of time, and only become real once it turns out they
+	// guessed the status right.
+	struct BartlebyCall
+	{
+		// The AI that made the call.
+		TWeakObjectPtr<ABartlebyController> Controller;
+		FHttpRequestPtr Request;
+		// What the log will look like once this call is committed.
+		std::deque<BartlebyLogElement> Log;
+		// Revision of the log this call was built from.
+		int32 BaseLogRevision = 0;
+		// Number of memories before the appended messages were remembered, and when the call was made. They go with the
+		// log elements the call adds.
+		int32 AppendedFirstMemory = 0;
+		int32 FirstMemory = 0;
+		// The appended messages and the snapshot of the world this call was built from.
+		FString Appended;
+		FBartlebyStatusSnapshot Snapshot;
+		// Memories recalled for the status, and the first message with the memory summary, gathered along with the
+		// snapshot.
+		FString Recall;
+		FString FirstMessage;
+		// Tokens the prompt takes up besides the log: the first message, and priming the reply.
+		int32 FixedTokens = 0;
+		// The status and prompt, once built.
+		FString Status;
+		FString FullPrompt;
+		// The JSON that gets sent as UTF-8, and its key in the completion cache. The body is moved into the request once
+		// it is sent.
+		TArray<uint8> Body;
+		FSHAHash CacheKey;
+		// What the guest said, and where, if they said anything.
+		FString Utterance;
+		FString UtteranceContext;
+		bool IsStreaming = false;
+		bool IsFromCache = false;
+		bool IsSpeculative = false;
+		// True if this asks the AI for a new memory summary, rather than for what to do next.
+		bool IsMemorySummary = false;
+		bool IsCancelled = false;
+		bool IsComplete = false;
+		// True once the request is no longer taking up a slot in the scheduler.
+		bool IsFinished = false;
+		// True once the prompt and body have been built from the snapshot.
+		bool IsBuilt = false;
+		// When the call got in line.
+		double EnqueueTime = 0.0;
+		// Bumped every time a try is given up on, so that late answers to it are ignored.
+		int32 Attempt = 0;
+		// Number of times this call has been tried again.
+		int32 Retries = 0;
+		// Requests of the current try that haven't answered yet. Two if it was hedged.
+		int32 NumOutstanding = 0;
+		// When the current try was sent, and when its answer started coming in.
+		double SendTime = 0.0;
+		double FirstByteTime = 0.0;
+		// Not sent before this time, to back off between retries.
+		double NotBefore = 0.0;
+		// Tokens the call is expected to use up, prompt and answer, to check against the rate limit.
+		int32 EstimatedTokens = 0;
+		// What the call's requests took out of the rate limit, until it finishes.
+		int32 ReservedRequests = 0;
+		int32 ReservedTokens = 0;
+		// True once the call has had to wait for room in the rate limit.
+		bool WasPaced = false;
+		// The duplicate request sent when the first one is slow, if any.
+		FHttpRequestPtr HedgeRequest;
+		// What the AI said, once complete.
+		FString Result;
+		// Log elements that fell off the front of the log, to be added to the memory summary once committed. For a memory
+		// summary, the entries it's made from, in case it has to be made locally after all.
+		TArray<FBartlebyMemoryEntry> Forgotten;
+	};
+	// What came back for a call. Built on the HTTP thread, and handed to the controller to dispatch.
+	struct BartlebyCallResult
+	{
+		TSharedPtr<BartlebyCall> Call;
+		// Which try of the call this answers, and whether it was the duplicate request.
+		int32 Attempt = 0;
+		bool IsHedge = false;
+		// The first action the AI said, if the call succeeded. All of what it said, for a memory summary.
+		FString Action;
+		bool Succeeded = false;
+		// True if the AI answered, but with garbage.
+		bool WasParsingError = false;
+		// True if the AI couldn't be reached at all.
+		bool WasConnectionError = false;
+		// True if the server turned the request away for now: too many requests (429), or trouble of its own (5xx).
+		// Neither says anything about the prompt.
+		bool WasRateLimited = false;
+		bool WasServerError = false;
+		// HTTP status of the response, or 0 if there wasn't one.
+		int32 Status = 0;
+		// What the response said about the rate limits.
+		FBartlebyRateLimitHeaders RateLimits;
+		// Tokens billed for the call, from the response, or -1 if it didn't say.
+		int32 PromptTokens = -1;
+		int32 CompletionTokens = -1;
+		// Size of the response body.
+		int32 ResponseBytes = 0;
+		// The request and response as they went over the wire, and how long the response took, kept only when calls
+		// are being recorded.
+		TArray<uint8> RecordedRequest;
+		TArray<uint8> RecordedResponse;
+		float Latency = 0.0f;
 	};
+	// Everything prompts are built with besides the call itself, copied so that they can be built on any thread.
+	struct BartlebyPromptSettings
+	{
+		FString GroundingPrompt;
+		FString HelpPrompt;
+		FString SeeGuestPrompt;
+		FString GuestSaidPrompt;
+		FString Model;
+		double Temperature = 0.0;
+		bool UseStablePrefix = false;
+		int32 MaxPromptTokens = 0;
+		int32 MaxNumLogElements = 0;
+		float LogEvictionChunk = 0.0f;
+		// True if what falls off the log is kept for the memory summary.
+		bool KeepForgotten = false;
+		int32 ExpectedCompletionTokens = 0;
+		int32 BodySizeHint = 0;
+		TSharedPtr<class FBartlebyTokenizer> Tokenizer;
+	};
+	// Results waiting for a controller to pick them up. The call, its prefetch, its hedge and its retries can all finish
+	// at once on different HTTP threads, so any thread may add to it. Only the game thread takes from it.
+	typedef TQueue<BartlebyCallResult, EQueueMode::Mpsc> BartlebyResultQueue;
+	// Dispatches a result the controller took out of its queue. Must be called on the game thread.
+	void OnCallCompleted(const BartlebyCallResult& result);
 	// Keep around this many log elements as "memory". Can't be much higher, because of the token limit of ChatGPT.
+	// Only used if MaxPromptTokens is zero.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
 		int32 MaxNumLogElements = 8;
 
+	// Keep around as many log elements as fit in this many tokens, counting the help string. Leave room in the model's
+	// context for the reply. Set to zero to use MaxNumLogElements instead.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
+		int32 MaxPromptTokens = 3000;
+
+	// The token vocabulary (cl100k_base.tiktoken from OpenAI), relative to the project's Content directory. In packaged
+	// builds, add its directory to "Additional Non-Asset Directories to Package".
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "API")
+		FString TokenizerRanksFile = "Bartleby/cl100k_base.tiktoken";
+
+	// Writes the JSON body of a request to the AI straight into the given UTF-8 buffer, replacing what was there. The
+	// size hint is how many bytes to reserve up front.
+	static void WriteRequestBody(TArray<uint8>& out, const FString& model, double temperature, bool stream,
+		const FString& firstMessage, const std::deque<BartlebyLogElement>& log, int32 sizeHint);
+
 	// Appends the given user message to the list of messages. This is used for feedback for actions, for example. Exactly
-	// one message will be generated by these, so this is just string concat.
+	// one message will be generated by these, so this is just string concat. Goes to the controller the player is
+	// talking to, or the first one if they aren't talking to any.
 	UFUNCTION(BlueprintCallable)
 		void AppendMsg(const FString& lastMsg);
 
+	// Appends the given user message to the given controller's next message.
+	void AppendMsg(ABartlebyController* controller, const FString& lastMsg);
+
 private:
+	// Lets the benchmarks time the private functions that build prompts.
+	friend struct FBartlebyBenchmarkAccess;
 	// Creates the "Help" text that is sent to the AI.
 	FString GenerateHelpString();
-	// Creates the "status" text that is sent to the AI.
-	FString GenerateStatusString();
-	// Generates a prompt to send to the AI.
-	FString GeneratePrompt(bool askForHelp);
-	// Generates a list of things for the AI to see.
-	FString GenerateYouSeeString();
-	// Generates a list of nearby doors.
-	FString GenerateDoorsString();
-	// Generates a list of recent places the AI has been.
-	FString GenerateRecentPlacesString();
-	// Adds the given log message to the list.
-	void AddLog(const FString& log);
-	// A circular buffer of log messages. Log messages are removed from the front of the list
-	// when we exceed MaxNumLogElements.
-	std::deque<BartlebyLogElement> Log;
+	// Copies what the controller sees into a snapshot that the status is written from.
+	FBartlebyStatusSnapshot CaptureStatus(ABartlebyController* controller);
+	// Copies what the controller would see if it were at the given position.
+	FBartlebyStatusSnapshot CaptureStatus(ABartlebyController* controller, const FVector& pos);
+	// Starts the next call from a snapshot of what the controller sees, or goes on with the prefetched one if it would
+	// say the same thing.
+	void StartOpenAICall(ABartlebyController* controller, FBartlebyStatusSnapshot&& snapshot);
+	// Copies the settings prompts are built with.
+	BartlebyPromptSettings MakePromptSettings() const;
+	// Generates a prompt to send to the AI. Safe to call from any thread.
+	static FString GeneratePrompt(const BartlebyPromptSettings& settings, bool askForHelp, const FString& status);
+	// Generates a list of the rooms next to the given room.
+	FString GenerateDoorsString(const FString& roomId);
+	// Generates a map of every room and where you can go from it.
+	FString GenerateWorldSummaryString();
+	// Identifies the state of the world the map was built from, building the map of which room connects to which if
+	// needed.
+	uint32 GetWorldSummarySignature();
+	// Hashes the rooms, their IDs and the doors.
+	uint32 ComputeWorldSignature() const;
+	// Bumps WorldRevision if the rooms or doors changed since it was last called.
+	void CheckWorldChanged();
+	// Generates the first message of every request: just the help string, or the whole stable prefix.
+	FString GenerateFirstMessage();
+	// Measures how much of the body is the same as the controller's last request.
+	void UpdatePrefixStats(ABartlebyController* controller, const TArray<uint8>& body);
+	// Adds the given log message to the list, leaving room for the given number of tokens that go in front of the log.
+	// Whatever no longer fits is added to forgotten, if it isn't null. Safe to call from any thread.
+	static void AddLog(std::deque<BartlebyLogElement>& log, const FString& msg, int32 firstMemory, int32 fixedTokens,
+		const BartlebyPromptSettings& settings, TArray<FBartlebyMemoryEntry>* forgotten);
+	// Adds up the tokens of the log elements.
+	static int32 CountLogTokens(const std::deque<BartlebyLogElement>& log);
+	// Counts the tokens in the help string, which is sent in front of every log.
+	int32 GetHelpTokens();
+	// Counts the tokens the whole prompt will take up with the given log and memory summary.
+	int32 CountPromptTokens(const std::deque<BartlebyLogElement>& log, int32 memoryTokens = 0);
+	// Generates the memory summary that goes at the end of the first message, if there is one.
+	FString GenerateMemoryString(const ABartlebyController* controller) const;
+	// Starts folding what the controller forgot into its memory summary, unless that's already happening.
+	void SummarizeMemory(ABartlebyController* controller);
+	// Makes the summary on the thread pool.
+	void SummarizeMemoryInBackground(ABartlebyController* controller, TArray<FBartlebyMemoryEntry>&& entries);
+	// Asks the AI for the summary, as a call like any other, and falls back to making it locally if that doesn't work.
+	void SummarizeMemoryWithAI(ABartlebyController* controller, TArray<FBartlebyMemoryEntry>&& entries);
+	// Called on the game thread when a memory summary call finishes, with what the AI said, or empty if it failed.
+	void OnMemorySummaryCallFinished(const TSharedRef<BartlebyCall>& call, const FString& summary);
+	// Called on the game thread with a new summary.
+	void OnMemorySummarized(ABartlebyController* controller, const FString& summary);
+	// Number of memories in the controller's episodic memory, or 0 if it doesn't have one.
+	int32 GetNumMemories(const ABartlebyController* controller) const;
+	// Adds something that happened to the controller's episodic memory, along with where it happened.
+	void Remember(ABartlebyController* controller, const FString& text);
+	// Generates the list of memories that matter where the controller is now, to go after the status.
+	FString GenerateRecallString(ABartlebyController* controller);
+	// Sets up a call from the current log and the given snapshot, without changing anything. It still has to be built.
+	TSharedRef<BartlebyCall> MakeCall(ABartlebyController* controller, const FString& appended, FBartlebyStatusSnapshot&& snapshot);
+	// Builds the call's prompt and body, in the background with the rest of the frame's calls if
+	// BuildPromptsInBackground is on, or right away if not.
+	void QueueBuild(const TSharedRef<BartlebyCall>& call);
+	// Builds the prompts of every call queued since last frame on the worker threads, in parallel.
+	void BuildPendingCalls();
+	// Writes the status, prompt and request body of a call, from its snapshot and copy of the log. Only touches the
+	// call, so it's safe to call from any thread.
+	static void BuildCall(BartlebyCall& call, const BartlebyPromptSettings& settings);
+	// Commits and sends a call once it's built, unless it was cancelled in the meantime.
+	void OnCallBuilt(const TSharedRef<BartlebyCall>& call);
+	// Makes the call's log the real log. Returns false, changing nothing, if the log changed since the call was made.
+	bool CommitCall(const TSharedRef<BartlebyCall>& call);
+	// Puts the call in line to be sent.
+	void EnqueueCall(const TSharedRef<BartlebyCall>& call);
+	// Sends as many calls from the line as there are free slots, most urgent first.
+	void PumpScheduler();
+	// Lower is more urgent.
+	float GetCallPriority(const BartlebyCall& call, double now) const;
+	// Sends the call to the AI.
+	void SendCall(const TSharedRef<BartlebyCall>& call);
+	// Sets up a request for the current try of the call, without sending it.
+	FHttpRequestRef MakeRequest(const TSharedRef<BartlebyCall>& call, TArray<uint8>&& body, bool isHedge);
+	// Sends a duplicate of a slow call's request.
+	void HedgeCall(const TSharedRef<BartlebyCall>& call);
+	// Cancels the requests of the current try, and ignores anything they say.
+	void AbandonAttempt(const TSharedRef<BartlebyCall>& call);
+	// Puts the call back in line to be tried again after a delay, at least as long as the one given. Returns false if
+	// it's out of retries.
+	bool TryRetryCall(const TSharedRef<BartlebyCall>& call, float minDelay = 0.0f);
+	// Gives up on calls that have run out of time, and hedges slow ones.
+	void CheckDeadlines(double now);
+	// Remembers how long an answer took, and updates LatencyP95.
+	void RecordLatency(float seconds);
+	// Records the metrics of a call that got an answer. Token counts are skipped if they're negative.
+	void RecordCallTelemetry(const BartlebyCall& call, int32 responseBytes, int32 promptTokens, int32 completionTokens);
+	// Frees up the call's slot in the scheduler.
+	void FinishCall(const TSharedRef<BartlebyCall>& call);
+	// Stops the call and ignores anything it says.
+	void CancelCall(const TSharedRef<BartlebyCall>& call);
+	// Stops every call that's waiting, being built or in flight, so that none of them calls back once the system is gone.
+	void CancelAllCalls();
+	// Gets the first action and the tokens used out of a whole (non-streamed) response. Returns false if it couldn't be
+	// parsed. Safe to call from any thread.
+	static bool ParseCompletion(const TArray<uint8>& body, bool logBody, BartlebyCallResult& result);
+	// Fills in the result from a whole response with the given status. Only answers that aren't a rate limit or server
+	// error are parsed. Safe to call from any thread.
+	static void ReadResponse(const TArray<uint8>& body, int32 status, bool logBody, BartlebyCallResult& result);
+	// True for statuses that mean "not now" rather than "not like that".
+	static bool IsTransientStatus(int32 status) { return status == 429 || status >= 500; }
+	// Counts a rate limit or server error, and holds everything back as long as the server asked. Returns how long to
+	// wait before trying again.
+	float OnTransientError(int32 status, const FBartlebyRateLimitHeaders& limits);
+	// Catches the rate limiter up with what the server said in an answer to the given call.
+	void UpdateRateLimits(const BartlebyCall& call, const FBartlebyRateLimitHeaders& limits);
+	// Gives back what the call took out of the rate limit.
+	void ReleaseRateLimit(BartlebyCall& call);
+	// Called when the AI answered the call.
+	void OnCallSucceeded(const TSharedRef<BartlebyCall>& call, const FString& action);
+	// Called when the call didn't go through, or the answer was garbage.
+	void OnCallFailed(const TSharedRef<BartlebyCall>& call, bool wasParsingError);
+	// Called while a streamed response is coming in. Hands off the first action as soon as it is complete.
+	void OnStreamProgress(const TSharedRef<BartlebyCall>& call, TSharedRef<class FBartlebyStreamParser> parser,
+		class FBartlebyStreamBuffer& buffer);
+	// Called when a streamed response finishes without having already handed off an action. The body is null if the
+	// request didn't go through.
+	void OnStreamComplete(const TSharedRef<BartlebyCall>& call, const TArray<uint8>* body, int32 status,
+		const FBartlebyRateLimitHeaders& limits, TSharedRef<class FBartlebyStreamParser> parser);
+	// Answers the call from the recording instead of sending it, after as long as the recorded answer took.
+	void ReplayCall(const TSharedRef<BartlebyCall>& call);
+	// Hands a recorded answer to the call as if it had just come in. The answer is null if there wasn't one.
+	void DeliverReplayedCall(const TSharedRef<BartlebyCall>& call, const FBartlebyRecordedCall* recorded);
+	// Writes a streamed call to the recording, if there is one. Game thread only.
+	void RecordStreamedCall(const BartlebyCall& call, const TArray<uint8>& response, int32 status);
+	// Writes the answer a call went on with to the recording, if there is one. Game thread only.
+	void RecordCall(const BartlebyCallResult& result);
+	// Records what the AI said and passes it along to the controller.
+	void DispatchAction(ABartlebyController* controller, const FString& action);
+	// Copies the cache's counters into the properties shown in the editor.
+	void UpdateCacheStats();
+	// Copies the connection manager's counters into the properties shown in the editor.
+	void UpdateConnectionStats();
+	// Indexes the rooms' boxes for GetRoomAtOrNull, and starts watching them for moves.
+	void RebuildRoomIndex();
+	// Called when a room's box moves.
+	void OnRoomMoved(USceneComponent* component, EUpdateTransformFlags flags, ETeleportType teleport);
+	// Gets the map of which room connects to which, building it first if rooms or doors changed.
+	const class FBartlebyRoomGraph& GetRoomGraph();
+	// Finds the rooms that touch and can be walked between, as indices into Rooms.
+	void FindAutoDoors(TArray<TPair<int32, int32>>& outDoors);
+	// Lists the doors at each room, from Doors and from the given connections found after the first numPlaced.
+	void BuildDoorIndex(const TArray<TPair<int32, int32>>& connections, int32 numPlaced);
+	// Gets the index of the room in Rooms, or INDEX_NONE.
+	int32 GetRoomNumber(const ABartlebyRoom* room);
+	// Where calls are recorded to or replayed from, unless Transport is Live.
+	TSharedPtr<class FBartlebyCallRecording> Recording;
+	// Paces calls to fit in the server's rate limit, if UseRateLimiting is on.
+	TSharedPtr<class FBartlebyRateLimiter> RateLimiter;
+	// Keeps the connection to the AI open, if UseConnectionWarming is on.
+	TSharedPtr<class FBartlebyConnectionManager> ConnectionManager;
+	// Answers we've already gotten from the AI, if UseCompletionCache is on.
+	TSharedPtr<class FBartlebyCompletionCache> CompletionCache;
+	// Answers to things guests said, if UseUtteranceCache is on.
+	TSharedPtr<class FBartlebyUtteranceCache> UtteranceCache;
+	// Counts the tokens in log elements.
+	TSharedPtr<class FBartlebyTokenizer> Tokenizer;
+	// Finds the room at a position, and the world revision it was built from. Rebuilt the next time it's used after a
+	// room moves, or Rooms changes.
+	TSharedPtr<class FBartlebyRoomIndex> RoomIndex;
+	bool IsRoomIndexDirty = true;
+	int32 RoomIndexRevision = 0;
+	// Finds rooms by ID, and the world revision it was built from. Rebuilt the next time it's used after Rooms changes.
+	TSharedPtr<class FBartlebyIdIndex> RoomIdIndex;
+	int32 RoomIdIndexRevision = 0;
+	// Which room connects to which, and the world revision and number of rooms and doors it was built from.
+	TSharedPtr<class FBartlebyRoomGraph> RoomGraph;
+	int32 RoomGraphRevision = 0;
+	int32 RoomGraphRooms = 0;
+	int32 RoomGraphDoors = 0;
+	// Index of each room in Rooms, by pointer and by ID, as of the last time the graph was built.
+	TMap<const ABartlebyRoom*, int32> RoomNumbers;
+	TMap<FString, int32> RoomNumbersById;
+	// The doors in Doors that lead from a room, then the doors found touching, as of the last time the graph was built.
+	// The ones at each room are DoorsByRoom[DoorStarts[room]] up to DoorsByRoom[DoorStarts[room + 1]].
+	TArray<FDoor> GraphDoors;
+	TArray<int32> DoorStarts;
+	TArray<int32> DoorsByRoom;
+	// Rooms and Doors are public, so they can be swapped, renamed or re-pointed behind our back without their number
+	// changing. Every tick they're hashed, and the revision is bumped if the hash changed. Whatever is built from them
+	// remembers the revision it was built from.
+	int32 WorldRevision = 0;
+	uint32 WorldSignature = 0;
+	// Number of times the map of which room connects to which has been built.
+	int32 NumRoomGraphBuilds = 0;
+	// How many tokens the first message was, or -1 if it hasn't been counted, and what it was built from.
+	int32 NumHelpTokens = -1;
+	uint32 HelpSignature = 0;
+	// The map of the world that goes in the stable prefix, and the state of the world it was built from.
+	FString WorldSummary;
+	uint32 WorldSummarySignature = 0;
+	// Size of the biggest request body so far, so that new ones can be allocated once at the right size.
+	int32 BodySizeHint = 0;
+	// Used to compute AveragePrefixMatchFraction.
+	double TotalPrefixMatchFraction = 0.0;
+	int32 NumPrefixSamples = 0;
+	// Calls waiting to be built.
+	TArray<TSharedRef<BartlebyCall>> PendingBuilds;
+	// Calls waiting in line for a free slot.
+	TArray<TSharedRef<BartlebyCall>> PendingCalls;
+	// Calls that have been sent and are taking up a slot.
+	TArray<TSharedRef<BartlebyCall>> InFlightCalls;
+	// Histograms of what every call cost.
+	FBartlebyTelemetry Telemetry;
+	// When to next write out the telemetry, and how much had been recorded when it last was.
+	double NextTelemetryDumpTime = 0.0;
+	int64 NumRecordedAtLastDump = 0;
+	// How long recent calls took to answer, in seconds. Used as a ring buffer.
+	TArray<float> RecentLatencies;
+	int32 NextLatencyIndex = 0;
+	// Used to compute AverageQueueWait.
+	double TotalQueueWait = 0.0;
+	int32 NumScheduledRequests = 0;
 	// List of recent things the AI was thinking.
 	TArray<FString> Thoughts;
-	// Current dump of strings that we are going to send the AI on the next iteartion.
-	FString appendedMsg;
 private:
 	// Pointer to the input widget that the user will see.
 	UPROPERTY()
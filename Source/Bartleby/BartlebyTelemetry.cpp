@@ -0,0 +1,182 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyTelemetry.h"
+#include "Bartleby/BartlebyJsonWriter.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+
+void FBartlebyHistogram::Record(int64 value)
+{
+	value = FMath::Max<int64>(value, 0);
+	const int32 index = GetBucketIndex(value);
+	if (index >= Counts.Num())
+	{
+		Counts.SetNumZeroed(index + 1);
+	}
+	Counts[index]++;
+	TotalCount++;
+	Sum += value;
+	Min = FMath::Min(Min, value);
+	Max = FMath::Max(Max, value);
+}
+
+void FBartlebyHistogram::Reset()
+{
+	Counts.Reset();
+	TotalCount = 0;
+	Sum = 0;
+	Min = MAX_int64;
+	Max = 0;
+}
+
+int64 FBartlebyHistogram::GetPercentile(double percent) const
+{
+	if (TotalCount == 0)
+	{
+		return 0;
+	}
+	const int64 target = FMath::Clamp<int64>(static_cast<int64>(FMath::CeilToDouble(percent / 100.0 * TotalCount)), 1, TotalCount);
+	if (target == TotalCount)
+	{
+		return Max;
+	}
+	int64 seen = 0;
+	for (int32 i = 0; i < Counts.Num(); i++)
+	{
+		seen += Counts[i];
+		if (seen >= target)
+		{
+			// Never report something outside of what was actually recorded.
+			return FMath::Clamp(GetBucketValue(i), Min, Max);
+		}
+	}
+	return Max;
+}
+
+int32 FBartlebyHistogram::GetBucketIndex(int64 value)
+{
+	// Small values get a bucket each. After that, the top SubBucketBits bits below the highest set bit pick the bucket.
+	if (value < NumSubBuckets)
+	{
+		return static_cast<int32>(value);
+	}
+	const int32 shift = static_cast<int32>(FPlatformMath::FloorLog2_64(static_cast<uint64>(value))) - SubBucketBits;
+	const int32 subBucket = static_cast<int32>(value >> shift) - NumSubBuckets;
+	return (shift + 1) * NumSubBuckets + subBucket;
+}
+
+int64 FBartlebyHistogram::GetBucketValue(int32 index)
+{
+	if (index < NumSubBuckets)
+	{
+		return index;
+	}
+	const int32 shift = index / NumSubBuckets - 1;
+	const int64 lower = static_cast<int64>(index % NumSubBuckets + NumSubBuckets) << shift;
+	return lower + ((static_cast<int64>(1) << shift) >> 1);
+}
+
+void FBartlebyTelemetry::Record(EBartlebyMetric metric, int64 value)
+{
+	Histograms[static_cast<int32>(metric)].Record(value);
+	NumRecorded++;
+}
+
+void FBartlebyTelemetry::Reset()
+{
+	for (FBartlebyHistogram& histogram : Histograms)
+	{
+		histogram.Reset();
+	}
+	NumRecorded = 0;
+}
+
+bool FBartlebyTelemetry::AppendCsv(const FString& path, const FDateTime& time) const
+{
+	FString csv;
+	if (!IFileManager::Get().FileExists(*path))
+	{
+		csv += TEXT("time,metric,count,min,p50,p95,p99,max,mean\n");
+	}
+	const FString timeString = time.ToIso8601();
+	for (int32 i = 0; i < static_cast<int32>(EBartlebyMetric::Count); i++)
+	{
+		const FBartlebyHistogram& histogram = Histograms[i];
+		csv += FString::Printf(TEXT("%s,%s,%lld,%lld,%lld,%lld,%lld,%lld,%.2f\n"), *timeString,
+			ANSI_TO_TCHAR(GetMetricName(static_cast<EBartlebyMetric>(i))), histogram.GetCount(), histogram.GetMin(),
+			histogram.GetPercentile(50.0), histogram.GetPercentile(95.0), histogram.GetPercentile(99.0), histogram.GetMax(),
+			histogram.GetMean());
+	}
+	return FFileHelper::SaveStringToFile(csv, *path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM,
+		&IFileManager::Get(), FILEWRITE_Append);
+}
+
+bool FBartlebyTelemetry::WriteJson(const FString& path, const FDateTime& time, const TMap<FString, int64>& counters) const
+{
+	TArray<uint8> json;
+	FBartlebyJsonWriter writer(json);
+	writer.BeginObject();
+	writer.WriteField("time", time.ToIso8601());
+	writer.WriteKey("counters");
+	writer.BeginObject();
+	for (const TPair<FString, int64>& counter : counters)
+	{
+		writer.WriteField(TCHAR_TO_ANSI(*counter.Key), static_cast<double>(counter.Value));
+	}
+	writer.EndObject();
+	writer.WriteKey("metrics");
+	writer.BeginObject();
+	for (int32 i = 0; i < static_cast<int32>(EBartlebyMetric::Count); i++)
+	{
+		const FBartlebyHistogram& histogram = Histograms[i];
+		writer.WriteKey(GetMetricName(static_cast<EBartlebyMetric>(i)));
+		writer.BeginObject();
+		writer.WriteField("count", static_cast<double>(histogram.GetCount()));
+		writer.WriteField("min", static_cast<double>(histogram.GetMin()));
+		writer.WriteField("p50", static_cast<double>(histogram.GetPercentile(50.0)));
+		writer.WriteField("p95", static_cast<double>(histogram.GetPercentile(95.0)));
+		writer.WriteField("p99", static_cast<double>(histogram.GetPercentile(99.0)));
+		writer.WriteField("max", static_cast<double>(histogram.GetMax()));
+		writer.WriteField("mean", histogram.GetMean());
+		writer.EndObject();
+	}
+	writer.EndObject();
+	writer.EndObject();
+	return FFileHelper::SaveArrayToFile(json, *path);
+}
+
+const ANSICHAR* FBartlebyTelemetry::GetMetricName(EBartlebyMetric metric)
+{
+	switch (metric)
+	{
+	case EBartlebyMetric::TimeToFirstByte: return "time_to_first_byte_ms";
+	case EBartlebyMetric::Latency: return "latency_ms";
+	case EBartlebyMetric::RequestBytes: return "request_bytes";
+	case EBartlebyMetric::ResponseBytes: return "response_bytes";
+	case EBartlebyMetric::PromptTokens: return "prompt_tokens";
+	case EBartlebyMetric::CompletionTokens: return "completion_tokens";
+	case EBartlebyMetric::Retries: return "retries";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,103 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BartlebyTelemetry.generated.h"
+
+// Things that are measured for every call to the AI.
+UENUM(BlueprintType)
+enum class EBartlebyMetric : uint8
+{
+	// Milliseconds from sending a request to the first bytes of the answer.
+	TimeToFirstByte,
+	// Milliseconds from sending a request to having the action.
+	Latency,
+	// Size of the request body.
+	RequestBytes,
+	// Size of the response body.
+	ResponseBytes,
+	// Prompt tokens billed, from the response's usage.
+	PromptTokens,
+	// Completion tokens billed, from the response's usage.
+	CompletionTokens,
+	// Times the call had to be tried again.
+	Retries,
+	Count UMETA(Hidden)
+};
+
+// Counts values in buckets whose width grows with the value, like an HDR histogram, so that both tiny and huge values
+// are kept to within about 3% without storing every sample. Only whole, non-negative values are counted.
+class BARTLEBY_API FBartlebyHistogram
+{
+public:
+	void Record(int64 value);
+	void Reset();
+
+	// Gets the value below which the given percent (0 to 100) of values fall.
+	int64 GetPercentile(double percent) const;
+	int64 GetCount() const { return TotalCount; }
+	int64 GetMin() const { return TotalCount > 0 ? Min : 0; }
+	int64 GetMax() const { return Max; }
+	double GetMean() const { return TotalCount > 0 ? static_cast<double>(Sum) / TotalCount : 0.0; }
+
+private:
+	// Each power of two is split into this many buckets (as a power of two).
+	static constexpr int32 SubBucketBits = 5;
+	static constexpr int32 NumSubBuckets = 1 << SubBucketBits;
+
+	static int32 GetBucketIndex(int64 value);
+	// The middle of the range of values that land in the given bucket.
+	static int64 GetBucketValue(int32 index);
+
+	TArray<int64> Counts;
+	int64 TotalCount = 0;
+	int64 Sum = 0;
+	int64 Min = MAX_int64;
+	int64 Max = 0;
+};
+
+// A histogram for every metric, and a way to write them all out.
+class BARTLEBY_API FBartlebyTelemetry
+{
+public:
+	void Record(EBartlebyMetric metric, int64 value);
+	const FBartlebyHistogram& Get(EBartlebyMetric metric) const { return Histograms[static_cast<int32>(metric)]; }
+	void Reset();
+
+	// Total values recorded across all metrics. Changes whenever anything new is recorded.
+	int64 GetNumRecorded() const { return NumRecorded; }
+
+	// Appends a row per metric to a CSV file, writing the header first if the file is new.
+	bool AppendCsv(const FString& path, const FDateTime& time) const;
+	// Writes every metric, and the given counters, as a JSON object. Replaces the file.
+	bool WriteJson(const FString& path, const FDateTime& time, const TMap<FString, int64>& counters) const;
+
+	// Name of the metric, as used in the CSV and JSON.
+	static const ANSICHAR* GetMetricName(EBartlebyMetric metric);
+
+private:
+	FBartlebyHistogram Histograms[static_cast<int32>(EBartlebyMetric::Count)];
+	int64 NumRecorded = 0;
+};
@@ -0,0 +1,234 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyTokenizer.h"
+#include "Misc/Base64.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	// 64 bit FNV-1a. Collisions among the ~100k tokens of the vocabulary are vanishingly unlikely.
+	uint64 HashBytes(const uint8* bytes, int32 length)
+	{
+		uint64 hash = 14695981039346656037ull;
+		for (int32 i = 0; i < length; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	bool IsNewline(TCHAR c)
+	{
+		return c == '\r' || c == '\n';
+	}
+
+	bool IsLetter(TCHAR c)
+	{
+		return FChar::IsAlpha(c);
+	}
+
+	bool IsNumber(TCHAR c)
+	{
+		return FChar::IsDigit(c);
+	}
+
+	// Anything that isn't a letter, number or whitespace.
+	bool IsSymbol(TCHAR c)
+	{
+		return !FChar::IsWhitespace(c) && !IsLetter(c) && !IsNumber(c);
+	}
+
+	// Gets the length of the next piece of text starting at the given index. Follows the cl100k split pattern:
+	// contractions, words with an optional leading symbol or space, runs of up to three digits, runs of symbols with an
+	// optional leading space, and whitespace (leaving a single space to be joined to the next word).
+	int32 NextPieceLength(const FString& text, int32 start)
+	{
+		const int32 len = text.Len();
+		const TCHAR c = text[start];
+		int32 i = start;
+
+		// 's 't 're 've 'm 'll 'd
+		if (c == '\'' && i + 1 < len)
+		{
+			const TCHAR n1 = FChar::ToLower(text[i + 1]);
+			const TCHAR n2 = i + 2 < len ? FChar::ToLower(text[i + 2]) : 0;
+			if (n1 == 's' || n1 == 't' || n1 == 'm' || n1 == 'd')
+			{
+				return 2;
+			}
+			if ((n1 == 'r' && n2 == 'e') || (n1 == 'v' && n2 == 'e') || (n1 == 'l' && n2 == 'l'))
+			{
+				return 3;
+			}
+		}
+		// Words, possibly with one leading symbol or space.
+		if (IsLetter(c) || (!IsNewline(c) && !IsNumber(c) && i + 1 < len && IsLetter(text[i + 1])))
+		{
+			i++;
+			while (i < len && IsLetter(text[i]))
+			{
+				i++;
+			}
+			return i - start;
+		}
+		// Numbers, up to three digits at a time.
+		if (IsNumber(c))
+		{
+			while (i < len && i - start < 3 && IsNumber(text[i]))
+			{
+				i++;
+			}
+			return i - start;
+		}
+		// Symbols, possibly with one leading space, and any newlines after them.
+		if (IsSymbol(c) || (c == ' ' && i + 1 < len && IsSymbol(text[i + 1])))
+		{
+			if (c == ' ')
+			{
+				i++;
+			}
+			while (i < len && IsSymbol(text[i]))
+			{
+				i++;
+			}
+			while (i < len && IsNewline(text[i]))
+			{
+				i++;
+			}
+			return i - start;
+		}
+		// Whitespace.
+		int32 end = i;
+		int32 lastNewline = INDEX_NONE;
+		while (end < len && FChar::IsWhitespace(text[end]))
+		{
+			if (IsNewline(text[end]))
+			{
+				lastNewline = end;
+			}
+			end++;
+		}
+		if (lastNewline != INDEX_NONE)
+		{
+			return lastNewline + 1 - start;
+		}
+		// Leave the last space for the word that follows.
+		if (end < len && end - start > 1)
+		{
+			return end - 1 - start;
+		}
+		return end - start;
+	}
+}
+
+bool FBartlebyTokenizer::LoadRanks(const FString& path)
+{
+	Ranks.Empty();
+	FString contents;
+	if (!FFileHelper::LoadFileToString(contents, *path))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Unable to load token ranks from %s. Token counts will be estimated."), *path);
+		return false;
+	}
+	TArray<FString> lines;
+	contents.ParseIntoArrayLines(lines, true);
+	Ranks.Reserve(lines.Num());
+	TArray<uint8> bytes;
+	for (const FString& line : lines)
+	{
+		FString token;
+		FString rank;
+		if (!line.Split(TEXT(" "), &token, &rank) || !FBase64::Decode(token, bytes))
+		{
+			continue;
+		}
+		Ranks.Add(HashBytes(bytes.GetData(), bytes.Num()), FCString::Atoi(*rank));
+	}
+	UE_LOG(LogTemp, Display, TEXT("Loaded %d token ranks from %s."), Ranks.Num(), *path);
+	return Ranks.Num() > 0;
+}
+
+int32 FBartlebyTokenizer::GetRank(const uint8* bytes, int32 length) const
+{
+	const int32* rank = Ranks.Find(HashBytes(bytes, length));
+	return rank ? *rank : INDEX_NONE;
+}
+
+int32 FBartlebyTokenizer::CountTokens(const FString& text) const
+{
+	if (text.IsEmpty())
+	{
+		return 0;
+	}
+	if (!IsLoaded())
+	{
+		return (FTCHARToUTF8(*text).Length() + 3) / 4;
+	}
+	int32 count = 0;
+	int32 start = 0;
+	while (start < text.Len())
+	{
+		int32 length = NextPieceLength(text, start);
+		FTCHARToUTF8 utf8(&text[start], length);
+		count += CountPieceTokens(reinterpret_cast<const uint8*>(utf8.Get()), utf8.Length());
+		start += length;
+	}
+	return count;
+}
+
+int32 FBartlebyTokenizer::CountPieceTokens(const uint8* bytes, int32 length) const
+{
+	// Most pieces are whole tokens already.
+	if (GetRank(bytes, length) != INDEX_NONE)
+	{
+		return 1;
+	}
+	// Otherwise start from single bytes, and keep merging whichever neighbouring pair has the lowest rank.
+	TArray<int32, TInlineAllocator<64>> starts;
+	for (int32 i = 0; i <= length; i++)
+	{
+		starts.Add(i);
+	}
+	while (starts.Num() > 2)
+	{
+		int32 bestIndex = INDEX_NONE;
+		int32 bestRank = MAX_int32;
+		for (int32 i = 0; i + 2 < starts.Num(); i++)
+		{
+			int32 rank = GetRank(bytes + starts[i], starts[i + 2] - starts[i]);
+			if (rank != INDEX_NONE && rank < bestRank)
+			{
+				bestRank = rank;
+				bestIndex = i;
+			}
+		}
+		if (bestIndex == INDEX_NONE)
+		{
+			break;
+		}
+		starts.RemoveAt(bestIndex + 1);
+	}
+	return starts.Num() - 1;
+}
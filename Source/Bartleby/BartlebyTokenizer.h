@@ -0,0 +1,60 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Counts tokens the same way the OpenAI chat models do: the text is split into pieces (words, numbers, punctuation
+// and whitespace), then each piece is byte pair encoded using the merge ranks of the model's vocabulary. The ranks are
+// loaded from a local cl100k_base.tiktoken style file, with one "<base64 token> <rank>" per line. If no file is
+// loaded, counts are estimated at about four bytes per token.
+class BARTLEBY_API FBartlebyTokenizer
+{
+public:
+	// Tokens the chat format adds around every message.
+	static constexpr int32 TokensPerMessage = 4;
+	// Tokens the chat format adds to prime the reply.
+	static constexpr int32 TokensPerReply = 3;
+
+	// Loads the merge ranks from the given file. Returns false if it can't be read.
+	bool LoadRanks(const FString& path);
+
+	// True if merge ranks are loaded, and counts are exact.
+	bool IsLoaded() const { return Ranks.Num() > 0; }
+
+	// Counts the tokens in the given text.
+	int32 CountTokens(const FString& text) const;
+
+	// Counts the tokens a chat message with the given content takes up.
+	int32 CountMessageTokens(const FString& content) const { return CountTokens(content) + TokensPerMessage; }
+
+private:
+	// Counts the tokens in a single piece of pre-split text, given as UTF-8.
+	int32 CountPieceTokens(const uint8* bytes, int32 length) const;
+	// Gets the rank of the given bytes, or INDEX_NONE if they aren't a token.
+	int32 GetRank(const uint8* bytes, int32 length) const;
+
+	// Rank of every token in the vocabulary, keyed by a hash of its bytes.
+	TMap<uint64, int32> Ranks;
+};
@@ -0,0 +1,60 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyTrace.h"
+
+UE_TRACE_CHANNEL_DEFINE(BartlebyChannel);
+
+TRACE_DECLARE_INT_COUNTER(BartlebyQueuedRequests, TEXT("Bartleby/Queued Requests"));
+TRACE_DECLARE_INT_COUNTER(BartlebyInFlightRequests, TEXT("Bartleby/In Flight Requests"));
+TRACE_DECLARE_INT_COUNTER(BartlebyWaitingControllers, TEXT("Bartleby/Controllers Waiting On AI"));
+TRACE_DECLARE_INT_COUNTER(BartlebyPromptTokens, TEXT("Bartleby/Prompt Tokens"));
+TRACE_DECLARE_INT_COUNTER(BartlebyPromptBytes, TEXT("Bartleby/Prompt Bytes"));
+
+UE_TRACE_EVENT_BEGIN(Bartleby, ControllerState)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, ControllerId)
+	UE_TRACE_EVENT_FIELD(uint8, OldState)
+	UE_TRACE_EVENT_FIELD(uint8, NewState)
+	UE_TRACE_EVENT_FIELD(UE::Trace::WideString, ControllerName)
+UE_TRACE_EVENT_END()
+
+namespace BartlebyTrace
+{
+	void OutputControllerState(const UObject* controller, uint8 oldState, uint8 newState)
+	{
+#if UE_TRACE_ENABLED
+		if (!UE_TRACE_CHANNELEXPR_IS_ENABLED(BartlebyChannel) || !controller)
+		{
+			return;
+		}
+		const FString name = controller->GetName();
+		UE_TRACE_LOG(Bartleby, ControllerState, BartlebyChannel)
+			<< ControllerState.Cycle(FPlatformTime::Cycles64())
+			<< ControllerState.ControllerId(controller->GetUniqueID())
+			<< ControllerState.OldState(oldState)
+			<< ControllerState.NewState(newState)
+			<< ControllerState.ControllerName(*name, name.Len());
+#endif
+	}
+}
@@ -0,0 +1,48 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CountersTrace.h"
+
+// Unreal Insights channel for everything Bartleby does. Capture it with -trace=cpu,counters,bartleby (or
+// "Trace.Enable Bartleby" at runtime) to see prompt building, controller ticks and response handling per NPC turn.
+UE_TRACE_CHANNEL_EXTERN(BartlebyChannel, BARTLEBY_API);
+
+// Times the rest of the enclosing scope, on the Bartleby channel.
+#define BARTLEBY_TRACE_SCOPE(Name) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Bartleby_##Name, BartlebyChannel)
+
+TRACE_DECLARE_INT_COUNTER_EXTERN(BartlebyQueuedRequests);
+TRACE_DECLARE_INT_COUNTER_EXTERN(BartlebyInFlightRequests);
+TRACE_DECLARE_INT_COUNTER_EXTERN(BartlebyWaitingControllers);
+TRACE_DECLARE_INT_COUNTER_EXTERN(BartlebyPromptTokens);
+TRACE_DECLARE_INT_COUNTER_EXTERN(BartlebyPromptBytes);
+
+namespace BartlebyTrace
+{
+	// Records that a controller went from one state to another, so each NPC's turn can be followed in a capture.
+	BARTLEBY_API void OutputControllerState(const UObject* controller, uint8 oldState, uint8 newState);
+}
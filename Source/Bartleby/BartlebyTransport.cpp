@@ -0,0 +1,176 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyTransport.h"
+#include "Bartleby/BartlebyJsonWriter.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	FSHAHash HashBody(const TArray<uint8>& body)
+	{
+		FSHAHash key;
+		FSHA1::HashBuffer(body.GetData(), body.Num(), key.Hash);
+		return key;
+	}
+
+	FString BodyToString(const TArray<uint8>& body)
+	{
+		FUTF8ToTCHAR converted(reinterpret_cast<const ANSICHAR*>(body.GetData()), body.Num());
+		return FString(converted.Length(), converted.Get());
+	}
+}
+
+FBartlebyCallRecording::~FBartlebyCallRecording()
+{
+	Close();
+}
+
+bool FBartlebyCallRecording::OpenForRecording(const FString& path)
+{
+	Close();
+	Path = path;
+	Writer = IFileManager::Get().CreateFileWriter(*Path, FILEWRITE_Append | FILEWRITE_AllowRead);
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't open %s to record calls."), *Path);
+		return false;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Recording calls to %s."), *Path);
+	return true;
+}
+
+bool FBartlebyCallRecording::LoadForReplay(const FString& path)
+{
+	Close();
+	Path = path;
+	Calls.Empty();
+	Index.Empty();
+	TArray<FString> lines;
+	if (!FFileHelper::LoadFileToStringArray(lines, *Path))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't read calls to replay from %s."), *Path);
+		return false;
+	}
+	for (const FString& line : lines)
+	{
+		TSharedPtr<FJsonObject> object;
+		TSharedRef<TJsonReader<>> reader = TJsonReaderFactory<>::Create(line);
+		if (line.IsEmpty() || !FJsonSerializer::Deserialize(reader, object) || !object.IsValid())
+		{
+			// Most likely the game stopped halfway through writing the last line.
+			continue;
+		}
+		FBartlebyRecordedCall& call = Calls.AddDefaulted_GetRef();
+		call.Key.FromString(object->GetStringField(TEXT("key")));
+		call.Status = static_cast<int32>(object->GetNumberField(TEXT("status")));
+		call.IsStreamed = object->GetBoolField(TEXT("streamed"));
+		call.Latency = static_cast<float>(object->GetNumberField(TEXT("latency")));
+		call.FirstByte = static_cast<float>(object->GetNumberField(TEXT("firstByte")));
+		FTCHARToUTF8 response(*object->GetStringField(TEXT("response")));
+		call.Response.Append(reinterpret_cast<const uint8*>(response.Get()), response.Length());
+		Index.Add(call.Key, Calls.Num() - 1);
+	}
+	Played.Init(false, Calls.Num());
+	NextUnplayed = 0;
+	UE_LOG(LogTemp, Display, TEXT("Replaying %d calls from %s."), Calls.Num(), *Path);
+	return Calls.Num() > 0;
+}
+
+void FBartlebyCallRecording::Close()
+{
+	FScopeLock lock(&WriterLock);
+	if (Writer)
+	{
+		Writer->Close();
+		delete Writer;
+		Writer = nullptr;
+	}
+}
+
+void FBartlebyCallRecording::Append(const TArray<uint8>& request, const TArray<uint8>& response, int32 status,
+	bool isStreamed, double latency, double firstByte)
+{
+	// The bodies are kept as text rather than bytes, so the recording can be read (and edited) by hand.
+	TArray<uint8> line;
+	line.Reserve(request.Num() + response.Num() + 256);
+	FBartlebyJsonWriter writer(line);
+	writer.BeginObject();
+	writer.WriteField("key", HashBody(request).ToString());
+	writer.WriteField("status", static_cast<double>(status));
+	writer.WriteField("streamed", isStreamed);
+	writer.WriteField("latency", latency);
+	writer.WriteField("firstByte", firstByte);
+	writer.WriteField("request", BodyToString(request));
+	writer.WriteField("response", BodyToString(response));
+	writer.EndObject();
+	line.Add('\n');
+
+	FScopeLock lock(&WriterLock);
+	if (Writer)
+	{
+		Writer->Serialize(line.GetData(), line.Num());
+		Writer->Flush();
+		NumRecorded++;
+	}
+}
+
+const FBartlebyRecordedCall* FBartlebyCallRecording::Find(const TArray<uint8>& request)
+{
+	// Answer the same request with the same answer, in the order it was given.
+	TArray<int32> matches;
+	Index.MultiFind(HashBody(request), matches, true);
+	if (matches.Num() > 0)
+	{
+		int32 match = matches.Last();
+		for (int32 index : matches)
+		{
+			if (!Played[index])
+			{
+				match = index;
+				break;
+			}
+		}
+		Played[match] = true;
+		NumExactMatches++;
+		return &Calls[match];
+	}
+	// Otherwise the game has drifted from the recording, so keep going with whatever came next.
+	while (NextUnplayed < Calls.Num() && Played[NextUnplayed])
+	{
+		NextUnplayed++;
+	}
+	if (NextUnplayed < Calls.Num())
+	{
+		Played[NextUnplayed] = true;
+		NumFallbacks++;
+		return &Calls[NextUnplayed];
+	}
+	NumMisses++;
+	return nullptr;
+}
@@ -0,0 +1,103 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/SecureHash.h"
+#include "BartlebyTransport.generated.h"
+
+// Where calls to the AI go.
+UENUM(BlueprintType)
+enum class EBartlebyTransport : uint8
+{
+	// Calls go to the AI.
+	Live,
+	// Calls go to the AI, and every answer is written to the recording along with its request.
+	Record,
+	// Calls never leave the game. They are answered from the recording, after as long as the AI took originally.
+	Replay
+};
+
+// A request and answer, as read back from a recording.
+struct FBartlebyRecordedCall
+{
+	// Hash of the request body.
+	FSHAHash Key;
+	// HTTP status code of the answer.
+	int32 Status = 0;
+	// True if the answer is a stream of server-sent events rather than a single JSON object.
+	bool IsStreamed = false;
+	// Seconds from sending the request to having the action, and to the first bytes of the answer.
+	float Latency = 0.0f;
+	float FirstByte = 0.0f;
+	// The response body, in UTF-8.
+	TArray<uint8> Response;
+};
+
+// A file of calls to the AI, one JSON object per line, so that a session can be played back later without the AI.
+// Playing back is deterministic as long as the game makes the same requests. When it doesn't, the next answer that
+// hasn't been played back yet is used instead, in the order they were recorded.
+class BARTLEBY_API FBartlebyCallRecording
+{
+public:
+	~FBartlebyCallRecording();
+
+	// Opens the file to append calls to. Returns false if it couldn't be opened.
+	bool OpenForRecording(const FString& path);
+	// Reads every call in the file, to be played back. Returns false if there was nothing to read.
+	bool LoadForReplay(const FString& path);
+	void Close();
+
+	// Writes a call to the end of the file. Safe to call from any thread.
+	void Append(const TArray<uint8>& request, const TArray<uint8>& response, int32 status, bool isStreamed, double latency,
+		double firstByte);
+	// Gets the answer to play back for the request, or null if there are none left. Game thread only.
+	const FBartlebyRecordedCall* Find(const TArray<uint8>& request);
+
+	int32 GetNumRecorded() const { return NumRecorded; }
+	int32 GetNumLoaded() const { return Calls.Num(); }
+	// Number of requests that were found in the recording, answered with something else, or not answered at all.
+	int32 GetNumExactMatches() const { return NumExactMatches; }
+	int32 GetNumFallbacks() const { return NumFallbacks; }
+	int32 GetNumMisses() const { return NumMisses; }
+
+private:
+	FString Path;
+	// The file calls are appended to, while recording.
+	FArchive* Writer = nullptr;
+	// Calls can finish on the HTTP thread, so writes are serialized.
+	FCriticalSection WriterLock;
+	int32 NumRecorded = 0;
+	// Every call read back from the file, in the order they were recorded.
+	TArray<FBartlebyRecordedCall> Calls;
+	// Which of those have been played back already.
+	TBitArray<> Played;
+	// Where to find the calls for each request. The same request can have been made more than once.
+	TMultiMap<FSHAHash, int32> Index;
+	// The first call that might not have been played back yet.
+	int32 NextUnplayed = 0;
+	int32 NumExactMatches = 0;
+	int32 NumFallbacks = 0;
+	int32 NumMisses = 0;
+};
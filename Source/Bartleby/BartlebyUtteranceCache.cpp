@@ -0,0 +1,235 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Bartleby/BartlebyUtteranceCache.h"
+#include "Math/RandomStream.h"
+
+namespace
+{
+	// Largest prime below 2^32. The hash functions are (a * x + b) mod this.
+	const uint64 MinHashPrime = 4294967291ull;
+}
+
+FBartlebyUtteranceCache::FBartlebyUtteranceCache()
+{
+	FRandomStream random(0xBA27);
+	for (int32 i = 0; i < NumHashes; i++)
+	{
+		HashA[i] = static_cast<uint32>(random.RandHelper(MAX_int32 - 1)) | 1;
+		HashB[i] = static_cast<uint32>(random.RandHelper(MAX_int32 - 1));
+	}
+	Empty();
+}
+
+FString FBartlebyUtteranceCache::Normalize(const FString& utterance)
+{
+	FString out;
+	out.Reserve(utterance.Len());
+	bool lastWasSpace = true;
+	for (TCHAR c : utterance)
+	{
+		if (FChar::IsAlnum(c))
+		{
+			out.AppendChar(FChar::ToLower(c));
+			lastWasSpace = false;
+		}
+		else if (!lastWasSpace && (FChar::IsWhitespace(c) || FChar::IsPunct(c)))
+		{
+			out.AppendChar(' ');
+			lastWasSpace = true;
+		}
+	}
+	out.TrimEndInline();
+	return out;
+}
+
+FString FBartlebyUtteranceCache::MakeContextKey(const FString& roomId, TArray<FString> objectIds)
+{
+	// The order the objects are listed in depends on where the AI is standing, which shouldn't matter here.
+	objectIds.Sort();
+	return roomId + "|" + FString::Join(objectIds, TEXT(","));
+}
+
+void FBartlebyUtteranceCache::ComputeSignature(const FString& normalized, uint32* outSignature) const
+{
+	for (int32 i = 0; i < NumHashes; i++)
+	{
+		outSignature[i] = MAX_uint32;
+	}
+	// Pad with spaces so that short questions and the start and end of words still make trigrams.
+	FString padded = " " + normalized + " ";
+	for (int32 start = 0; start + 3 <= padded.Len(); start++)
+	{
+		uint32 shingle = FCrc::MemCrc32(&padded[start], 3 * sizeof(TCHAR));
+		for (int32 i = 0; i < NumHashes; i++)
+		{
+			uint32 h = static_cast<uint32>((static_cast<uint64>(HashA[i]) * shingle + HashB[i]) % MinHashPrime);
+			outSignature[i] = FMath::Min(outSignature[i], h);
+		}
+	}
+}
+
+bool FBartlebyUtteranceCache::Find(const FString& contextKey, const FString& utterance, float threshold,
+	double timeToLive, double now, FString& outAnswer, float& outSimilarity)
+{
+	outSimilarity = 0.0f;
+	TArray<Entry>* entries = Entries.Find(contextKey);
+	if (entries)
+	{
+		// Forget anything that's gotten too old.
+		int32 numBefore = entries->Num();
+		entries->RemoveAll([&](const Entry& entry)
+			{
+				return now - entry.Time > timeToLive;
+			});
+		NumExpired += numBefore - entries->Num();
+	}
+	if (!entries || entries->Num() == 0)
+	{
+		NumEmptyLookups++;
+		NumMisses++;
+		return false;
+	}
+
+	FString normalized = Normalize(utterance);
+	uint32 signature[NumHashes];
+	ComputeSignature(normalized, signature);
+
+	Entry* best = nullptr;
+	for (Entry& entry : *entries)
+	{
+		float similarity = 1.0f;
+		if (entry.Utterance != normalized)
+		{
+			int32 matches = 0;
+			for (int32 i = 0; i < NumHashes; i++)
+			{
+				matches += entry.Signature[i] == signature[i] ? 1 : 0;
+			}
+			similarity = static_cast<float>(matches) / NumHashes;
+		}
+		if (similarity > outSimilarity || !best)
+		{
+			outSimilarity = similarity;
+			best = &entry;
+		}
+	}
+	int32 bucket = FMath::Clamp(FMath::FloorToInt(outSimilarity * NumSimilarityBuckets), 0, NumSimilarityBuckets - 1);
+	SimilarityHistogram[bucket]++;
+
+	if (outSimilarity < threshold)
+	{
+		NumMisses++;
+		return false;
+	}
+	best->NumHits++;
+	outAnswer = best->Answer;
+	NumHits++;
+	TotalHitSimilarity += outSimilarity;
+	return true;
+}
+
+void FBartlebyUtteranceCache::Add(const FString& contextKey, const FString& utterance, const FString& answer, double now)
+{
+	FString normalized = Normalize(utterance);
+	if (normalized.IsEmpty())
+	{
+		return;
+	}
+	TArray<Entry>& entries = Entries.FindOrAdd(contextKey);
+	// A newer answer to the exact same question replaces the old one.
+	entries.RemoveAll([&](const Entry& entry)
+		{
+			return entry.Utterance == normalized;
+		});
+	if (entries.Num() >= MaxEntriesPerContext)
+	{
+		entries.RemoveAt(0);
+	}
+	Entry& entry = entries.AddDefaulted_GetRef();
+	entry.Utterance = normalized;
+	ComputeSignature(normalized, entry.Signature);
+	entry.Answer = answer;
+	entry.Time = now;
+}
+
+void FBartlebyUtteranceCache::Empty()
+{
+	Entries.Empty();
+	NumHits = 0;
+	NumMisses = 0;
+	NumExpired = 0;
+	NumEmptyLookups = 0;
+	TotalHitSimilarity = 0.0;
+	for (int32 i = 0; i < NumSimilarityBuckets; i++)
+	{
+		SimilarityHistogram[i] = 0;
+	}
+}
+
+int32 FBartlebyUtteranceCache::GetNumEntries() const
+{
+	int32 num = 0;
+	for (const auto& pair : Entries)
+	{
+		num += pair.Value.Num();
+	}
+	return num;
+}
+
+FString FBartlebyUtteranceCache::GetReport(float threshold) const
+{
+	const int32 numLookups = NumHits + NumMisses;
+	FString report = FString::Printf(TEXT("Utterance cache: %d lookups, %d hits (%.1f%%), %d misses, %d expired, %d entries, threshold %.2f\n"),
+		numLookups, NumHits, numLookups > 0 ? 100.0f * NumHits / numLookups : 0.0f, NumMisses, NumExpired, GetNumEntries(), threshold);
+	report += FString::Printf(TEXT("Average similarity of hits: %.2f\n"), NumHits > 0 ? TotalHitSimilarity / NumHits : 0.0);
+	report += FString::Printf(TEXT("Lookups with nothing to compare against: %d\n"), NumEmptyLookups);
+	report += TEXT("Similarity of the closest entry:\n");
+	for (int32 i = 0; i < NumSimilarityBuckets; i++)
+	{
+		report += FString::Printf(TEXT("  %.1f-%.1f: %d\n"), static_cast<float>(i) / NumSimilarityBuckets,
+			static_cast<float>(i + 1) / NumSimilarityBuckets, SimilarityHistogram[i]);
+	}
+	// The most popular questions are the ones worth tuning for.
+	TArray<TPair<int32, FString>> popular;
+	for (const auto& pair : Entries)
+	{
+		for (const Entry& entry : pair.Value)
+		{
+			if (entry.NumHits > 0)
+			{
+				popular.Add(TPair<int32, FString>(entry.NumHits, entry.Utterance));
+			}
+		}
+	}
+	popular.Sort([](const TPair<int32, FString>& a, const TPair<int32, FString>& b)
+		{
+			return a.Key > b.Key;
+		});
+	report += TEXT("Most asked:\n");
+	for (int32 i = 0; i < FMath::Min(popular.Num(), 10); i++)
+	{
+		report += FString::Printf(TEXT("  %d x \"%s\"\n"), popular[i].Key, *popular[i].Value);
+	}
+	return report;
+}
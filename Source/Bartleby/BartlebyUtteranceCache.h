@@ -0,0 +1,97 @@
+/*MIT License
+
+Copyright (c) 2023 Matthew Klingensmith
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Remembers how the AI answered the things guests say, so that the same question (give or take a few words) asked
+// in the same place gets the same answer without calling the AI. Questions are compared with MinHash over character
+// trigrams, which estimates how many trigrams two questions share.
+class BARTLEBY_API FBartlebyUtteranceCache
+{
+public:
+	// Number of hash functions in each signature. More is more accurate, but slower.
+	static constexpr int32 NumHashes = 64;
+	// Number of buckets in the similarity histogram of the report.
+	static constexpr int32 NumSimilarityBuckets = 10;
+
+	FBartlebyUtteranceCache();
+
+	// Lowercases, strips punctuation and squashes whitespace, so that "What is THIS?" and "what is this" match.
+	static FString Normalize(const FString& utterance);
+
+	// Makes the key for everything about a question other than the words: where it was asked, and what was nearby.
+	static FString MakeContextKey(const FString& roomId, TArray<FString> objectIds);
+
+	// Looks for an answer to something similar enough to the given utterance in the given context. Entries older than
+	// the time to live are dropped along the way.
+	bool Find(const FString& contextKey, const FString& utterance, float threshold, double timeToLive, double now,
+		FString& outAnswer, float& outSimilarity);
+
+	// Remembers the answer to the given utterance.
+	void Add(const FString& contextKey, const FString& utterance, const FString& answer, double now);
+
+	// Forgets everything, including the stats.
+	void Empty();
+
+	int32 GetNumHits() const { return NumHits; }
+	int32 GetNumMisses() const { return NumMisses; }
+	int32 GetNumExpired() const { return NumExpired; }
+	int32 GetNumEntries() const;
+
+	// Makes a human readable report of the hit rate, and how similar the closest entry was on each lookup, to help
+	// pick a threshold.
+	FString GetReport(float threshold) const;
+
+	// Most entries kept for a single context. The oldest is dropped to make room.
+	int32 MaxEntriesPerContext = 64;
+
+private:
+	struct Entry
+	{
+		FString Utterance;
+		uint32 Signature[NumHashes];
+		FString Answer;
+		double Time = 0.0;
+		int32 NumHits = 0;
+	};
+
+	// Computes the MinHash signature of the (already normalized) utterance.
+	void ComputeSignature(const FString& normalized, uint32* outSignature) const;
+
+	// Per-hash function coefficients, fixed so that signatures are stable.
+	uint32 HashA[NumHashes];
+	uint32 HashB[NumHashes];
+
+	TMap<FString, TArray<Entry>> Entries;
+
+	int32 NumHits = 0;
+	int32 NumMisses = 0;
+	int32 NumExpired = 0;
+	double TotalHitSimilarity = 0.0;
+	// How many lookups had their closest entry in each similarity bucket.
+	int32 SimilarityHistogram[NumSimilarityBuckets];
+	// Lookups where there was nothing at all to compare against.
+	int32 NumEmptyLookups = 0;
+};
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# MIT License, Copyright (c) 2023 Matthew Klingensmith. See LICENSE.
+"""Compares two reports written by a Bartleby benchmark, such as Bartleby.Benchmark.Prompt.
+
+Run the benchmark on two builds, e.g. headless with
+
+    UnrealEditor-Cmd Bartleby.uproject -ExecCmds="Automation RunTests Bartleby.Benchmark.Prompt; Quit" -nullrhi -unattended
+
+then:
+
+    python Tools/CompareBenchmarks.py before.json after.json
+
+Prints the time and allocations per op of everything measured in both, and how much they changed. With --threshold,
+exits with an error if anything got slower by more than that fraction, so it can gate a change.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8") as file:
+        report = json.load(file)
+    return report, {(r["function"], r["rooms"]): r for r in report["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, help="fail if anything is slower by more than this, e.g. 0.1")
+    args = parser.parse_args()
+
+    before_report, before = load(args.before)
+    after_report, after = load(args.after)
+    for report, path in ((before_report, args.before), (after_report, args.after)):
+        print(f"{path}: {report.get('platform')} {report.get('configuration')} {report.get('timestamp')}")
+
+    print(f"{'function':<24}{'rooms':>7}{'ns/op before':>15}{'ns/op after':>15}{'change':>9}"
+          f"{'allocs before':>15}{'allocs after':>14}")
+    regressions = []
+    for key in sorted(before.keys() & after.keys(), key=lambda k: (k[0], k[1])):
+        old, new = before[key], after[key]
+        change = new["ns_per_op"] / old["ns_per_op"] - 1.0 if old["ns_per_op"] > 0 else 0.0
+        print(f"{key[0]:<24}{key[1]:>7.0f}{old['ns_per_op']:>15.1f}{new['ns_per_op']:>15.1f}{change:>+9.1%}"
+              f"{old['allocs_per_op']:>15.2f}{new['allocs_per_op']:>14.2f}")
+        if args.threshold is not None and change > args.threshold:
+            regressions.append(key)
+    for key in sorted(before.keys() ^ after.keys()):
+        print(f"{key[0]} at {key[1]:.0f} rooms is only in {args.before if key in before else args.after}")
+    if regressions:
+        print(f"{len(regressions)} got slower by more than {args.threshold:.0%}.")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,433 @@
+#!/usr/bin/env python3
+# MIT License, Copyright (c) 2023 Matthew Klingensmith. See LICENSE.
+"""A stand-in for the OpenAI chat completions endpoint, for trying out Bartleby without paying for it.
+
+Answers every POST to /v1/chat/completions with a canned action (streamed if the request asks for it), and turns
+away anything else the way the real server does. It logs every new connection and how many requests each one carried,
+so you can check that the game is reusing connections.
+
+How long it takes to answer is drawn from a distribution, so that the game sees the spread of latencies the real
+server has, not just the average:
+
+    python Tools/MockOpenAIServer.py --latency 0.8 --latency-distribution lognormal --latency-spread 0.5
+
+It can also answer from a recording made by setting Transport to Record on the BartlebySystem, which replays a real
+session over HTTP, including how long each answer took:
+
+    python Tools/MockOpenAIServer.py --replay Saved/Bartleby/Recording.jsonl --latency-scale 0.5
+
+It can hold the game to a rate limit, the way the real server does: every answer carries x-ratelimit headers, and
+requests over the limit are turned away with a 429. It can also fail a fraction of requests with a 5xx:
+
+    python Tools/MockOpenAIServer.py --rate-limit-requests 20 --rate-limit-tokens 40000 --server-error-rate 0.05
+
+Run it with TLS to stand in for the real server, including the cost of the handshake:
+
+    python Tools/MockOpenAIServer.py --port 8443 --tls
+
+then set URL on the BartlebySystem to https://localhost:8443/v1/chat/completions. The certificate is self-signed, so
+the engine has to be told not to verify it: add "n.VerifyPeer=False" under [ConsoleVariables] in DefaultEngine.ini.
+"""
+
+import argparse
+import hashlib
+import http.server
+import json
+import os
+import random
+import shutil
+import socketserver
+import ssl
+import subprocess
+import tempfile
+import threading
+import time
+
+ACTIONS = [
+    "say(Welcome! Let me show you around.)",
+    "walk_to_room(lobby)",
+    "look_at(sunglasses)",
+]
+
+
+class Latency:
+    """Draws how long to wait before answering."""
+
+    def __init__(self, args):
+        self.args = args
+        self.random = random.Random(args.seed)
+        self.lock = threading.Lock()
+
+    def sample(self):
+        mean, spread = self.args.latency, self.args.latency_spread
+        with self.lock:
+            if self.args.latency_distribution == "uniform":
+                value = self.random.uniform(mean - spread, mean + spread)
+            elif self.args.latency_distribution == "normal":
+                value = self.random.gauss(mean, spread)
+            elif self.args.latency_distribution == "lognormal":
+                # The median is the given latency, and the spread is the sigma of the log, which gives a long tail.
+                value = mean * self.random.lognormvariate(0.0, spread) if mean > 0 else 0.0
+            elif self.args.latency_distribution == "exponential":
+                value = self.random.expovariate(1.0 / mean) if mean > 0 else 0.0
+            else:
+                value = mean
+        return max(0.0, value)
+
+
+class Recording:
+    """Answers from a recording made by the game, matching requests by their body, the same way the game does."""
+
+    def __init__(self, path):
+        self.lock = threading.Lock()
+        self.calls = []
+        self.index = {}
+        with open(path, encoding="utf-8") as file:
+            for line in file:
+                try:
+                    call = json.loads(line)
+                except ValueError:
+                    continue
+                self.index.setdefault(call["key"], []).append(len(self.calls))
+                self.calls.append(call)
+        self.played = [False] * len(self.calls)
+        self.next_unplayed = 0
+        print(f"replaying {len(self.calls)} calls from {path}")
+
+    def find(self, body):
+        key = hashlib.sha1(body).hexdigest().upper()
+        with self.lock:
+            matches = self.index.get(key)
+            if matches:
+                match = next((i for i in matches if not self.played[i]), matches[-1])
+            else:
+                while self.next_unplayed < len(self.calls) and self.played[self.next_unplayed]:
+                    self.next_unplayed += 1
+                if self.next_unplayed == len(self.calls):
+                    return None
+                match = self.next_unplayed
+            self.played[match] = True
+            return self.calls[match]
+
+
+class Bucket:
+    """A rate limit that refills steadily over a minute, like the real server's."""
+
+    def __init__(self, limit):
+        self.limit = limit
+        self.available = float(limit)
+        self.updated = time.monotonic()
+
+    def refill(self, now):
+        self.available = min(self.limit, self.available + (now - self.updated) * self.limit / 60.0)
+        self.updated = now
+
+    def reset_time(self):
+        """Seconds until the bucket is full again."""
+        return (self.limit - self.available) * 60.0 / self.limit
+
+
+def format_duration(seconds):
+    """Formats seconds the way the real server does in its headers, e.g. 6m0s, 1.5s or 20ms."""
+    if seconds < 1.0:
+        return f"{int(seconds * 1000)}ms"
+    minutes, seconds = divmod(seconds, 60.0)
+    return f"{int(minutes)}m{seconds:.0f}s" if minutes else f"{seconds:.3g}s"
+
+
+class RateLimits:
+    """Requests and tokens allowed per minute. Tokens are counted for the prompt, and an allowance for the answer."""
+
+    COMPLETION_ALLOWANCE = 16
+
+    def __init__(self, args):
+        self.lock = threading.Lock()
+        self.requests = Bucket(args.rate_limit_requests) if args.rate_limit_requests else None
+        self.tokens = Bucket(args.rate_limit_tokens) if args.rate_limit_tokens else None
+        self.limited = 0
+
+    def take(self, prompt_tokens):
+        """Takes a request out of the limits. Returns whether it fits, and the headers to answer with."""
+        cost = prompt_tokens + self.COMPLETION_ALLOWANCE
+        with self.lock:
+            now = time.monotonic()
+            buckets = [(self.requests, 1, "requests"), (self.tokens, cost, "tokens")]
+            buckets = [(bucket, amount, name) for bucket, amount, name in buckets if bucket]
+            for bucket, _, _ in buckets:
+                bucket.refill(now)
+            fits = all(bucket.available >= amount for bucket, amount, _ in buckets)
+            if fits:
+                for bucket, amount, _ in buckets:
+                    bucket.available -= amount
+            else:
+                self.limited += 1
+            headers = {}
+            retry_after = 0.0
+            for bucket, amount, name in buckets:
+                headers[f"x-ratelimit-limit-{name}"] = str(bucket.limit)
+                headers[f"x-ratelimit-remaining-{name}"] = str(max(0, int(bucket.available)))
+                headers[f"x-ratelimit-reset-{name}"] = format_duration(bucket.reset_time())
+                if bucket.available < amount:
+                    retry_after = max(retry_after, (amount - bucket.available) * 60.0 / bucket.limit)
+            if not fits:
+                headers["retry-after"] = str(max(1, int(retry_after + 0.999)))
+            return fits, headers
+
+
+class Stats:
+    lock = threading.Lock()
+    connections = 0
+    requests = 0
+
+    @classmethod
+    def report(cls):
+        with cls.lock:
+            reused = cls.requests - cls.connections
+            ratio = reused / cls.requests if cls.requests else 0.0
+            return f"{cls.requests} requests over {cls.connections} connections, reuse ratio {ratio:.2f}"
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    # Keep-alive only works with HTTP/1.1.
+    protocol_version = "HTTP/1.1"
+    args = None
+    latency = None
+    recording = None
+    rate_limits = None
+    errors = None
+
+    def setup(self):
+        super().setup()
+        self.requests_on_connection = 0
+        self.connected_at = time.time()
+        with Stats.lock:
+            Stats.connections += 1
+        print(f"new connection from {self.client_address[0]}:{self.client_address[1]}")
+
+    def finish(self):
+        super().finish()
+        print(f"closed connection after {self.requests_on_connection} requests, "
+              f"{time.time() - self.connected_at:.1f}s. {Stats.report()}")
+
+    def log_message(self, format, *args):
+        if self.args.verbose:
+            super().log_message(format, *args)
+
+    def count_request(self):
+        self.requests_on_connection += 1
+        with Stats.lock:
+            Stats.requests += 1
+
+    def send_empty(self, status):
+        self.send_response(status)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def send_limit_headers(self):
+        for name, value in getattr(self, "limit_headers", {}).items():
+            self.send_header(name, value)
+
+    def send_error_json(self, status, message, error_type, code=None):
+        payload = json.dumps({"error": {"message": message, "type": error_type, "param": None, "code": code}})
+        payload = payload.encode("utf-8")
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(payload)))
+        self.send_limit_headers()
+        self.end_headers()
+        self.wfile.write(payload)
+
+    def do_HEAD(self):
+        self.count_request()
+        self.send_empty(405)
+
+    def do_GET(self):
+        self.count_request()
+        self.send_empty(404)
+
+    def do_POST(self):
+        self.count_request()
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if not self.path.endswith("/chat/completions"):
+            self.send_empty(404)
+            return
+        try:
+            request = json.loads(body)
+        except ValueError:
+            self.send_empty(400)
+            return
+        self.limit_headers = {}
+        if self.rate_limits:
+            prompt_tokens = sum(len(m.get("content", "")) for m in request.get("messages", [])) // 4
+            fits, self.limit_headers = self.rate_limits.take(prompt_tokens)
+            if not fits:
+                print(f"rate limited, retry after {self.limit_headers['retry-after']}s "
+                      f"({self.rate_limits.limited} so far)")
+                self.send_error_json(429, "Rate limit reached. Please try again later.", "requests",
+                                     "rate_limit_exceeded")
+                return
+        if self.errors:
+            with self.errors[1]:
+                failed = self.errors[0].random() < self.args.server_error_rate
+            if failed:
+                self.send_error_json(500, "The server had an error while processing your request.", "server_error")
+                return
+        if self.recording:
+            self.send_recorded(body)
+            return
+        time.sleep(self.latency.sample())
+        action = ACTIONS[Stats.requests % len(ACTIONS)]
+        if request.get("stream"):
+            self.send_stream(request, action)
+        else:
+            self.send_completion(request, action)
+
+    def send_completion(self, request, action):
+        prompt_tokens = sum(len(m.get("content", "")) for m in request.get("messages", [])) // 4
+        completion_tokens = len(action) // 4
+        payload = json.dumps({
+            "id": "chatcmpl-mock",
+            "object": "chat.completion",
+            "created": int(time.time()),
+            "model": request.get("model", "mock"),
+            "usage": {"prompt_tokens": prompt_tokens, "completion_tokens": completion_tokens,
+                      "total_tokens": prompt_tokens + completion_tokens},
+            "choices": [{"message": {"role": "assistant", "content": action}, "finish_reason": "stop", "index": 0}],
+        }).encode("utf-8")
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(payload)))
+        self.send_limit_headers()
+        self.end_headers()
+        self.wfile.write(payload)
+
+    def send_recorded(self, body):
+        call = self.recording.find(body)
+        if call is None:
+            print("nothing left in the recording to answer with")
+            self.send_empty(503)
+            return
+        scale = self.args.latency_scale
+        payload = call["response"].encode("utf-8")
+        if not call["streamed"]:
+            time.sleep(call["latency"] * scale)
+            self.send_response(call["status"])
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(payload)))
+            self.send_limit_headers()
+            self.end_headers()
+            self.wfile.write(payload)
+            return
+        # Send the first event when the first byte came, and spread the rest out until the action was complete.
+        events = [event + b"\n\n" for event in payload.split(b"\n\n") if event.strip()]
+        time.sleep(call["firstByte"] * scale)
+        send_chunk = self.start_stream(call["status"])
+        rest = max(0.0, call["latency"] - call["firstByte"]) * scale
+        for i, event in enumerate(events):
+            send_chunk(event)
+            if i + 1 < len(events):
+                time.sleep(rest / max(1, len(events) - 1))
+        send_chunk(b"")
+
+    def start_stream(self, status=200):
+        """Sends the headers of a chunked event stream, and returns a function that sends a chunk of it."""
+        self.send_response(status)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.send_limit_headers()
+        self.end_headers()
+
+        def send_chunk(data):
+            self.wfile.write(f"{len(data):x}\r\n".encode("ascii") + data + b"\r\n")
+            self.wfile.flush()
+
+        return send_chunk
+
+    def send_stream(self, request, action):
+        send_chunk = self.start_stream()
+        words = action.split(" ")
+        for i, word in enumerate(words):
+            piece = word if i == 0 else " " + word
+            event = {"choices": [{"delta": {"content": piece}, "finish_reason": None, "index": 0}]}
+            send_chunk(f"data: {json.dumps(event)}\n\n".encode("utf-8"))
+            time.sleep(self.args.token_delay)
+        event = {"choices": [{"delta": {}, "finish_reason": "stop", "index": 0}]}
+        send_chunk(f"data: {json.dumps(event)}\n\ndata: [DONE]\n\n".encode("utf-8"))
+        send_chunk(b"")
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+
+def make_certificate(directory):
+    """Makes a self-signed certificate for localhost with openssl."""
+    if not shutil.which("openssl"):
+        raise SystemExit("openssl is needed to make a certificate, or pass --cert and --key.")
+    cert = os.path.join(directory, "cert.pem")
+    key = os.path.join(directory, "key.pem")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "1", "-subj", "/CN=localhost",
+                    "-keyout", key, "-out", cert], check=True, capture_output=True)
+    return cert, key
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--tls", action="store_true", help="serve HTTPS, with a self-signed certificate by default")
+    parser.add_argument("--cert", help="certificate to use with --tls")
+    parser.add_argument("--key", help="private key to use with --tls")
+    parser.add_argument("--latency", type=float, default=0.3,
+                        help="seconds to wait before answering: the mean, or the median for lognormal")
+    parser.add_argument("--latency-distribution", default="fixed",
+                        choices=["fixed", "uniform", "normal", "lognormal", "exponential"],
+                        help="how the wait before answering is spread out")
+    parser.add_argument("--latency-spread", type=float, default=0.1,
+                        help="half the range for uniform, the standard deviation for normal, sigma of the log for "
+                             "lognormal")
+    parser.add_argument("--seed", type=int, help="seed for the latencies, to get the same ones every run")
+    parser.add_argument("--replay", help="answer from a recording made by the game instead of with canned actions")
+    parser.add_argument("--latency-scale", type=float, default=1.0,
+                        help="multiplies the latencies in the recording, with --replay")
+    parser.add_argument("--rate-limit-requests", type=int, default=0,
+                        help="requests allowed per minute, over which requests get a 429. 0 is no limit")
+    parser.add_argument("--rate-limit-tokens", type=int, default=0,
+                        help="tokens allowed per minute, counting the prompt and a small allowance for the answer. "
+                             "0 is no limit")
+    parser.add_argument("--server-error-rate", type=float, default=0.0,
+                        help="fraction of requests to fail with a 500, to try out retries")
+    parser.add_argument("--token-delay", type=float, default=0.05, help="seconds between streamed chunks")
+    parser.add_argument("--idle-timeout", type=float, default=60.0,
+                        help="seconds before an idle connection is closed, like the real server")
+    parser.add_argument("--verbose", action="store_true", help="log every request")
+    args = parser.parse_args()
+
+    Handler.args = args
+    Handler.latency = Latency(args)
+    if args.replay:
+        Handler.recording = Recording(args.replay)
+    if args.rate_limit_requests or args.rate_limit_tokens:
+        Handler.rate_limits = RateLimits(args)
+    if args.server_error_rate > 0:
+        Handler.errors = (random.Random(args.seed), threading.Lock())
+    Handler.timeout = args.idle_timeout
+    server = Server((args.host, args.port), Handler)
+    scheme = "http"
+    if args.tls:
+        cert, key = args.cert, args.key
+        if not cert:
+            cert, key = make_certificate(tempfile.mkdtemp())
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(cert, key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    print(f"serving {scheme}://{args.host}:{args.port}/v1/chat/completions")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        print(Stats.report())
+
+
+if __name__ == "__main__":
+    main()